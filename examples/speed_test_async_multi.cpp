@@ -76,13 +76,14 @@ int main(int argc, char **argv) {
     std::atomic_int count{0};
 
     // write subscribe cmd
-    r::single_command_t cmd_incr{"INCR", "simple_loop:count"};
-    r::command_container_t cmd_container;
+    // the flat batch, i.e. without per-command allocations
+    r::command_batch_t cmd_batch;
+    cmd_batch.reserve(cmds_count, cmds_count * 2);
     for (size_t i = 0; i < cmds_count; ++i) {
-        cmd_container.push_back(cmd_incr);
+        cmd_batch.push("INCR", "simple_loop:count");
     }
 
-    r::command_wrapper_t cmd_wpapper{std::move(cmd_container)};
+    r::command_wrapper_t cmd_wpapper{std::move(cmd_batch)};
 
     asio::io_service io_service;
     auto ip_address = asio::ip::address::from_string(dst_parts[0]);
@@ -6,11 +6,19 @@
 //
 #pragma once
 
+#include <bredis/Allocator.hpp>
+#include <bredis/Cluster.hpp>
 #include <bredis/Command.hpp>
 #include <bredis/Connection.hpp>
+#include <bredis/ConnectionPool.hpp>
+#include <bredis/Decode.hpp>
 #include <bredis/Error.hpp>
+#include <bredis/Events.hpp>
 #include <bredis/Extract.hpp>
 #include <bredis/MarkerHelpers.hpp>
+#include <bredis/Multiplexer.hpp>
 #include <bredis/Markers.hpp>
 #include <bredis/Protocol.hpp>
 #include <bredis/Result.hpp>
+#include <bredis/Sink.hpp>
+#include <bredis/Tape.hpp>
@@ -0,0 +1,134 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bredis {
+
+// The source of memory for the marker arrays (and tapes), simplified
+// counterpart of C++17 std::pmr::memory_resource
+class memory_resource_t {
+  public:
+    virtual ~memory_resource_t() = default;
+    virtual void *allocate(std::size_t bytes, std::size_t alignment) = 0;
+    virtual void deallocate(void *p, std::size_t bytes,
+                            std::size_t alignment) = 0;
+};
+
+// Allocates from the memory resource; the default constructed one uses
+// the global operator new. The resource is propagated along with the
+// containers, i.e. a copy of the markers still refers the same resource.
+template <typename T> class markers_allocator_t {
+    template <typename U> friend class markers_allocator_t;
+
+    memory_resource_t *resource_;
+
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    markers_allocator_t() noexcept : resource_{nullptr} {}
+    markers_allocator_t(memory_resource_t *resource) noexcept
+        : resource_{resource} {}
+    template <typename U>
+    markers_allocator_t(const markers_allocator_t<U> &other) noexcept
+        : resource_{other.resource_} {}
+
+    memory_resource_t *resource() const noexcept { return resource_; }
+
+    T *allocate(std::size_t n) {
+        if (!resource_) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        auto p = resource_->allocate(n * sizeof(T), alignof(T));
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        if (!resource_) {
+            ::operator delete(p);
+        } else {
+            resource_->deallocate(p, n * sizeof(T), alignof(T));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const markers_allocator_t<U> &other) const noexcept {
+        return resource_ == other.resource_;
+    }
+
+    template <typename U>
+    bool operator!=(const markers_allocator_t<U> &other) const noexcept {
+        return resource_ != other.resource_;
+    }
+};
+
+// Monotonic arena: the memory is handed out sequentially from the blocks
+// and is never returned individually; instead all of it is reclaimed at
+// once via release(), i.e. when the replies are no longer needed.
+class monotonic_arena_t : public memory_resource_t {
+    struct block_deleter_t {
+        void operator()(char *p) const { ::operator delete(p); }
+    };
+    struct block_t {
+        std::unique_ptr<char, block_deleter_t> data;
+        std::size_t size;
+    };
+
+    std::size_t block_size_;
+    std::vector<block_t> blocks_;
+    char *position_;
+    char *end_;
+
+  public:
+    explicit monotonic_arena_t(std::size_t block_size = 4096)
+        : block_size_{block_size}, position_{nullptr}, end_{nullptr} {}
+
+    monotonic_arena_t(const monotonic_arena_t &) = delete;
+    monotonic_arena_t &operator=(const monotonic_arena_t &) = delete;
+
+    void *allocate(std::size_t bytes, std::size_t alignment) override {
+        void *p = position_;
+        std::size_t space = static_cast<std::size_t>(end_ - position_);
+        if (!position_ || !std::align(alignment, bytes, p, space)) {
+            // the global operator new provides the fundamental alignment
+            auto size = std::max(block_size_, bytes);
+            auto data = static_cast<char *>(::operator new(size));
+            block_t block{{data, block_deleter_t{}}, size};
+            blocks_.push_back(std::move(block));
+            p = data;
+            end_ = data + size;
+        }
+        position_ = static_cast<char *>(p) + bytes;
+        return p;
+    }
+
+    void deallocate(void * /*p*/, std::size_t /*bytes*/,
+                    std::size_t /*alignment*/) override {}
+
+    // reclaims all allocated memory; the first block is kept for reuse
+    void release() {
+        if (blocks_.empty()) {
+            return;
+        }
+        blocks_.resize(1);
+        position_ = blocks_.front().data.get();
+        end_ = position_ + blocks_.front().size;
+    }
+};
+
+} // namespace bredis
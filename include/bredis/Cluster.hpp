@@ -0,0 +1,216 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include "Command.hpp"
+#include "Error.hpp"
+#include "Markers.hpp"
+#include "Multiplexer.hpp"
+
+namespace bredis {
+
+constexpr std::size_t cluster_slots_count = 16384;
+
+// the hash slot of the key (CRC16 of the key, or of its non-empty {hashtag})
+inline std::uint16_t key_slot(boost::string_ref key);
+
+struct slot_range_t {
+    std::uint16_t first;
+    std::uint16_t last;
+    // the master node
+    std::string host;
+    std::uint16_t port;
+};
+
+// parses the reply to CLUSTER SLOTS, returns false if it is malformed
+template <typename Iterator>
+bool parse_cluster_slots(const markers::redis_result_t<Iterator> &reply,
+                         std::vector<slot_range_t> &ranges);
+
+// -MOVED / -ASK error reply
+struct redirection_t {
+    bool moved;
+    std::uint16_t slot;
+    // empty if the node is unknown, i.e. it is the same host
+    std::string host;
+    std::uint16_t port;
+};
+
+inline boost::optional<redirection_t>
+parse_redirection(boost::string_ref error);
+
+// The client of Redis Cluster. The command is routed to the node, which
+// serves the slot of its key (the first argument after the command name,
+// unless the command defines it elsewhere, see details::command_key; the
+// commands without keys are sent to the seed node), via the multiplexed
+// connection to it. The -MOVED and -ASK replies are followed (up to
+// max_redirections times) transparently for the caller; after -MOVED the
+// slot map is refreshed in the background, unless it already agrees.
+//
+// MGET, MSET, DEL, UNLINK, EXISTS and TOUCH with the keys of different
+// slots are split by the slots, the parts are sent in parallel (the parts
+// of the same node by one batch; the redirected part is resent on its own),
+// and their replies are merged into the single reply, as if the command was
+// not split.
+// The split command is not atomic: if some parts fail, the others are
+// still applied; then the first error reply is passed as is, and the
+// amount of the succeeded parts is set in the result.
+//
+// The connections are made by the asynchronous factory as the nodes are
+// discovered; the commands to the node wait until it is connected. As
+// Multiplexer, it is not thread-safe: the factory completions are
+// dispatched to the executor of the cluster, which must be the one of the
+// streams (e.g. their strand). It must outlive all the pending commands;
+// the handlers are invoked via their associated executors, the executor of
+// the cluster is the default one.
+template <typename NextLayer> class Cluster {
+  public:
+    using multiplexer_t = Multiplexer<NextLayer>;
+    using Iterator = typename multiplexer_t::Iterator;
+    using reply_t = typename multiplexer_t::reply_t;
+    using node_result_t = typename multiplexer_t::result_t;
+    using executor_type = typename multiplexer_t::executor_type;
+    using connect_handler_t =
+        std::function<void(const boost::system::error_code &, NextLayer)>;
+    using factory_t =
+        std::function<void(const std::string &host, std::uint16_t port,
+                           connect_handler_t handler)>;
+    using slots_handler_t =
+        std::function<void(const boost::system::error_code &)>;
+
+    static constexpr std::size_t max_redirections = 5;
+
+    // the reply of the node, with the amount of the parts, which the
+    // command has been split into, and which of them are replied without
+    // error (i.e. succeeded < parts, if the reply is the error)
+    struct result_t : node_result_t {
+        std::size_t parts = 1;
+        std::size_t succeeded = 0;
+    };
+
+  private:
+    struct request_t;
+    using request_ptr_t = std::shared_ptr<request_t>;
+
+    struct node_t {
+        std::string host;
+        std::uint16_t port;
+        std::unique_ptr<multiplexer_t> connection;
+        bool connecting;
+        // the requests, which wait for the connection, and whether they
+        // are asked
+        std::vector<std::pair<request_ptr_t, bool>> waiting;
+    };
+
+    using completion_t = details::completion_t<result_t, executor_type>;
+    using callback_t =
+        std::function<void(const boost::system::error_code &, result_t)>;
+
+    // the command is kept serialized to be resent on redirection; the
+    // reply is passed as array of one, if the command was a container; the
+    // batch of commands (replies > 1) is passed the array of the replies,
+    // and it is not redirected
+    struct request_t {
+        std::string command;
+        std::size_t replies;
+        bool wrap;
+        callback_t callback;
+        std::size_t redirections;
+    };
+
+    // the multi-key command is split by the slots of the keys, and the
+    // replies to the parts are merged
+    enum class merge_t { values, sum, status };
+    struct fan_out_t {
+        merge_t merge;
+        callback_t callback;
+        std::size_t parts;
+        std::size_t remaining;
+        // the parts, which are replied without error
+        std::size_t succeeded;
+        // the serialized replies per key, i.e. in the original order
+        std::vector<std::string> values;
+        long long sum;
+        // the message of the first error reply
+        std::string error;
+        boost::system::error_code ec;
+    };
+    using fan_out_ptr_t = std::shared_ptr<fan_out_t>;
+
+    executor_type executor_;
+    factory_t factory_;
+    std::vector<node_t> nodes_;
+    // the index of the node per slot
+    std::vector<std::size_t> slots_;
+    // the slots re-assigned by -MOVED since the start
+    std::size_t moved_;
+    // one CLUSTER SLOTS is in flight at a time, the handlers wait for it;
+    // the node, which the next one is sent to
+    bool refreshing_;
+    std::size_t refresh_node_;
+    std::vector<slots_handler_t> refresh_handlers_;
+
+  public:
+    Cluster(const executor_type &executor, const std::string &host,
+            std::uint16_t port, factory_t factory);
+
+    Cluster(const Cluster &) = delete;
+
+    // loads the slot map from the seed node; the commands can be issued
+    // before, then they are redirected by the seed node; if the map is
+    // being loaded already, the handler waits for it
+    void async_connect(slots_handler_t handler);
+
+    executor_type get_executor() const { return executor_; }
+
+    // the command must be single
+    template <typename CompletionToken>
+    BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+                                  void(boost::system::error_code, result_t))
+    async_execute(const command_wrapper_t &command, CompletionToken &&token);
+
+    // the connection to the node, which serves the slot; null if it is
+    // not connected yet
+    multiplexer_t *node(std::uint16_t slot);
+
+    // the amount of the known nodes
+    std::size_t nodes() const { return nodes_.size(); }
+
+  private:
+    void execute(const command_wrapper_t &command, callback_t callback);
+    std::size_t node_index(const std::string &host, std::uint16_t port);
+    void connect(std::size_t index);
+    void on_connect(std::size_t index, const boost::system::error_code &ec,
+                    NextLayer &&stream);
+    void refresh(std::size_t index, slots_handler_t handler);
+    void send(std::size_t index, request_ptr_t request, bool asking);
+    void send_batch(std::size_t index, std::vector<request_ptr_t> &&parts);
+    void on_reply(std::size_t index, const request_ptr_t &request,
+                  const boost::system::error_code &ec,
+                  node_result_t &&result);
+    bool fan_out(const std::vector<boost::string_ref> &arguments,
+                 callback_t &callback);
+    void merge(fan_out_t &fan_out, const std::vector<std::size_t> &keys,
+               const boost::system::error_code &ec, const reply_t &reply);
+    void complete(fan_out_t &fan_out);
+};
+
+} // namespace bredis
+
+#include "impl/cluster.ipp"
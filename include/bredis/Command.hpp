@@ -6,12 +6,20 @@
 //
 #pragma once
 
+#include <boost/container/small_vector.hpp>
 #include <boost/utility/string_ref.hpp>
 #include <boost/variant.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
 #include "Result.hpp"
+#include "impl/numbers.ipp"
 
 namespace bredis {
 
@@ -26,27 +34,374 @@ using are_all_constructible = all_true<std::is_constructible<R, Ts>::value...>;
 
 } // namespace detail
 
-using args_container_t = std::vector<boost::string_ref>;
+// The command argument: the string (it is referred, i.e. it must outlive
+// the command) or the number. The number is formatted once, right in the
+// constructor, into the inline storage, i.e. without temporary string and
+// locale, and string() refers to the formatted text then. The characters
+// (char) and bool are not numbers.
+class command_arg_t {
+  public:
+    enum class kind_t : std::uint8_t { string, integer, unsigned_, double_ };
+
+  private:
+    template <typename T>
+    using is_number =
+        std::integral_constant<bool, std::is_arithmetic<T>::value &&
+                                         !std::is_same<T, bool>::value &&
+                                         !std::is_same<T, char>::value &&
+                                         !std::is_same<T, signed char>::value &&
+                                         !std::is_same<T, unsigned char>::value>;
+
+    struct text_t {
+        const char *data;
+        std::size_t size;
+    };
+
+    union {
+        text_t text_;
+        // enough for any integer and for any double
+        char formatted_[details::double_max_length];
+    };
+    std::uint8_t formatted_size_;
+    kind_t kind_;
+
+    void format_integer(std::uint64_t magnitude, bool negative) {
+        auto out = formatted_;
+        if (negative) {
+            *out++ = '-';
+        }
+        out = details::write_decimal(out, magnitude);
+        formatted_size_ = static_cast<std::uint8_t>(out - formatted_);
+    }
+
+  public:
+    template <typename T,
+              std::enable_if_t<std::is_constructible<boost::string_ref,
+                                                     const T &>::value,
+                               int> = 0>
+    command_arg_t(const T &value) : formatted_size_{0}, kind_{kind_t::string} {
+        boost::string_ref str(value);
+        text_ = text_t{str.data(), str.size()};
+    }
+
+    template <typename T, std::enable_if_t<is_number<T>::value &&
+                                               std::is_integral<T>::value &&
+                                               std::is_signed<T>::value,
+                                           int> = 0>
+    command_arg_t(T value) : kind_{kind_t::integer} {
+        format_integer(details::magnitude(value), value < 0);
+    }
+
+    template <typename T, std::enable_if_t<is_number<T>::value &&
+                                               std::is_integral<T>::value &&
+                                               std::is_unsigned<T>::value,
+                                           int> = 0>
+    command_arg_t(T value) : kind_{kind_t::unsigned_} {
+        format_integer(value, false);
+    }
+
+    template <typename T,
+              std::enable_if_t<std::is_floating_point<T>::value, int> = 0>
+    command_arg_t(T value) : kind_{kind_t::double_} {
+        formatted_size_ = static_cast<std::uint8_t>(
+            details::format_double(formatted_, static_cast<double>(value)));
+    }
+
+    kind_t kind() const { return kind_; }
+
+    // the string argument or the formatted number; for the numbers it
+    // refers to this argument
+    boost::string_ref string() const {
+        if (kind_ == kind_t::string) {
+            return boost::string_ref(text_.data, text_.size);
+        }
+        return boost::string_ref(formatted_, formatted_size_);
+    }
+};
+
+#ifndef BREDIS_INLINE_ARGS
+#define BREDIS_INLINE_ARGS 8
+#endif
+
+// the arguments of the small commands are stored inline, i.e. without heap
+// allocation
+using args_container_t =
+    boost::container::small_vector<command_arg_t, BREDIS_INLINE_ARGS>;
 struct single_command_t {
     args_container_t arguments;
 
     template <typename... Args,
               typename = std::enable_if_t<detail::are_all_constructible<
-                  boost::string_ref, Args...>::value>>
+                  command_arg_t, Args...>::value>>
     single_command_t(Args &&... args) : arguments{std::forward<Args>(args)...} {
         static_assert(sizeof...(Args) >= 1, "Empty command is not allowed");
     }
 
     template <typename InputIterator,
               typename = std::enable_if_t<std::is_constructible<
-                  boost::string_ref, typename std::iterator_traits<
-                                         InputIterator>::value_type>::value>>
+                  command_arg_t, typename std::iterator_traits<
+                                     InputIterator>::value_type>::value>>
     single_command_t(InputIterator first, InputIterator last)
         : arguments(first, last) {}
 };
 
 using command_container_t = std::vector<single_command_t>;
 
-using command_wrapper_t = boost::variant<single_command_t, command_container_t>;
+// The arguments of the command in the command_batch_t
+class command_ref_t {
+    const command_arg_t *first_;
+    const command_arg_t *last_;
+
+  public:
+    using const_iterator = const command_arg_t *;
+
+    command_ref_t(const command_arg_t *first, const command_arg_t *last)
+        : first_{first}, last_{last} {}
+
+    const_iterator begin() const { return first_; }
+    const_iterator end() const { return last_; }
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+    const command_arg_t &operator[](std::size_t idx) const {
+        return first_[idx];
+    }
+};
+
+// The flat representation of many commands (e.g. of a big pipeline): the
+// arguments of all commands are stored in a single array, and the commands
+// are delimited by offsets, i.e. there are no per-command allocations.
+class command_batch_t {
+    std::vector<command_arg_t> arguments_;
+    // the start of each command in arguments_
+    std::vector<std::size_t> offsets_;
+
+  public:
+    command_batch_t() = default;
+
+    void reserve(std::size_t commands, std::size_t arguments) {
+        offsets_.reserve(commands);
+        arguments_.reserve(arguments);
+    }
+
+    template <typename... Args,
+              typename = std::enable_if_t<detail::are_all_constructible<
+                  command_arg_t, Args...>::value>>
+    void push(Args &&... args) {
+        static_assert(sizeof...(Args) >= 1, "Empty command is not allowed");
+        offsets_.push_back(arguments_.size());
+        command_arg_t refs[] = {command_arg_t(args)...};
+        arguments_.insert(arguments_.end(), std::begin(refs), std::end(refs));
+    }
+
+    template <typename InputIterator,
+              typename = std::enable_if_t<std::is_constructible<
+                  command_arg_t, typename std::iterator_traits<
+                                     InputIterator>::value_type>::value>>
+    void push(InputIterator first, InputIterator last) {
+        offsets_.push_back(arguments_.size());
+        arguments_.insert(arguments_.end(), first, last);
+    }
+
+    void push(const single_command_t &cmd) {
+        push(cmd.arguments.begin(), cmd.arguments.end());
+    }
+
+    std::size_t size() const { return offsets_.size(); }
+    bool empty() const { return offsets_.empty(); }
+
+    command_ref_t operator[](std::size_t idx) const {
+        auto first = arguments_.data() + offsets_[idx];
+        auto last = idx + 1 < offsets_.size()
+                        ? arguments_.data() + offsets_[idx + 1]
+                        : arguments_.data() + arguments_.size();
+        return command_ref_t{first, last};
+    }
+};
+
+// marks the variable argument of prepared_command_t
+struct placeholder_t {};
+constexpr placeholder_t placeholder{};
+
+class bound_command_t;
+
+// The command template with the constant arguments pre-serialized, e.g.
+//   prepared_command_t hget{"HGET", placeholder, "name"};
+//   c.write(hget("user:42"));
+// The constant fragments (the array header, the constant arguments with
+// their headers) are encoded once, and only the variable arguments are
+// serialized per command. The prepared command must outlive the bound ones.
+class prepared_command_t {
+    // the constant fragments, i.e. all the serialized command besides the
+    // variable arguments
+    std::string encoded_;
+    // the end of the constant fragment before each variable argument
+    std::vector<std::size_t> fragments_;
+    // the constant arguments in encoded_ (offset and size) or the
+    // variable ones (npos and index)
+    std::vector<std::pair<std::size_t, std::size_t>> arguments_;
+
+    void append(placeholder_t) {
+        arguments_.emplace_back(std::string::npos, fragments_.size());
+        fragments_.push_back(encoded_.size());
+    }
+
+    // the string or the number
+    void append(const command_arg_t &arg) {
+        auto str = arg.string();
+        encoded_ += '$' + std::to_string(str.size()) + "\r\n";
+        arguments_.emplace_back(encoded_.size(), str.size());
+        encoded_.append(str.data(), str.size());
+        encoded_ += "\r\n";
+    }
+
+  public:
+    template <typename... Args> explicit prepared_command_t(Args &&... args) {
+        static_assert(sizeof...(Args) >= 1, "Empty command is not allowed");
+        encoded_ = '*' + std::to_string(sizeof...(Args)) + "\r\n";
+        int expand[] = {(append(std::forward<Args>(args)), 0)...};
+        (void)expand;
+    }
+
+    // the storage is referred by the bound commands
+    prepared_command_t(const prepared_command_t &) = delete;
+    prepared_command_t &operator=(const prepared_command_t &) = delete;
+
+    std::size_t variables() const { return fragments_.size(); }
+
+    // the constant fragment before the variable argument (or the tail one
+    // for idx == variables())
+    boost::string_ref fragment(std::size_t idx) const {
+        auto from = idx ? fragments_[idx - 1] : 0;
+        auto to = idx < fragments_.size() ? fragments_[idx] : encoded_.size();
+        return boost::string_ref(encoded_.data() + from, to - from);
+    }
+
+    // binds the variable arguments; throws std::invalid_argument if the
+    // amount of them does not match the amount of placeholders
+    template <typename... Args,
+              typename = std::enable_if_t<detail::are_all_constructible<
+                  command_arg_t, Args...>::value>>
+    bound_command_t operator()(Args &&... args) const;
+
+    template <typename InputIterator,
+              typename = std::enable_if_t<std::is_constructible<
+                  command_arg_t, typename std::iterator_traits<
+                                     InputIterator>::value_type>::value>>
+    bound_command_t bind(InputIterator first, InputIterator last) const;
+
+    friend class bound_command_t;
+};
+
+// The prepared command with the variable arguments; it is the range of all
+// the command arguments (as single_command_t::arguments), while
+// Protocol serializes only the variable ones.
+class bound_command_t {
+    const prepared_command_t *prepared_;
+    args_container_t variables_;
+
+  public:
+    class const_iterator {
+        const bound_command_t *cmd_;
+        std::size_t idx_;
+
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = command_arg_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = value_type;
+
+        const_iterator(const bound_command_t *cmd, std::size_t idx)
+            : cmd_{cmd}, idx_{idx} {}
+
+        value_type operator*() const { return (*cmd_)[idx_]; }
+        const_iterator &operator++() {
+            ++idx_;
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const {
+            return idx_ == other.idx_;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return idx_ != other.idx_;
+        }
+    };
+
+    template <typename InputIterator>
+    bound_command_t(const prepared_command_t &prepared, InputIterator first,
+                    InputIterator last)
+        : prepared_{&prepared}, variables_(first, last) {
+        if (variables_.size() != prepared.variables()) {
+            throw std::invalid_argument(
+                "Variable arguments do not match the prepared command");
+        }
+    }
+
+    const prepared_command_t &prepared() const { return *prepared_; }
+    const args_container_t &variables() const { return variables_; }
+
+    command_arg_t operator[](std::size_t idx) const {
+        auto &arg = prepared_->arguments_[idx];
+        if (arg.first == std::string::npos) {
+            return variables_[arg.second];
+        }
+        return boost::string_ref(prepared_->encoded_.data() + arg.first,
+                                 arg.second);
+    }
+
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, size()}; }
+    std::size_t size() const { return prepared_->arguments_.size(); }
+};
+
+template <typename... Args, typename>
+bound_command_t prepared_command_t::operator()(Args &&... args) const {
+    std::array<command_arg_t, sizeof...(Args)> refs{{command_arg_t(args)...}};
+    return bound_command_t(*this, refs.begin(), refs.end());
+}
+
+template <typename InputIterator, typename>
+bound_command_t prepared_command_t::bind(InputIterator first,
+                                         InputIterator last) const {
+    return bound_command_t(*this, first, last);
+}
+
+using command_wrapper_t =
+    boost::variant<single_command_t, command_container_t, command_batch_t,
+                   bound_command_t>;
+
+namespace detail {
+
+template <typename F>
+struct for_each_command_visitor : public boost::static_visitor<void> {
+    F &f;
+
+    explicit for_each_command_visitor(F &f_) : f(f_) {}
+
+    void operator()(const single_command_t &cmd) const { f(cmd.arguments); }
+
+    void operator()(const command_container_t &cmds) const {
+        for (const auto &cmd : cmds) {
+            f(cmd.arguments);
+        }
+    }
+
+    void operator()(const command_batch_t &batch) const {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            f(batch[i]);
+        }
+    }
+
+    void operator()(const bound_command_t &cmd) const { f(cmd); }
+};
+
+} // namespace detail
+
+// invokes f with the arguments (a range of command_arg_t) of each
+// command; the range is bound_command_t for the prepared commands
+template <typename F>
+void for_each_command(const command_wrapper_t &command, F &&f) {
+    detail::for_each_command_visitor<std::remove_reference_t<F>> visitor(f);
+    boost::apply_visitor(visitor, command);
+}
 
 } // namespace bredis
@@ -21,9 +21,11 @@
 #include <boost/asio/async_result.hpp>
 #include <boost/utility/string_ref.hpp>
 
+#include "Allocator.hpp"
 #include "Command.hpp"
 #include "Protocol.hpp"
 #include "Result.hpp"
+#include "Sink.hpp"
 
 namespace bredis {
 
@@ -50,6 +52,17 @@ template <typename NextLayer> class Connection {
     async_write(DynamicBuffer &tx_buff, const command_wrapper_t &command,
                 WriteCallback &&write_callback);
 
+    // the command is sent as the sequence of the generated headers and of
+    // the arguments (not shorter than copy_threshold) in place, i.e. without
+    // copying them; the arguments must outlive the operation
+    template <typename WriteCallback>
+    BOOST_ASIO_INITFN_RESULT_TYPE(WriteCallback,
+                                  void(boost::system::error_code, std::size_t))
+    async_write_gather(const command_wrapper_t &command,
+                       WriteCallback &&write_callback,
+                       std::size_t copy_threshold = 4096);
+
+    // the kept markers are allocated from the resource, if it is specified
     template <typename DynamicBuffer, typename ReadCallback,
               typename Policy = bredis::parsing_policy::keep_result>
     BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
@@ -57,12 +70,54 @@ template <typename NextLayer> class Connection {
                                        BREDIS_PARSE_RESULT(DynamicBuffer,
                                                            Policy)))
     async_read(DynamicBuffer &rx_buff, ReadCallback &&read_callback,
-               std::size_t replies_count = 1, Policy policy = Policy{});
+               std::size_t replies_count = 1, Policy policy = Policy{},
+               memory_resource_t *resource = nullptr);
+
+    // all the complete replies, which are already buffered or arrive with
+    // the first read (but at most max_replies, 0 means no limit), are
+    // returned as array; the amount of them is passed as the last argument
+    template <typename DynamicBuffer, typename ReadCallback,
+              typename Policy = bredis::parsing_policy::keep_result>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                                  void(boost::system::error_code,
+                                       BREDIS_PARSE_RESULT(DynamicBuffer,
+                                                           Policy),
+                                       std::size_t))
+    async_read_available(DynamicBuffer &rx_buff, ReadCallback &&read_callback,
+                         std::size_t max_replies = 0, Policy policy = Policy{},
+                         memory_resource_t *resource = nullptr);
+
+    // the bulk string reply is passed to the sink by chunks as it arrives,
+    // see Sink.hpp
+    template <typename DynamicBuffer, typename Sink, typename ReadCallback>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                                  void(boost::system::error_code,
+                                       stream_result_t))
+    async_read_stream(DynamicBuffer &rx_buff, Sink sink,
+                      ReadCallback &&read_callback,
+                      std::size_t chunk_size = 65536);
+
+    // the elements of the aggregate reply are passed to the handler by
+    // batches as they arrive, see elements_read_op_impl
+    template <typename DynamicBuffer, typename ElementsHandler,
+              typename ReadCallback>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                                  void(boost::system::error_code,
+                                       elements_result_t))
+    async_read_elements(DynamicBuffer &rx_buff, ElementsHandler handler,
+                        ReadCallback &&read_callback,
+                        std::size_t batch_size = 1);
 
     /* synchronous interface */
     void write(const command_wrapper_t &command);
     void write(const command_wrapper_t &command, boost::system::error_code &ec);
 
+    void write_gather(const command_wrapper_t &command,
+                      std::size_t copy_threshold = 4096);
+    void write_gather(const command_wrapper_t &command,
+                      std::size_t copy_threshold,
+                      boost::system::error_code &ec);
+
     template <typename DynamicBuffer>
     BREDIS_PARSE_RESULT(DynamicBuffer, bredis::parsing_policy::keep_result)
     read(DynamicBuffer &rx_buff);
@@ -70,6 +125,26 @@ template <typename NextLayer> class Connection {
     template <typename DynamicBuffer>
     BREDIS_PARSE_RESULT(DynamicBuffer, bredis::parsing_policy::keep_result)
     read(DynamicBuffer &rx_buff, boost::system::error_code &ec);
+
+    template <typename DynamicBuffer, typename Sink>
+    stream_result_t read_stream(DynamicBuffer &rx_buff, Sink sink,
+                                std::size_t chunk_size = 65536);
+
+    template <typename DynamicBuffer, typename Sink>
+    stream_result_t read_stream(DynamicBuffer &rx_buff, Sink sink,
+                                std::size_t chunk_size,
+                                boost::system::error_code &ec);
+
+    template <typename DynamicBuffer, typename ElementsHandler>
+    elements_result_t read_elements(DynamicBuffer &rx_buff,
+                                    ElementsHandler handler,
+                                    std::size_t batch_size = 1);
+
+    template <typename DynamicBuffer, typename ElementsHandler>
+    elements_result_t read_elements(DynamicBuffer &rx_buff,
+                                    ElementsHandler handler,
+                                    std::size_t batch_size,
+                                    boost::system::error_code &ec);
 };
 
 } // namespace bredis
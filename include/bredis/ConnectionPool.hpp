@@ -0,0 +1,147 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "Command.hpp"
+#include "Multiplexer.hpp"
+
+namespace bredis {
+
+// The bounds are applied per io_context
+struct pool_options_t {
+    std::size_t min_connections = 1;
+    std::size_t max_connections = 1;
+    // the new connection is added, when the least loaded one has at least
+    // that amount of the outstanding replies; 0 means never
+    std::size_t grow_threshold = 0;
+    // the surplus connection is closed, when it has not been used for
+    // that long (it is checked by the timer, i.e. without further commands)
+    std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(30);
+    pipeline_window_t window;
+};
+
+// The pool of the multiplexed connections. The connections are grouped by
+// io_context (e.g. one per thread), and the command is routed to the
+// least loaded connection of the io_context, which runs in the calling
+// thread, i.e. without cross-thread handoff; the commands from the other
+// threads are spread over the io_contexts. The connections of io_context
+// (and the pool state) are accessed via its strand only, so io_context
+// may be run by many threads.
+//
+// The connections are created by the asynchronous factory with the
+// strand, which the stream has to be bound to; the commands are queued
+// until the connection is up. The connections are added up to
+// max_connections as the load grows; the surplus ones are closed down to
+// min_connections, when they are idle for idle_timeout (the timer of the
+// io_context checks them, while there are surplus connections). The pool
+// must outlive all the pending commands and connections.
+template <typename NextLayer> class ConnectionPool {
+  public:
+    using multiplexer_t = Multiplexer<NextLayer>;
+    using result_t = typename multiplexer_t::result_t;
+    using executor_type = typename multiplexer_t::executor_type;
+    using strand_t =
+        boost::asio::strand<boost::asio::io_context::executor_type>;
+    using connect_handler_t =
+        std::function<void(const boost::system::error_code &, NextLayer)>;
+    using factory_t =
+        std::function<void(const strand_t &strand, connect_handler_t handler)>;
+
+  private:
+    using clock_t = std::chrono::steady_clock;
+    using completion_t = details::completion_t<result_t, executor_type>;
+
+    // the command, which is serialized to wait for the connection or for
+    // the strand
+    struct queued_t {
+        std::string command;
+        std::size_t replies;
+        bool wrap;
+        completion_t completion;
+    };
+
+    struct connection_t {
+        // not set until the connection is up
+        std::unique_ptr<multiplexer_t> multiplexer;
+        std::vector<queued_t> queued;
+        clock_t::time_point used;
+    };
+    using connection_ptr_t = std::unique_ptr<connection_t>;
+
+    struct shard_t {
+        boost::asio::io_context *context;
+        strand_t strand;
+        std::vector<connection_ptr_t> connections;
+        // the surplus connections are checked on expiry
+        boost::asio::steady_timer shrink_timer;
+        bool shrink_scheduled;
+    };
+
+    factory_t factory_;
+    pool_options_t options_;
+    std::vector<shard_t> shards_;
+    std::atomic<std::size_t> next_shard_;
+
+  public:
+    ConnectionPool(boost::asio::io_context &context, factory_t factory,
+                   const pool_options_t &options = pool_options_t{});
+
+    ConnectionPool(const std::vector<boost::asio::io_context *> &contexts,
+                   factory_t factory,
+                   const pool_options_t &options = pool_options_t{});
+
+    ConnectionPool(const ConnectionPool &) = delete;
+
+    // can be called from any thread
+    template <typename CompletionToken>
+    BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+                                  void(boost::system::error_code, result_t))
+    async_execute(const command_wrapper_t &command, CompletionToken &&token);
+
+    // the amount of the connections (including the connecting ones) of the
+    // calling thread io_context; it must be called within its strand, or
+    // when the io_context is not running
+    std::size_t size();
+
+  private:
+    shard_t &current_shard();
+    shard_t &route();
+    template <typename Handler>
+    void execute(shard_t &shard, const command_wrapper_t &command,
+                 Handler &&handler);
+    void submit(shard_t &shard, queued_t &&queued);
+    connection_t &select(shard_t &shard);
+    void add(shard_t &shard);
+    void on_connect(shard_t &shard, connection_t &connection,
+                    const boost::system::error_code &ec, NextLayer &&stream);
+    void schedule_shrink(shard_t &shard);
+    void shrink(shard_t &shard);
+
+    static queued_t make_queued(const command_wrapper_t &command,
+                                completion_t completion);
+
+    static std::size_t load(const connection_t &connection) {
+        auto &multiplexer = connection.multiplexer;
+        return multiplexer ? multiplexer->in_flight() + multiplexer->waiting()
+                           : connection.queued.size();
+    }
+};
+
+} // namespace bredis
+
+#include "impl/connection_pool.ipp"
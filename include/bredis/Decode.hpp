@@ -0,0 +1,551 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/variant.hpp>
+
+#include "Error.hpp"
+#include "Markers.hpp"
+#include "Tape.hpp"
+#include "impl/numbers.ipp"
+
+namespace bredis {
+
+// Decodes the reply node into the value of type T, which is known at
+// compile time, i.e. the reply shape is checked and the value is filled
+// directly, without intermediate extraction results. Returns false if the
+// reply does not match T.
+//
+// The node is either tape_cursor_t<Iterator> or markers_node_t<Iterator>;
+// it provides kind(), size(), string(), verbatim() and array(). The user
+// types are supported via specialization of decoder_t.
+template <typename T, typename Enable = void> struct decoder_t;
+
+namespace details {
+
+// skips the attributes, i.e. returns the attributed reply
+template <typename Node> Node unwrap_attribute(Node node) {
+    while (node.kind() == tape_kind_t::attribute) {
+        auto it = node.array().begin();
+        for (std::size_t i = 1; i < node.size(); ++i) {
+            ++it;
+        }
+        node = *it;
+    }
+    return node;
+}
+
+template <typename T, typename Node>
+bool decode_node(const Node &node, T &value) {
+    return decoder_t<T>::decode(unwrap_attribute(node), value);
+}
+
+// the reason of the decoding failure: the error reply (e.g. -WRONGTYPE)
+// is distinguished from the reply of other shape
+template <typename Node> bredis_errors mismatch_of(const Node &node) {
+    return unwrap_attribute(node).kind() == tape_kind_t::error
+               ? bredis_errors::server_error
+               : bredis_errors::type_mismatch;
+}
+
+template <typename Node>
+[[noreturn]] void throw_mismatch(const Node &node) {
+    auto ec = Error::make_error_code(mismatch_of(node));
+    auto unwrapped = unwrap_attribute(node);
+    if (unwrapped.kind() == tape_kind_t::error) {
+        auto message = unwrapped.string();
+        throw boost::system::system_error(
+            ec, std::string{message.from, message.to});
+    }
+    throw boost::system::system_error(ec);
+}
+
+inline bool is_plain_string(tape_kind_t kind) {
+    return kind == tape_kind_t::string || kind == tape_kind_t::int_ ||
+           kind == tape_kind_t::double_ || kind == tape_kind_t::big_number;
+}
+
+// the string of the scalar node, which can be decoded as a string
+template <typename Node>
+bool string_of(const Node &node,
+               decltype(std::declval<Node>().string()) &value) {
+    if (is_plain_string(node.kind())) {
+        value = node.string();
+        return true;
+    } else if (node.kind() == tape_kind_t::verbatim) {
+        value = node.verbatim().string;
+        return true;
+    }
+    return false;
+}
+
+// array, set or push
+inline bool is_sequence(tape_kind_t kind) {
+    return kind == tape_kind_t::array || kind == tape_kind_t::set ||
+           kind == tape_kind_t::push;
+}
+
+template <typename Map, typename Node>
+bool decode_map(const Node &node, Map &value) {
+    if ((node.kind() != tape_kind_t::map &&
+         node.kind() != tape_kind_t::array) ||
+        node.size() % 2) {
+        return false;
+    }
+    value.clear();
+    auto it = node.array().begin();
+    for (std::size_t i = 0; i < node.size(); i += 2) {
+        typename Map::key_type key;
+        typename Map::mapped_type mapped;
+        if (!decode_node(*it++, key) || !decode_node(*it++, mapped)) {
+            return false;
+        }
+        value.emplace(std::move(key), std::move(mapped));
+    }
+    return true;
+}
+
+template <typename Tuple, typename Node, std::size_t... I>
+bool decode_tuple(const Node &node, Tuple &value,
+                  std::index_sequence<I...>) {
+    if (!is_sequence(node.kind()) || node.size() != sizeof...(I)) {
+        return false;
+    }
+    auto it = node.array().begin();
+    bool ok = true;
+    // the elements are decoded in order, until the first mismatch
+    using expander = int[];
+    (void)expander{0, (ok = ok && decode_node(*it++, std::get<I>(value)),
+                       0)...};
+    return ok;
+}
+
+// the variant visitors for markers_node_t
+template <typename Iterator>
+struct marker_kind_t : public boost::static_visitor<tape_kind_t> {
+    tape_kind_t operator()(const markers::string_t<Iterator> &) const {
+        return tape_kind_t::string;
+    }
+    tape_kind_t operator()(const markers::error_t<Iterator> &) const {
+        return tape_kind_t::error;
+    }
+    tape_kind_t operator()(const markers::int_t<Iterator> &) const {
+        return tape_kind_t::int_;
+    }
+    tape_kind_t operator()(const markers::nil_t<Iterator> &) const {
+        return tape_kind_t::nil;
+    }
+    tape_kind_t operator()(const markers::double_t<Iterator> &) const {
+        return tape_kind_t::double_;
+    }
+    tape_kind_t operator()(const markers::bool_t<Iterator> &) const {
+        return tape_kind_t::bool_;
+    }
+    tape_kind_t operator()(const markers::big_number_t<Iterator> &) const {
+        return tape_kind_t::big_number;
+    }
+    tape_kind_t operator()(const markers::verbatim_t<Iterator> &) const {
+        return tape_kind_t::verbatim;
+    }
+    tape_kind_t operator()(const markers::array_holder_t<Iterator> &) const {
+        return tape_kind_t::array;
+    }
+    tape_kind_t operator()(const markers::map_holder_t<Iterator> &) const {
+        return tape_kind_t::map;
+    }
+    tape_kind_t operator()(const markers::set_holder_t<Iterator> &) const {
+        return tape_kind_t::set;
+    }
+    tape_kind_t operator()(const markers::push_holder_t<Iterator> &) const {
+        return tape_kind_t::push;
+    }
+    tape_kind_t
+    operator()(const markers::attribute_holder_t<Iterator> &) const {
+        return tape_kind_t::attribute;
+    }
+};
+
+template <typename Iterator>
+struct marker_string_t
+    : public boost::static_visitor<markers::string_t<Iterator>> {
+    using string_t = markers::string_t<Iterator>;
+
+    string_t operator()(const string_t &value) const { return value; }
+
+    string_t operator()(const markers::verbatim_t<Iterator> &value) const {
+        return value.string;
+    }
+
+    template <typename T> string_t operator()(const T &value) const {
+        return string(value, 0);
+    }
+
+  private:
+    template <typename T>
+    static auto string(const T &value, int) -> decltype(value.string) {
+        return value.string;
+    }
+
+    template <typename T>
+    static string_t string(const T & /*aggregate*/, long) {
+        return string_t{};
+    }
+};
+
+template <typename Iterator>
+struct marker_elements_t
+    : public boost::static_visitor<
+          const typename markers::array_holder_t<Iterator>::recursive_array_t
+              *> {
+    using elements_t =
+        typename markers::array_holder_t<Iterator>::recursive_array_t;
+
+    template <typename T> const elements_t *operator()(const T &value) const {
+        return elements(value, 0);
+    }
+
+  private:
+    template <typename T>
+    static auto elements(const T &value, int) -> decltype(&value.elements) {
+        return &value.elements;
+    }
+
+    template <typename T>
+    static const elements_t *elements(const T & /*scalar*/, long) {
+        return nullptr;
+    }
+};
+
+} // namespace details
+
+// Adapts the markers tree to the decoder node interface
+template <typename Iterator> class markers_node_t {
+    using result_t = markers::redis_result_t<Iterator>;
+
+    const result_t *result_;
+
+  public:
+    class range_t {
+        const result_t *begin_;
+        const result_t *end_;
+
+      public:
+        class iterator {
+            const result_t *it_;
+
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = markers_node_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = markers_node_t;
+
+            explicit iterator(const result_t *it) : it_{it} {}
+            markers_node_t operator*() const { return markers_node_t{*it_}; }
+            iterator &operator++() {
+                ++it_;
+                return *this;
+            }
+            iterator operator++(int) {
+                iterator copy{*this};
+                ++it_;
+                return copy;
+            }
+            bool operator==(const iterator &other) const {
+                return it_ == other.it_;
+            }
+            bool operator!=(const iterator &other) const {
+                return it_ != other.it_;
+            }
+        };
+
+        range_t(const result_t *begin, const result_t *end)
+            : begin_{begin}, end_{end} {}
+        iterator begin() const { return iterator{begin_}; }
+        iterator end() const { return iterator{end_}; }
+    };
+
+    explicit markers_node_t(const result_t &result) : result_{&result} {}
+
+    tape_kind_t kind() const {
+        return boost::apply_visitor(details::marker_kind_t<Iterator>(),
+                                    *result_);
+    }
+
+    markers::string_t<Iterator> string() const {
+        return boost::apply_visitor(details::marker_string_t<Iterator>(),
+                                    *result_);
+    }
+
+    markers::verbatim_t<Iterator> verbatim() const {
+        return boost::get<markers::verbatim_t<Iterator>>(*result_);
+    }
+
+    // string length or aggregate elements count
+    std::size_t size() const;
+
+    range_t array() const;
+};
+
+template <typename Integer>
+struct decoder_t<Integer,
+                 std::enable_if_t<std::is_integral<Integer>::value &&
+                                  !std::is_same<Integer, bool>::value>> {
+    template <typename Node>
+    static bool decode(const Node &node, Integer &value) {
+        if (node.kind() != tape_kind_t::int_ &&
+            node.kind() != tape_kind_t::string) {
+            return false;
+        }
+        auto str = node.string();
+        std::int64_t parsed;
+        using limits_t = std::numeric_limits<Integer>;
+        if (!details::parse_integer(str.from, str.to, parsed)) {
+            return false;
+        } else if (parsed < 0) {
+            if (parsed < static_cast<std::int64_t>(limits_t::min())) {
+                return false;
+            }
+        } else if (static_cast<std::uint64_t>(parsed) >
+                   static_cast<std::uint64_t>(limits_t::max())) {
+            return false;
+        }
+        value = static_cast<Integer>(parsed);
+        return true;
+    }
+};
+
+template <typename Float>
+struct decoder_t<Float,
+                 std::enable_if_t<std::is_floating_point<Float>::value>> {
+    template <typename Node>
+    static bool decode(const Node &node, Float &value) {
+        if (node.kind() != tape_kind_t::double_ &&
+            node.kind() != tape_kind_t::int_ &&
+            node.kind() != tape_kind_t::string) {
+            return false;
+        }
+        auto str = node.string();
+        double parsed;
+        if (!details::parse_double(str.from, str.to, parsed)) {
+            return false;
+        }
+        value = static_cast<Float>(parsed);
+        return true;
+    }
+};
+
+template <> struct decoder_t<bool> {
+    template <typename Node> static bool decode(const Node &node, bool &value) {
+        if (node.kind() == tape_kind_t::bool_) {
+            value = *node.string().from == 't';
+            return true;
+        }
+        // RESP2 replies 1 or 0
+        std::int64_t parsed;
+        if (!decoder_t<std::int64_t>::decode(node, parsed) || parsed < 0 ||
+            parsed > 1) {
+            return false;
+        }
+        value = parsed == 1;
+        return true;
+    }
+};
+
+template <> struct decoder_t<std::string> {
+    template <typename Node>
+    static bool decode(const Node &node, std::string &value) {
+        decltype(node.string()) str;
+        if (!details::string_of(node, str)) {
+            return false;
+        }
+        value.assign(str.from, str.to);
+        return true;
+    }
+};
+
+namespace details {
+
+// the string, which the pointers refer, is always contiguous
+inline bool contiguous_of(const char *from, const char *to,
+                          boost::string_ref &value) {
+    value = boost::string_ref{from, static_cast<std::size_t>(to - from)};
+    return true;
+}
+
+// the string is contiguous, if each of its characters follows the previous
+// one in memory, i.e. it does not span the buffers of the sequence (unless
+// they are adjacent)
+template <typename Iterator>
+bool contiguous_of(const Iterator &from, const Iterator &to,
+                   boost::string_ref &value) {
+    if (from == to) {
+        value = boost::string_ref{};
+        return true;
+    }
+    const char *data = &*from;
+    std::size_t size = 0;
+    for (auto it = from; it != to; ++it, ++size) {
+        if (&*it != data + size) {
+            return false;
+        }
+    }
+    value = boost::string_ref{data, size};
+    return true;
+}
+
+} // namespace details
+
+// refers the receive buffer, i.e. it requires contiguous buffer (e.g.
+// asio::streambuf), and is valid until the buffer is consumed; the string,
+// which spans the non-adjacent buffers, is reported as type_mismatch
+template <> struct decoder_t<boost::string_ref> {
+    template <typename Node>
+    static bool decode(const Node &node, boost::string_ref &value) {
+        decltype(node.string()) str;
+        if (!details::string_of(node, str)) {
+            return false;
+        }
+        return details::contiguous_of(str.from, str.to, value);
+    }
+};
+
+template <typename T> struct decoder_t<boost::optional<T>> {
+    template <typename Node>
+    static bool decode(const Node &node, boost::optional<T> &value) {
+        if (node.kind() == tape_kind_t::nil) {
+            value = boost::none;
+            return true;
+        }
+        value.emplace();
+        return decoder_t<T>::decode(node, *value);
+    }
+};
+
+template <typename T, typename Allocator>
+struct decoder_t<std::vector<T, Allocator>> {
+    template <typename Node>
+    static bool decode(const Node &node, std::vector<T, Allocator> &value) {
+        if (!details::is_sequence(node.kind())) {
+            return false;
+        }
+        value.clear();
+        value.reserve(node.size());
+        for (const auto &element : node.array()) {
+            value.emplace_back();
+            if (!details::decode_node(element, value.back())) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename... Ts> struct decoder_t<std::tuple<Ts...>> {
+    template <typename Node>
+    static bool decode(const Node &node, std::tuple<Ts...> &value) {
+        return details::decode_tuple(node, value,
+                                     std::index_sequence_for<Ts...>{});
+    }
+};
+
+template <typename First, typename Second>
+struct decoder_t<std::pair<First, Second>> {
+    template <typename Node>
+    static bool decode(const Node &node, std::pair<First, Second> &value) {
+        return details::decode_tuple(node, value,
+                                     std::make_index_sequence<2>{});
+    }
+};
+
+// RESP3 map or RESP2 array of keys and values (e.g. HGETALL reply)
+template <typename K, typename V, typename Compare, typename Allocator>
+struct decoder_t<std::map<K, V, Compare, Allocator>> {
+    template <typename Node>
+    static bool decode(const Node &node,
+                       std::map<K, V, Compare, Allocator> &value) {
+        return details::decode_map(node, value);
+    }
+};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct decoder_t<std::unordered_map<K, V, Hash, Equal, Allocator>> {
+    template <typename Node>
+    static bool
+    decode(const Node &node,
+           std::unordered_map<K, V, Hash, Equal, Allocator> &value) {
+        return details::decode_map(node, value);
+    }
+};
+
+template <typename T, typename Iterator>
+bool decode(const tape_cursor_t<Iterator> &cursor, T &value) {
+    return details::decode_node(cursor, value);
+}
+
+template <typename T, typename Iterator>
+bool decode(const markers::redis_result_t<Iterator> &result, T &value) {
+    return details::decode_node(markers_node_t<Iterator>{result}, value);
+}
+
+// throws boost::system::system_error if the reply does not match T; the
+// error reply is reported as bredis_errors::server_error with its message
+template <typename T, typename Iterator>
+T decode(const markers::redis_result_t<Iterator> &result) {
+    T value;
+    if (!decode(result, value)) {
+        details::throw_mismatch(markers_node_t<Iterator>{result});
+    }
+    return value;
+}
+
+template <typename T, typename Iterator>
+T decode(const tape_cursor_t<Iterator> &cursor) {
+    T value;
+    if (!decode(cursor, value)) {
+        details::throw_mismatch(cursor);
+    }
+    return value;
+}
+
+template <typename Iterator>
+std::size_t markers_node_t<Iterator>::size() const {
+    auto elements =
+        boost::apply_visitor(details::marker_elements_t<Iterator>(), *result_);
+    if (elements) {
+        return elements->size();
+    }
+    auto str = string();
+    return static_cast<std::size_t>(std::distance(str.from, str.to));
+}
+
+template <typename Iterator>
+typename markers_node_t<Iterator>::range_t
+markers_node_t<Iterator>::array() const {
+    auto elements =
+        boost::apply_visitor(details::marker_elements_t<Iterator>(), *result_);
+    return range_t{elements->data(), elements->data() + elements->size()};
+}
+
+} // namespace bredis
@@ -16,7 +16,12 @@ enum class bredis_errors {
     parser_error,
     count_conversion,
     count_range,
-    bulk_terminator
+    bulk_terminator,
+    type_mismatch,
+    nesting_depth,
+    window_full,
+    cluster_slots,
+    server_error
 };
 
 class bredis_category : public boost::system::error_category {
@@ -35,6 +40,16 @@ class bredis_category : public boost::system::error_category {
             return "Unacceptable count value";
         case bredis_errors::bulk_terminator:
             return "Terminator for bulk string not found";
+        case bredis_errors::type_mismatch:
+            return "Reply does not match the decoded type";
+        case bredis_errors::nesting_depth:
+            return "Maximum nesting depth exceeded";
+        case bredis_errors::window_full:
+            return "Pipelining window is full";
+        case bredis_errors::cluster_slots:
+            return "Invalid cluster slots reply";
+        case bredis_errors::server_error:
+            return "Error reply instead of the decoded type";
         }
         return "Unknown protocol error";
     }
@@ -0,0 +1,81 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/system/error_code.hpp>
+
+#include "Markers.hpp"
+#include "Protocol.hpp"
+#include "Tape.hpp"
+
+namespace bredis {
+
+// The base for event_parser_t handlers: all the events are ignored, so
+// the handler just defines (i.e. hides) the ones it is interested in. The
+// string markers refer the parsed buffer, i.e. they are valid until the
+// buffer is consumed.
+template <typename Iterator> struct events_handler_t {
+    using string_t = markers::string_t<Iterator>;
+
+    void on_array_begin(std::size_t /*count*/) {}
+    void on_array_end() {}
+    void on_string(const string_t & /*value*/) {}
+    void on_error(const string_t & /*value*/) {}
+    void on_int(std::int64_t /*value*/) {}
+    void on_nil() {}
+
+    // RESP3
+    void on_double(double /*value*/) {}
+    void on_bool(bool /*value*/) {}
+    void on_big_number(const string_t & /*value*/) {}
+    void on_verbatim(const markers::verbatim_t<Iterator> & /*value*/) {}
+    // map, set, push or attribute; see tape_node_t::size for the count
+    void on_aggregate_begin(tape_kind_t /*kind*/, std::size_t /*count*/) {}
+    void on_aggregate_end() {}
+};
+
+struct events_result_t {
+    // the amount of bytes, which have been passed to the handler; they can
+    // be consumed, and the next feed should start from the next byte
+    size_t consumed;
+    // the amount of completely parsed replies
+    size_t replies;
+    boost::system::error_code error;
+};
+
+// Push (SAX-style) parser: instead of building the markers tree, the
+// handler is notified about the replies elements in the order of their
+// appearance. The parser is resumable, i.e. it can be fed with the data as
+// it arrives; each element is reported once. After error the parser should
+// be reset.
+class event_parser_t {
+    details::incremental_parser_t parser_;
+    // whether the open aggregates are arrays
+    std::vector<bool> arrays_;
+
+  public:
+    explicit event_parser_t(size_t max_depth = BREDIS_MAX_DEPTH)
+        : parser_{max_depth} {}
+
+    void reset() {
+        parser_.reset();
+        arrays_.clear();
+    }
+
+    template <typename Iterator, typename Handler>
+    inline events_result_t feed(const Iterator &from, const Iterator &to,
+                                Handler &handler);
+};
+
+} // namespace bredis
+
+#include "impl/events.ipp"
@@ -9,13 +9,16 @@
 #include <iterator>
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
-#include <boost/lexical_cast.hpp>
+#include <boost/system/system_error.hpp>
 #include <boost/variant.hpp>
 #include <boost/variant/recursive_variant.hpp>
 
+#include "bredis/Error.hpp"
 #include "bredis/Result.hpp"
+#include "bredis/impl/numbers.ipp"
 
 namespace bredis {
 
@@ -33,18 +36,58 @@ using int_t = int64_t;
 
 struct nil_t {};
 
+// RESP3 types
+using double_t = double;
+
+using bool_t = bool;
+
+struct big_number_t {
+    std::string str;
+};
+
+struct verbatim_t {
+    std::string format;
+    std::string str;
+};
+
 // forward declaration
 struct array_holder_t;
+struct map_holder_t;
+struct set_holder_t;
+struct push_holder_t;
 using array_wrapper_t = boost::recursive_wrapper<array_holder_t>;
+using map_wrapper_t = boost::recursive_wrapper<map_holder_t>;
+using set_wrapper_t = boost::recursive_wrapper<set_holder_t>;
+using push_wrapper_t = boost::recursive_wrapper<push_holder_t>;
 
+// the attributes are not extracted, i.e. the attributed reply is
+// extracted as if there were no attributes
 using extraction_result_t =
-    boost::variant<int_t, string_t, error_t, nil_t, array_wrapper_t>;
+    boost::variant<int_t, string_t, error_t, nil_t, array_wrapper_t, double_t,
+                   bool_t, big_number_t, verbatim_t, map_wrapper_t,
+                   set_wrapper_t, push_wrapper_t>;
 
 struct array_holder_t {
     using recursive_array_t = std::vector<extraction_result_t>;
     recursive_array_t elements;
 };
 
+struct map_holder_t {
+    using recursive_map_t =
+        std::vector<std::pair<extraction_result_t, extraction_result_t>>;
+    recursive_map_t elements;
+};
+
+struct set_holder_t {
+    using recursive_array_t = std::vector<extraction_result_t>;
+    recursive_array_t elements;
+};
+
+struct push_holder_t {
+    using recursive_array_t = std::vector<extraction_result_t>;
+    recursive_array_t elements;
+};
+
 } // namespace extracts
 
 template <typename Iterator>
@@ -70,11 +113,12 @@ struct extractor : public boost::static_visitor<extracts::extraction_result_t> {
 
     extracts::extraction_result_t
     operator()(const markers::int_t<Iterator> &value) const {
-        std::string str;
-        auto size = std::distance(value.string.from, value.string.to);
-        str.reserve(size);
-        str.append(value.string.from, value.string.to);
-        return extracts::int_t{boost::lexical_cast<extracts::int_t>(str)};
+        extracts::int_t r;
+        if (!details::parse_integer(value.string.from, value.string.to, r)) {
+            throw boost::system::system_error{
+                Error::make_error_code(bredis_errors::count_conversion)};
+        }
+        return r;
     }
 
     extracts::extraction_result_t
@@ -84,7 +128,68 @@ struct extractor : public boost::static_visitor<extracts::extraction_result_t> {
 
     extracts::extraction_result_t
     operator()(const markers::array_holder_t<Iterator> &value) const {
-        extracts::array_holder_t r;
+        return extract_elements<extracts::array_holder_t>(value);
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::double_t<Iterator> &value) const {
+        extracts::double_t r;
+        if (!details::parse_double(value.string.from, value.string.to, r)) {
+            throw boost::system::system_error{
+                Error::make_error_code(bredis_errors::parser_error)};
+        }
+        return r;
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::bool_t<Iterator> &value) const {
+        return extracts::bool_t{*value.string.from == 't'};
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::big_number_t<Iterator> &value) const {
+        return extracts::big_number_t{
+            std::string{value.string.from, value.string.to}};
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::verbatim_t<Iterator> &value) const {
+        return extracts::verbatim_t{
+            std::string{value.format.from, value.format.to},
+            std::string{value.string.from, value.string.to}};
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::map_holder_t<Iterator> &value) const {
+        extracts::map_holder_t r;
+        r.elements.reserve(value.elements.size() / 2);
+        for (auto it = value.elements.cbegin(); it != value.elements.cend();
+             it += 2) {
+            r.elements.emplace_back(boost::apply_visitor(*this, *it),
+                                    boost::apply_visitor(*this, *(it + 1)));
+        }
+        return r;
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::set_holder_t<Iterator> &value) const {
+        return extract_elements<extracts::set_holder_t>(value);
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::push_holder_t<Iterator> &value) const {
+        return extract_elements<extracts::push_holder_t>(value);
+    }
+
+    extracts::extraction_result_t
+    operator()(const markers::attribute_holder_t<Iterator> &value) const {
+        return boost::apply_visitor(*this, value.elements.back());
+    }
+
+  private:
+    template <typename Holder, typename Source>
+    extracts::extraction_result_t extract_elements(const Source &value) const {
+        Holder r;
         r.elements.reserve(value.elements.size());
         for (const auto &v : value.elements) {
             r.elements.emplace_back(boost::apply_visitor(*this, v));
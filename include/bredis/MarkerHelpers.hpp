@@ -8,14 +8,13 @@
 #pragma once
 
 #include <algorithm>
-#include <boost/convert.hpp>
-#include <boost/convert/lexical_cast.hpp>
 #include <cctype>
 #include <iterator>
 #include <string>
 
 #include "Command.hpp"
 #include "Markers.hpp"
+#include "impl/numbers.ipp"
 
 namespace bredis {
 
@@ -54,7 +53,49 @@ struct stringizer : public boost::static_visitor<std::string> {
 
     std::string
     operator()(const markers::array_holder_t<Iterator> &value) const {
-        std::string r = "[array] {";
+        return aggregate("[array] {", value);
+    }
+
+    std::string operator()(const markers::double_t<Iterator> &value) const {
+        return "[double] " + std::string(value.string.from, value.string.to);
+    }
+
+    std::string operator()(const markers::bool_t<Iterator> &value) const {
+        return "[bool] " + std::string(value.string.from, value.string.to);
+    }
+
+    std::string
+    operator()(const markers::big_number_t<Iterator> &value) const {
+        return "[bignum] " + std::string(value.string.from, value.string.to);
+    }
+
+    std::string operator()(const markers::verbatim_t<Iterator> &value) const {
+        return "[verbatim] " +
+               std::string(value.format.from, value.format.to) + ":" +
+               std::string(value.string.from, value.string.to);
+    }
+
+    std::string operator()(const markers::map_holder_t<Iterator> &value) const {
+        return aggregate("[map] {", value);
+    }
+
+    std::string operator()(const markers::set_holder_t<Iterator> &value) const {
+        return aggregate("[set] {", value);
+    }
+
+    std::string
+    operator()(const markers::push_holder_t<Iterator> &value) const {
+        return aggregate("[push] {", value);
+    }
+
+    std::string
+    operator()(const markers::attribute_holder_t<Iterator> &value) const {
+        return aggregate("[attribute] {", value);
+    }
+
+  private:
+    template <typename Holder>
+    std::string aggregate(std::string r, const Holder &value) const {
         for (const auto &v : value.elements) {
             r += boost::apply_visitor(*this, v) + ", ";
         }
@@ -97,6 +138,18 @@ class equality : public boost::static_visitor<bool> {
     bool operator()(const markers::nil_t<Iterator> &value) const {
         return std::equal(begin_, end_, value.string.from, value.string.to);
     }
+
+    bool operator()(const markers::double_t<Iterator> &value) const {
+        return std::equal(begin_, end_, value.string.from, value.string.to);
+    }
+
+    bool operator()(const markers::big_number_t<Iterator> &value) const {
+        return std::equal(begin_, end_, value.string.from, value.string.to);
+    }
+
+    bool operator()(const markers::verbatim_t<Iterator> &value) const {
+        return std::equal(begin_, end_, value.string.from, value.string.to);
+    }
 };
 
 // Auxillary class, that scans redis parse results for the matching
@@ -125,6 +178,17 @@ class check_subscription : public boost::static_visitor<bool> {
 
     bool
     operator()(const bredis::markers::array_holder_t<Iterator> &value) const {
+        return check(value);
+    }
+
+    // RESP3 connection delivers the confirmation as push
+    bool
+    operator()(const bredis::markers::push_holder_t<Iterator> &value) const {
+        return check(value);
+    }
+
+  private:
+    template <typename Holder> bool check(const Holder &value) const {
         if ((value.elements.size() == 3) && (cmd_.arguments.size() >= 2)) {
             // check case-insentensive 1st argument, which chan be subscribe or
             // psubscribe
@@ -134,7 +198,7 @@ class check_subscription : public boost::static_visitor<bool> {
                 return false;
             }
             bool eq_cmd = std::equal(
-                cmd->from, cmd->to, cmd_.arguments[0].cbegin(),
+                cmd->from, cmd->to, cmd_.arguments[0].string().cbegin(),
                 [](const char a, const char b) {
                     return std::toupper(static_cast<unsigned char>(a)) ==
                            std::toupper(static_cast<unsigned char>(b));
@@ -150,13 +214,11 @@ class check_subscription : public boost::static_visitor<bool> {
                 return false;
             }
 
-            std::string idx_str{idx_ref->string.from, idx_ref->string.to};
-            boost::cnv::lexical_cast cnv;
-            auto idx_option = boost::convert<int>(idx_str, cnv);
-            if (!idx_option) {
+            int idx;
+            if (!details::parse_integer(idx_ref->string.from,
+                                        idx_ref->string.to, idx)) {
                 return false;
             }
-            int idx = idx_option.value();
             int size = static_cast<int>(cmd_.arguments.size());
             // out of scope
             if (idx < 1 || idx >= size) {
@@ -171,7 +233,7 @@ class check_subscription : public boost::static_visitor<bool> {
                 return false;
             }
 
-            const auto &channel_ = cmd_.arguments[idx];
+            const auto &channel_ = cmd_.arguments[idx].string();
             return std::equal(channel_.cbegin(), channel_.cend(), channel->from,
                               channel->to);
         }
@@ -179,6 +241,49 @@ class check_subscription : public boost::static_visitor<bool> {
     }
 };
 
+// Determines the protocol version from the reply to "HELLO" command, i.e.
+// the value of "proto" field of the map (RESP3) or of the flattened array
+// (RESP2). Returns 0 if it is not found, e.g. the server does not support
+// HELLO command and replied with error.
+template <typename Iterator>
+class protocol_version : public boost::static_visitor<int> {
+  public:
+    template <typename T> int operator()(const T & /*value*/) const {
+        return 0;
+    }
+
+    int operator()(const markers::map_holder_t<Iterator> &value) const {
+        return find(value);
+    }
+
+    int operator()(const markers::array_holder_t<Iterator> &value) const {
+        return find(value);
+    }
+
+  private:
+    template <typename Holder> int find(const Holder &value) const {
+        static const std::string key = "proto";
+        auto &elements = value.elements;
+        for (std::size_t i = 0; i + 1 < elements.size(); i += 2) {
+            const auto *name =
+                boost::get<markers::string_t<Iterator>>(&elements[i]);
+            if (!name ||
+                !std::equal(key.cbegin(), key.cend(), name->from, name->to)) {
+                continue;
+            }
+            const auto *proto =
+                boost::get<markers::int_t<Iterator>>(&elements[i + 1]);
+            int version;
+            if (proto && details::parse_integer(proto->string.from,
+                                                proto->string.to, version)) {
+                return version;
+            }
+            return 0;
+        }
+        return 0;
+    }
+};
+
 } // namespace marker_helpers
 
 } // namespace bredis
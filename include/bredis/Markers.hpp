@@ -10,6 +10,8 @@
 #include <boost/variant/recursive_variant.hpp>
 #include <vector>
 
+#include "Allocator.hpp"
+
 namespace bredis {
 
 namespace markers {
@@ -35,19 +37,103 @@ template <typename Iterator> struct nil_t {
     string_t<Iterator> string;
 };
 
+// RESP3 types
+
+template <typename Iterator> struct double_t {
+    using iterator_t = Iterator;
+    string_t<Iterator> string;
+};
+
+// the string is either "t" or "f"
+template <typename Iterator> struct bool_t {
+    using iterator_t = Iterator;
+    string_t<Iterator> string;
+};
+
+template <typename Iterator> struct big_number_t {
+    using iterator_t = Iterator;
+    string_t<Iterator> string;
+};
+
+// verbatim string, i.e. the string with 3-letter format, e.g. "txt"
+template <typename Iterator> struct verbatim_t {
+    using iterator_t = Iterator;
+    string_t<Iterator> format;
+    string_t<Iterator> string;
+};
+
 template <typename Iterator> struct array_holder_t;
+template <typename Iterator> struct map_holder_t;
+template <typename Iterator> struct set_holder_t;
+template <typename Iterator> struct push_holder_t;
+template <typename Iterator> struct attribute_holder_t;
 
 template <typename Iterator>
 using array_wrapper_t = boost::recursive_wrapper<array_holder_t<Iterator>>;
 
+template <typename Iterator>
+using map_wrapper_t = boost::recursive_wrapper<map_holder_t<Iterator>>;
+
+template <typename Iterator>
+using set_wrapper_t = boost::recursive_wrapper<set_holder_t<Iterator>>;
+
+template <typename Iterator>
+using push_wrapper_t = boost::recursive_wrapper<push_holder_t<Iterator>>;
+
+template <typename Iterator>
+using attribute_wrapper_t =
+    boost::recursive_wrapper<attribute_holder_t<Iterator>>;
+
 template <typename Iterator>
 using redis_result_t =
     boost::variant<int_t<Iterator>, string_t<Iterator>, error_t<Iterator>,
-                   nil_t<Iterator>, array_wrapper_t<Iterator>>;
+                   nil_t<Iterator>, array_wrapper_t<Iterator>,
+                   double_t<Iterator>, bool_t<Iterator>,
+                   big_number_t<Iterator>, verbatim_t<Iterator>,
+                   map_wrapper_t<Iterator>, set_wrapper_t<Iterator>,
+                   push_wrapper_t<Iterator>, attribute_wrapper_t<Iterator>>;
 
 template <typename Iterator> struct array_holder_t {
     using iterator_t = Iterator;
-    using recursive_array_t = std::vector<redis_result_t<Iterator>>;
+    using allocator_t = markers_allocator_t<redis_result_t<Iterator>>;
+    using recursive_array_t =
+        std::vector<redis_result_t<Iterator>, allocator_t>;
+    recursive_array_t elements;
+};
+
+// the keys and values are interleaved, i.e. key1, value1, key2, value2...
+template <typename Iterator> struct map_holder_t {
+    using iterator_t = Iterator;
+    using allocator_t = markers_allocator_t<redis_result_t<Iterator>>;
+    using recursive_array_t =
+        std::vector<redis_result_t<Iterator>, allocator_t>;
+    recursive_array_t elements;
+};
+
+template <typename Iterator> struct set_holder_t {
+    using iterator_t = Iterator;
+    using allocator_t = markers_allocator_t<redis_result_t<Iterator>>;
+    using recursive_array_t =
+        std::vector<redis_result_t<Iterator>, allocator_t>;
+    recursive_array_t elements;
+};
+
+// out-of-band data, e.g. pub/sub message or invalidation
+template <typename Iterator> struct push_holder_t {
+    using iterator_t = Iterator;
+    using allocator_t = markers_allocator_t<redis_result_t<Iterator>>;
+    using recursive_array_t =
+        std::vector<redis_result_t<Iterator>, allocator_t>;
+    recursive_array_t elements;
+};
+
+// the interleaved attribute keys and values, followed by the attributed
+// reply as the last element
+template <typename Iterator> struct attribute_holder_t {
+    using iterator_t = Iterator;
+    using allocator_t = markers_allocator_t<redis_result_t<Iterator>>;
+    using recursive_array_t =
+        std::vector<redis_result_t<Iterator>, allocator_t>;
     recursive_array_t elements;
 };
 
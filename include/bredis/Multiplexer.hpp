@@ -0,0 +1,169 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include "Command.hpp"
+#include "Connection.hpp"
+#include "Error.hpp"
+#include "Markers.hpp"
+#include "impl/buffer_pool.ipp"
+#include "impl/completion.ipp"
+
+namespace bredis {
+
+// The limits of the commands, which are sent (or queued to be sent), but
+// not replied yet; 0 means no limit. When the window is full, the new
+// command waits until it fits (or it is completed with
+// bredis_errors::window_full, if fail_fast is set). The command, which
+// exceeds the limit on its own, is admitted into the empty window.
+struct pipeline_window_t {
+    // the amount of the awaited replies
+    std::size_t max_in_flight = 0;
+    // the amount of the serialized, but not written yet, bytes
+    std::size_t max_tx_bytes = 0;
+    bool fail_fast = false;
+};
+
+// The client, which shares the single connection between many callers:
+// each command gets own reply. The commands queued within one event-loop
+// tick are written at once, the replies are read by all the available ones
+// and are dispatched to the handlers in the order of the commands.
+//
+// As Connection, it is not thread-safe: all the calls should be made from
+// the thread (or strand), which runs the stream, i.e. if io_context is run
+// by many threads, the stream must be bound to own strand; it must outlive
+// all the pending commands. The handlers are invoked via their associated
+// executors, as with the other asynchronous operations.
+template <typename NextLayer> class Multiplexer {
+  public:
+    using Buffer = boost::asio::streambuf;
+    using Iterator = typename to_iterator<Buffer>::iterator_t;
+    using reply_t = markers::redis_result_t<Iterator>;
+    using executor_type =
+        decltype(std::declval<NextLayer &>().get_executor());
+
+    // the reply markers refer to the receive buffer, which is kept alive
+    // by the result, i.e. the reply can be used after the handler returns
+    // (e.g. via std::future); while it is kept, the unread data is copied
+    // into the other buffer, which is taken from the pool of the released
+    // ones (so the cost is the copy of the partial reply); the replies of
+    // command_container_t (command_batch_t) are passed as array
+    struct result_t {
+        reply_t result;
+        std::shared_ptr<const Buffer> buffer;
+    };
+
+  private:
+    using completion_t = details::completion_t<result_t, executor_type>;
+    using buffer_pool_t = details::buffer_pool_t<Buffer>;
+    struct pending_t {
+        std::size_t replies;
+        bool wrap;
+        completion_t completion;
+    };
+    struct waiting_t {
+        std::string command;
+        std::size_t replies;
+        bool wrap;
+        completion_t completion;
+    };
+
+    Connection<NextLayer> connection_;
+    std::string queued_;
+    std::string tx_buff_;
+    std::shared_ptr<buffer_pool_t> buffers_;
+    std::shared_ptr<Buffer> rx_buff_;
+    std::deque<pending_t> pending_;
+    std::deque<waiting_t> waiting_;
+    pipeline_window_t window_;
+    std::size_t awaited_;
+    bool flush_scheduled_;
+    bool writing_;
+    bool reading_;
+    boost::system::error_code error_;
+
+  public:
+    template <typename... Args>
+    explicit Multiplexer(Args &&... args)
+        : connection_(std::forward<Args>(args)...),
+          buffers_{std::make_shared<buffer_pool_t>(4)},
+          rx_buff_{buffers_->acquire()}, awaited_{0},
+          flush_scheduled_{false}, writing_{false}, reading_{false} {}
+
+    Multiplexer(const Multiplexer &) = delete;
+
+    inline Connection<NextLayer> &connection() { return connection_; }
+    inline NextLayer &next_layer() { return connection_.next_layer(); }
+    executor_type get_executor() { return next_layer().get_executor(); }
+
+    // the command is serialized immediately, i.e. its arguments need not
+    // outlive the call; after the I/O error all the pending and the
+    // further commands are completed with it
+    template <typename CompletionToken>
+    BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+                                  void(boost::system::error_code, result_t))
+    async_execute(const command_wrapper_t &command, CompletionToken &&token);
+
+    // the already serialized commands (e.g. by write_command); replies is
+    // the amount of them, they are passed as array if wrap is set (it
+    // must be set for more than one reply)
+    template <typename CompletionToken>
+    BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+                                  void(boost::system::error_code, result_t))
+    async_send(boost::string_ref serialized, std::size_t replies, bool wrap,
+               CompletionToken &&token);
+
+    // the amount of the commands waiting for the reply
+    std::size_t pending() const { return pending_.size(); }
+
+    // the amount of the commands waiting for the room in the window
+    std::size_t waiting() const { return waiting_.size(); }
+
+    // the amount of the awaited replies
+    std::size_t in_flight() const { return awaited_; }
+
+    // there are no commands and no operations in progress, i.e. it can be
+    // safely destroyed
+    bool idle() const {
+        return pending_.empty() && waiting_.empty() && !flush_scheduled_ &&
+               !writing_ && !reading_;
+    }
+
+    // the I/O error, which the multiplexer has failed with
+    const boost::system::error_code &error() const { return error_; }
+
+    // the new limits are applied to the further commands
+    void set_window(const pipeline_window_t &window);
+    const pipeline_window_t &window() const { return window_; }
+
+  private:
+    template <typename Writer>
+    void submit(std::size_t replies, bool wrap, std::size_t size,
+                Writer &&writer, completion_t completion);
+    bool fits(std::size_t replies, std::size_t size) const;
+    void admit();
+    void schedule_flush();
+    void write();
+    void read();
+    void read_front();
+    void on_replies(const boost::system::error_code &ec, reply_t &replies,
+                    std::size_t count, std::size_t consumed);
+    void fail(const boost::system::error_code &ec);
+};
+
+} // namespace bredis
+
+#include "impl/multiplexer.ipp"
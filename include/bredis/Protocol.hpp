@@ -10,6 +10,7 @@
 #include <ostream>
 #include <string>
 
+#include "Allocator.hpp"
 #include "Command.hpp"
 #include "Result.hpp"
 
@@ -17,14 +18,25 @@ namespace bredis {
 
 class Protocol {
   public:
+    // the kept markers are allocated from the resource, if it is specified
     template <typename Iterator, typename Policy = parsing_policy::keep_result>
-    static inline parse_result_t<Iterator, Policy> parse(const Iterator &from,
-                                                         const Iterator &to);
+    static inline parse_result_t<Iterator, Policy>
+    parse(const Iterator &from, const Iterator &to,
+          memory_resource_t *resource = nullptr);
 
     static inline std::ostream &serialize(std::ostream &buff,
                                           const single_command_t &cmd);
+
+    // the exact size of the serialized command
+    static inline std::size_t serialized_size(const single_command_t &cmd);
+
+    // writes the command into the memory of at least serialized_size(cmd)
+    // bytes, returns the end of the written data
+    static inline char *serialize(char *out, const single_command_t &cmd);
 };
 
 } // namespace bredis
 
 #include "impl/protocol.ipp"
+#include "impl/incremental_parser.ipp"
+#include "impl/tape.ipp"
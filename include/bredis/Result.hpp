@@ -18,6 +18,7 @@
 
 #include "Error.hpp"
 #include "Markers.hpp"
+#include "Tape.hpp"
 
 namespace bredis {
 
@@ -28,6 +29,9 @@ template <typename DynamicBuffer> struct to_iterator {
 
 struct protocol_error_t {
     boost::system::error_code code;
+    // the size of the well-formed reply, which cannot be decoded (see
+    // parsing_policy::decode_to), i.e. it can be skipped; 0 otherwise
+    size_t consumed = 0;
 };
 
 struct not_enough_data_t {};
@@ -35,6 +39,10 @@ struct not_enough_data_t {};
 namespace parsing_policy {
 struct drop_result {};
 struct keep_result {};
+// the reply is kept as flat tape_reply_t instead of nested markers
+struct keep_tape {};
+// the reply is decoded into T, see decoder_t
+template <typename T> struct decode_to {};
 } // namespace parsing_policy
 
 template <typename Iterator, typename Policy> struct positive_parse_result_t {
@@ -47,6 +55,37 @@ struct positive_parse_result_t<Iterator, parsing_policy::drop_result> {
     size_t consumed;
 };
 
+template <typename Iterator>
+struct positive_parse_result_t<Iterator, parsing_policy::keep_tape> {
+    tape_reply_t<Iterator> result;
+    size_t consumed;
+};
+
+template <typename Iterator, typename T>
+struct positive_parse_result_t<Iterator, parsing_policy::decode_to<T>> {
+    T result;
+    size_t consumed;
+};
+
+// The result of the streaming read of bulk string
+struct stream_result_t {
+    // the bulk string payload has been passed to the sink; otherwise the
+    // reply (e.g. nil or error) is left intact in the receive buffer
+    bool streamed;
+    // the payload size
+    size_t size;
+};
+
+// The result of the element-by-element read of aggregate reply
+struct elements_result_t {
+    // the elements have been passed to the handler; otherwise the reply
+    // (e.g. nil or error) is left intact in the receive buffer
+    bool delivered;
+    // the amount of elements (keys and values are counted separately
+    // for maps)
+    size_t count;
+};
+
 template <typename Iterator, typename Policy> struct parse_result_mapper {
     using type = positive_parse_result_t<Iterator, Policy>;
 };
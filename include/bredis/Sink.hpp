@@ -0,0 +1,73 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <ostream>
+
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace bredis {
+
+// The receiver of the streamed bulk string payload. Any callable with
+// the signature
+//
+//   void(const char *data, std::size_t size, boost::system::error_code &ec)
+//
+// can be used as a sink; setting ec aborts the read operation.
+
+// writes the payload into std::ostream (e.g. std::ofstream)
+class ostream_sink_t {
+    std::ostream &os_;
+
+  public:
+    explicit ostream_sink_t(std::ostream &os) : os_{os} {}
+
+    void operator()(const char *data, std::size_t size,
+                    boost::system::error_code &ec) {
+        os_.write(data, static_cast<std::streamsize>(size));
+        if (!os_) {
+            ec = boost::asio::error::broken_pipe;
+        }
+    }
+};
+
+#if !defined(_WIN32)
+// writes the payload into the file descriptor (file, pipe, socket etc.)
+class fd_sink_t {
+    int fd_;
+
+  public:
+    explicit fd_sink_t(int fd) : fd_{fd} {}
+
+    void operator()(const char *data, std::size_t size,
+                    boost::system::error_code &ec) {
+        while (size) {
+            auto written = ::write(fd_, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ec = boost::system::error_code(
+                    errno, boost::system::system_category());
+                return;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }
+};
+#endif
+
+} // namespace bredis
@@ -0,0 +1,240 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "Allocator.hpp"
+#include "Markers.hpp"
+
+namespace bredis {
+
+enum class tape_kind_t : std::uint8_t {
+    string,
+    error,
+    int_,
+    nil,
+    array,
+    // RESP3 types
+    double_,
+    bool_,
+    big_number,
+    verbatim,
+    map,
+    set,
+    push,
+    attribute
+};
+
+// i.e. array, map, set, push or attribute
+inline bool is_aggregate(tape_kind_t kind) {
+    return kind == tape_kind_t::array || kind >= tape_kind_t::map;
+}
+
+// Position-independent marker: it refers the buffer via offset from the
+// buffer beginning, so it stays valid when the buffer is re-allocated
+// during the read operation. Nodes are stored in the pre-order.
+struct tape_node_t {
+    std::size_t offset;
+    // string length or aggregate elements count (keys and values are
+    // counted separately for maps and attributes)
+    std::size_t size;
+    // amount of nodes in the subtree, including the node itself
+    std::uint32_t skip;
+    tape_kind_t kind;
+};
+
+// Flat reply representation: the whole reply (no matter how deeply nested)
+// occupies a single vector of nodes.
+struct tape_t {
+    template <typename T>
+    using vector_t = std::vector<T, markers_allocator_t<T>>;
+
+    vector_t<tape_node_t> nodes;
+    // indices of the not yet completed arrays
+    vector_t<std::size_t> open_arrays;
+
+    tape_t() = default;
+    explicit tape_t(memory_resource_t *resource)
+        : nodes(markers_allocator_t<tape_node_t>{resource}),
+          open_arrays(markers_allocator_t<std::size_t>{resource}) {}
+
+    memory_resource_t *resource() const {
+        return nodes.get_allocator().resource();
+    }
+
+    void push(tape_kind_t kind, std::size_t offset, std::size_t size) {
+        nodes.push_back(tape_node_t{offset, size, 1, kind});
+    }
+
+    void open(tape_kind_t kind, std::size_t count) {
+        open_arrays.push_back(nodes.size());
+        nodes.push_back(tape_node_t{0, count, 1, kind});
+    }
+
+    void close() {
+        auto idx = open_arrays.back();
+        open_arrays.pop_back();
+        nodes[idx].skip = static_cast<std::uint32_t>(nodes.size() - idx);
+    }
+
+    // groups all the recorded top-level nodes into an array
+    void wrap(std::size_t count) {
+        auto skip = static_cast<std::uint32_t>(nodes.size() + 1);
+        nodes.insert(nodes.begin(),
+                     tape_node_t{0, count, skip, tape_kind_t::array});
+    }
+};
+
+template <typename Iterator> class tape_array_t;
+
+// Lightweight (non-owning) pointer to a tape node. The markers of strings
+// are created on demand from the buffer beginning and the node offset.
+template <typename Iterator> class tape_cursor_t {
+    const tape_node_t *node_;
+    Iterator begin_;
+
+  public:
+    tape_cursor_t() : node_{nullptr} {}
+    tape_cursor_t(const tape_node_t *node, const Iterator &begin)
+        : node_{node}, begin_{begin} {}
+
+    tape_kind_t kind() const { return node_->kind; }
+
+    // string length or array elements count
+    std::size_t size() const { return node_->size; }
+
+    // the string of non-aggregate node; the whole payload for verbatim
+    markers::string_t<Iterator> string() const {
+        auto from = begin_;
+        std::advance(from, node_->offset);
+        auto to = from;
+        std::advance(to, node_->size);
+        return markers::string_t<Iterator>{from, to};
+    }
+
+    markers::verbatim_t<Iterator> verbatim() const {
+        auto str = string();
+        auto format_end = str.from;
+        std::advance(format_end, 3);
+        auto payload = format_end;
+        ++payload;
+        return markers::verbatim_t<Iterator>{{str.from, format_end},
+                                             {payload, str.to}};
+    }
+
+    tape_array_t<Iterator> array() const {
+        return tape_array_t<Iterator>{*this};
+    }
+
+    // Invokes visitor with the marker of the node, i.e. with string_t,
+    // error_t, int_t, nil_t, double_t, bool_t, big_number_t, verbatim_t
+    // or with tape_array_t for aggregates. The visitor defines result_type,
+    // as boost::static_visitor does.
+    template <typename Visitor>
+    typename std::decay_t<Visitor>::result_type visit(Visitor &&visitor) const {
+        switch (node_->kind) {
+        case tape_kind_t::error:
+            return visitor(markers::error_t<Iterator>{string()});
+        case tape_kind_t::int_:
+            return visitor(markers::int_t<Iterator>{string()});
+        case tape_kind_t::nil:
+            return visitor(markers::nil_t<Iterator>{string()});
+        case tape_kind_t::double_:
+            return visitor(markers::double_t<Iterator>{string()});
+        case tape_kind_t::bool_:
+            return visitor(markers::bool_t<Iterator>{string()});
+        case tape_kind_t::big_number:
+            return visitor(markers::big_number_t<Iterator>{string()});
+        case tape_kind_t::verbatim:
+            return visitor(verbatim());
+        case tape_kind_t::string:
+            return visitor(string());
+        default:
+            return visitor(array());
+        }
+    }
+
+    // the sibling node, i.e. the next element of the enclosing aggregate
+    tape_cursor_t next() const {
+        return tape_cursor_t{node_ + node_->skip, begin_};
+    }
+
+    // the first element of aggregate node
+    tape_cursor_t child() const { return tape_cursor_t{node_ + 1, begin_}; }
+
+    bool operator==(const tape_cursor_t &other) const {
+        return node_ == other.node_;
+    }
+    bool operator!=(const tape_cursor_t &other) const {
+        return node_ != other.node_;
+    }
+};
+
+// The elements range of aggregate node
+template <typename Iterator> class tape_array_t {
+    tape_cursor_t<Iterator> cursor_;
+
+  public:
+    class iterator {
+        tape_cursor_t<Iterator> cursor_;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = tape_cursor_t<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        iterator() = default;
+        explicit iterator(const tape_cursor_t<Iterator> &cursor)
+            : cursor_{cursor} {}
+
+        reference operator*() const { return cursor_; }
+        pointer operator->() const { return &cursor_; }
+        iterator &operator++() {
+            cursor_ = cursor_.next();
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator copy{*this};
+            ++(*this);
+            return copy;
+        }
+        bool operator==(const iterator &other) const {
+            return cursor_ == other.cursor_;
+        }
+        bool operator!=(const iterator &other) const {
+            return cursor_ != other.cursor_;
+        }
+    };
+
+    explicit tape_array_t(const tape_cursor_t<Iterator> &cursor)
+        : cursor_{cursor} {}
+
+    tape_kind_t kind() const { return cursor_.kind(); }
+    std::size_t size() const { return cursor_.size(); }
+    iterator begin() const { return iterator{cursor_.child()}; }
+    iterator end() const { return iterator{cursor_.next()}; }
+};
+
+// The reply parsed with parsing_policy::keep_tape; the markers refer
+// the buffer, so it must not be consumed while the reply is in use.
+template <typename Iterator> struct tape_reply_t {
+    tape_t tape;
+    Iterator begin;
+
+    tape_cursor_t<Iterator> root() const {
+        return tape_cursor_t<Iterator>{tape.nodes.data(), begin};
+    }
+};
+
+} // namespace bredis
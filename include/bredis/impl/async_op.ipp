@@ -9,7 +9,12 @@
 
 #include "../Protocol.hpp"
 #include "../Result.hpp"
+#include "tape.ipp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 #include <boost/asio.hpp>
@@ -24,27 +29,25 @@ struct result_handler_t<Iterator, parsing_policy::drop_result> {
     using policy_t = parsing_policy::drop_result;
     using positive_result_t = parse_result_mapper_t<Iterator, policy_t>;
 
-    std::size_t replies_count;
-    size_t cumulative_consumption;
-    size_t count;
-    positive_result_t result;
+    details::drop_events_t drop_events;
 
-    result_handler_t(std::size_t replies_count_)
-        : replies_count{replies_count_},
-          cumulative_consumption{0}, count{0}, result{0} {}
+    result_handler_t(memory_resource_t * /*resource*/) {}
 
-    void init() {
-        // NO-OP;
+    template <typename DataIterator>
+    details::drop_events_t &events(const DataIterator & /*begin*/) {
+        return drop_events;
     }
 
-    bool on_result(positive_result_t &&parse_result) {
-        ++count;
-        cumulative_consumption += parse_result.consumed;
-        return count < replies_count;
-    }
+    std::size_t mark() const { return 0; }
+
+    void rollback(std::size_t /*mark*/) {}
 
-    void complete_result() {
-        result = positive_result_t{cumulative_consumption};
+    positive_result_t complete_result(const Iterator & /*begin*/,
+                                      std::size_t /*replies_count*/,
+                                      bool /*wrap*/,
+                                      size_t cumulative_consumption,
+                                      boost::system::error_code & /*ec*/) {
+        return positive_result_t{cumulative_consumption};
     }
 };
 
@@ -52,104 +55,283 @@ template <typename Iterator>
 struct result_handler_t<Iterator, parsing_policy::keep_result> {
     using policy_t = parsing_policy::keep_result;
     using positive_result_t = parse_result_mapper_t<Iterator, policy_t>;
+    using array_t = markers::array_holder_t<Iterator>;
+    using allocator_t = typename array_t::allocator_t;
 
-    std::size_t replies_count;
-    size_t cumulative_consumption;
-    size_t count;
-    positive_result_t result;
-    markers::array_holder_t<Iterator> tmp_results;
+    tape_t tape;
 
-    result_handler_t(std::size_t replies_count_)
-        : replies_count{replies_count_}, cumulative_consumption{0}, count{0} {}
+    result_handler_t(memory_resource_t *resource) : tape{resource} {}
 
-    void init() { tmp_results.elements.reserve(replies_count); }
+    template <typename DataIterator>
+    details::tape_builder_t<DataIterator> events(const DataIterator &begin) {
+        return details::tape_builder_t<DataIterator>{tape, begin};
+    }
 
-    bool on_result(positive_result_t &&parse_result) {
-        tmp_results.elements.emplace_back(std::move(parse_result.result));
-        ++count;
-        cumulative_consumption += parse_result.consumed;
-        return count < replies_count;
+    // the recorded nodes of the not yet complete reply can be dropped
+    std::size_t mark() const { return tape.nodes.size(); }
+
+    void rollback(std::size_t mark) {
+        tape.nodes.resize(mark);
+        tape.open_arrays.clear();
     }
 
-    void complete_result() {
-        if (replies_count == 1) {
-            result = positive_result_t{std::move(tmp_results.elements[0]),
-                                       cumulative_consumption};
-        } else {
-            result = positive_result_t{std::move(tmp_results),
-                                       cumulative_consumption};
+    positive_result_t complete_result(const Iterator &begin,
+                                      std::size_t replies_count, bool wrap,
+                                      size_t cumulative_consumption,
+                                      boost::system::error_code & /*ec*/) {
+        details::tape_materializer_t<Iterator> materializer(tape, begin);
+        if (!wrap) {
+            return positive_result_t{materializer.next(),
+                                     cumulative_consumption};
+        }
+        array_t results{typename array_t::recursive_array_t(
+            allocator_t{tape.resource()})};
+        results.elements.reserve(replies_count);
+        for (std::size_t i = 0; i < replies_count; ++i) {
+            results.elements.emplace_back(materializer.next());
         }
+        return positive_result_t{std::move(results), cumulative_consumption};
     }
 };
 
-template <typename DynamicBuffer, typename Policy> struct async_read_op_impl {
-    DynamicBuffer &rx_buff_;
-    std::size_t replies_count_;
+template <typename Iterator>
+struct result_handler_t<Iterator, parsing_policy::keep_tape> {
+    using policy_t = parsing_policy::keep_tape;
+    using positive_result_t = parse_result_mapper_t<Iterator, policy_t>;
+
+    tape_t tape;
+
+    result_handler_t(memory_resource_t *resource) : tape{resource} {}
+
+    template <typename DataIterator>
+    details::tape_builder_t<DataIterator> events(const DataIterator &begin) {
+        return details::tape_builder_t<DataIterator>{tape, begin};
+    }
+
+    // the recorded nodes of the not yet complete reply can be dropped
+    std::size_t mark() const { return tape.nodes.size(); }
+
+    void rollback(std::size_t mark) {
+        tape.nodes.resize(mark);
+        tape.open_arrays.clear();
+    }
+
+    positive_result_t complete_result(const Iterator &begin,
+                                      std::size_t replies_count, bool wrap,
+                                      size_t cumulative_consumption,
+                                      boost::system::error_code & /*ec*/) {
+        if (wrap) {
+            tape.wrap(replies_count);
+        }
+        return positive_result_t{tape_reply_t<Iterator>{std::move(tape), begin},
+                                 cumulative_consumption};
+    }
+};
 
-    async_read_op_impl(DynamicBuffer &rx_buff, std::size_t replies_count)
-        : rx_buff_{rx_buff}, replies_count_{replies_count} {}
+template <typename Iterator, typename T>
+struct result_handler_t<Iterator, parsing_policy::decode_to<T>> {
+    using policy_t = parsing_policy::decode_to<T>;
+    using positive_result_t = parse_result_mapper_t<Iterator, policy_t>;
+
+    tape_t tape;
+
+    result_handler_t(memory_resource_t *resource) : tape{resource} {}
+
+    template <typename DataIterator>
+    details::tape_builder_t<DataIterator> events(const DataIterator &begin) {
+        return details::tape_builder_t<DataIterator>{tape, begin};
+    }
+
+    // the recorded nodes of the not yet complete reply can be dropped
+    std::size_t mark() const { return tape.nodes.size(); }
+
+    void rollback(std::size_t mark) {
+        tape.nodes.resize(mark);
+        tape.open_arrays.clear();
+    }
+
+    // the consumption is reported even if the reply does not match T
+    positive_result_t complete_result(const Iterator &begin,
+                                      std::size_t replies_count, bool wrap,
+                                      size_t cumulative_consumption,
+                                      boost::system::error_code &ec) {
+        if (wrap) {
+            tape.wrap(replies_count);
+        }
+        positive_result_t result{T{}, cumulative_consumption};
+        tape_cursor_t<Iterator> root{tape.nodes.data(), begin};
+        if (!decode(root, result.result)) {
+            ec = Error::make_error_code(details::mismatch_of(root));
+        }
+        return result;
+    }
+};
+
+// The read operation state: the replies are parsed (in a single pass) as
+// they arrive into rx_buff, and the result is assembled once all of
+// the expected replies are available.
+//
+// When the received data occupies a single contiguous memory region (which
+// is always the case for asio::streambuf), it is parsed via plain pointers,
+// avoiding the segment checks of buffers_iterator on every byte access.
+//
+// The kept markers (or tape) are allocated from the memory resource,
+// if it is specified.
+//
+// In the "available" mode the replies_count is the maximum (0 means no
+// limit), and the read is done once at least one reply is complete and
+// the buffered data is exhausted; the replies are always wrapped into
+// array then.
+template <typename DynamicBuffer, typename Policy> class async_read_op_impl {
     using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
     using ResultHandler = result_handler_t<Iterator, Policy>;
     using positive_result_t = parse_result_mapper_t<Iterator, Policy>;
 
-    positive_result_t op(boost::system::error_code &error_code,
-                         std::size_t /*bytes_transferred*/) {
+    std::size_t replies_count_;
+    std::size_t matched_results_;
+    std::size_t consumed_;
+    std::size_t needed_;
+    bool available_;
+    boost::system::error_code error_code_;
+    details::incremental_parser_t parser_;
+    ResultHandler result_handler_;
+
+  public:
+    async_read_op_impl(std::size_t replies_count,
+                       memory_resource_t *resource = nullptr,
+                       bool available = false)
+        : replies_count_{available && !replies_count ? SIZE_MAX
+                                                     : replies_count},
+          matched_results_{0}, consumed_{0}, needed_{0},
+          available_{available}, result_handler_{resource} {}
+
+    bool done() const {
+        return error_code_ || matched_results_ == replies_count_;
+    }
+
+    const boost::system::error_code &error() const { return error_code_; }
+
+    // parses the newly arrived data, returns true if the read is done
+    bool feed(const DynamicBuffer &rx_buff) {
+        namespace asio = boost::asio;
+
+        auto const_buff = rx_buff.data();
+        auto first = asio::buffer_sequence_begin(const_buff);
+        auto last = asio::buffer_sequence_end(const_buff);
+        if (first == last) {
+            return done();
+        }
+        if (std::next(first) == last) {
+            asio::const_buffer contiguous_buff(*first);
+            auto begin = static_cast<const char *>(contiguous_buff.data());
+            return feed(begin, begin + contiguous_buff.size());
+        }
+        return feed(Iterator::begin(const_buff), Iterator::end(const_buff));
+    }
 
-        ResultHandler result_handler(replies_count_);
+    // the amount of bytes to be requested from the stream, the same as
+    // boost::asio::read_until does; the rest of the pending bulk string
+    // is requested at once, up to BREDIS_MAX_READ_SIZE
+    std::size_t read_size(const DynamicBuffer &rx_buff) const {
+        auto room = rx_buff.max_size() - rx_buff.size();
+        auto size = std::min<std::size_t>(
+            std::max<std::size_t>(512, rx_buff.capacity() - rx_buff.size()),
+            std::min<std::size_t>(65536, room));
+        auto pending = std::min<std::size_t>(needed_, BREDIS_MAX_READ_SIZE);
+        return std::max(size, std::min(pending, room));
+    }
 
-        if (!error_code) {
-            auto const_buff = rx_buff_.data();
-            auto begin = Iterator::begin(const_buff);
-            auto end = Iterator::end(const_buff);
+    // the amount of bytes, which should be read before the next feed,
+    // see incremental_result_t::needed
+    std::size_t needed() const { return needed_; }
 
-            result_handler.init();
+    // the amount of the complete replies
+    std::size_t replies() const { return matched_results_; }
 
-            bool continue_parsing;
-            do {
-                using boost::get;
-                auto parse_result =
-                    Protocol::parse<Iterator, Policy>(begin, end);
-                auto *parse_error = boost::get<protocol_error_t>(&parse_result);
-                if (parse_error) {
-                    error_code = parse_error->code;
-                    continue_parsing = false;
-                } else {
-                    auto &positive_result =
-                        get<positive_result_t>(parse_result);
-                    begin += positive_result.consumed;
-                    continue_parsing =
-                        result_handler.on_result(std::move(positive_result));
-                }
-            } while (continue_parsing);
+    // the result might fail to be assembled (e.g. it does not match the
+    // decoded type), then the error is set; the markers refer to the
+    // const_buff sequence (i.e. rx_buff.data()), so it must outlive them
+    positive_result_t
+    result(const typename DynamicBuffer::const_buffers_type &const_buff) {
+        if (error_code_ || !done()) {
+            return positive_result_t{};
+        }
+        bool wrap = available_ || replies_count_ != 1;
+        return result_handler_.complete_result(Iterator::begin(const_buff),
+                                               replies_count_, wrap,
+                                               consumed_, error_code_);
+    }
 
-            /* check again, as protocol error might be met */
-            if (!error_code) {
-                result_handler.complete_result();
+  private:
+    template <typename DataIterator>
+    bool feed(const DataIterator &begin, const DataIterator &end) {
+        auto &&events = result_handler_.events(begin);
+
+        while (!done()) {
+            auto reply_start = consumed_;
+            auto mark = result_handler_.mark();
+            auto parse_result = parser_.feed(begin + consumed_, end, events);
+            if (parse_result.error) {
+                error_code_ = parse_result.error;
+                break;
             }
+            consumed_ += parse_result.consumed;
+            if (!parse_result.complete) {
+                needed_ = parse_result.needed;
+                if (available_ && matched_results_) {
+                    // the incomplete reply is left for the next read
+                    consumed_ = reply_start;
+                    result_handler_.rollback(mark);
+                    replies_count_ = matched_results_;
+                    return true;
+                }
+                return false;
+            }
+            ++matched_results_;
         }
-        return result_handler.result;
+        return true;
     }
 };
 
+// The Available flag selects the async_read_available flavour, which
+// also reports the amount of the replies to the callback
 template <typename NextLayer, typename DynamicBuffer, typename ReadCallback,
-          typename Policy>
+          typename Policy, bool Available = false>
 class async_read_op {
     NextLayer &stream_;
     DynamicBuffer &rx_buff_;
-    std::size_t replies_count_;
+    async_read_op_impl<DynamicBuffer, Policy> impl_;
     ReadCallback callback_;
 
+    using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
+    using positive_result_t = parse_result_mapper_t<Iterator, Policy>;
+
+    void complete(const boost::system::error_code &error_code,
+                  positive_result_t &&result, std::false_type) {
+        callback_(error_code, std::move(result));
+    }
+
+    void complete(const boost::system::error_code &error_code,
+                  positive_result_t &&result, std::true_type) {
+        callback_(error_code, std::move(result), impl_.replies());
+    }
+
   public:
     async_read_op(async_read_op &&) = default;
     async_read_op(const async_read_op &) = default;
 
     template <class DeducedHandler>
     async_read_op(DeducedHandler &&deduced_handler, NextLayer &stream,
-                  DynamicBuffer &rx_buff, std::size_t replies_count)
-        : stream_(stream), rx_buff_(rx_buff), replies_count_(replies_count),
+                  DynamicBuffer &rx_buff, std::size_t replies_count,
+                  memory_resource_t *resource = nullptr)
+        : stream_(stream), rx_buff_(rx_buff),
+          impl_(replies_count, resource, Available),
           callback_(std::forward<ReadCallback>(deduced_handler)) {}
 
-    void operator()(boost::system::error_code, std::size_t bytes_transferred);
+    void operator()(boost::system::error_code, std::size_t bytes_transferred,
+                    bool start = false);
+
+    const ReadCallback &callback() const { return callback_; }
 
     friend bool asio_handler_is_continuation(async_read_op *op) {
         using boost::asio::asio_handler_is_continuation;
@@ -175,14 +357,88 @@ class async_read_op {
 };
 
 template <typename NextLayer, typename DynamicBuffer, typename ReadCallback,
-          typename Policy>
-void async_read_op<NextLayer, DynamicBuffer, ReadCallback, Policy>::
+          typename Policy, bool Available>
+void async_read_op<NextLayer, DynamicBuffer, ReadCallback, Policy, Available>::
 operator()(boost::system::error_code error_code,
-           std::size_t bytes_transferred) {
-    using op_impl = async_read_op_impl<DynamicBuffer, Policy>;
-    callback_(
-        error_code,
-        op_impl(rx_buff_, replies_count_).op(error_code, bytes_transferred));
+           std::size_t bytes_transferred, bool start) {
+    if (!start) {
+        rx_buff_.commit(bytes_transferred);
+    }
+    if (!error_code && !impl_.done()) {
+        if (!impl_.feed(rx_buff_)) {
+            if (rx_buff_.size() == rx_buff_.max_size()) {
+                error_code = boost::asio::error::not_found;
+            } else {
+                auto buffers = rx_buff_.prepare(impl_.read_size(rx_buff_));
+                auto needed = impl_.needed();
+                if (needed > 1) {
+                    // the known-length payload is awaited without feeding
+                    // its parts to the parser
+                    boost::asio::async_read(
+                        stream_, buffers,
+                        boost::asio::transfer_at_least(needed),
+                        std::move(*this));
+                } else {
+                    stream_.async_read_some(buffers, std::move(*this));
+                }
+                return;
+            }
+        } else if (start) {
+            // all replies are already in the buffer; still the callback
+            // must not be invoked from within the initiating function
+            stream_.async_read_some(boost::asio::mutable_buffer(),
+                                    std::move(*this));
+            return;
+        }
+    }
+    // the buffer sequence is alive until the callback returns
+    auto const_buff = rx_buff_.data();
+    auto result = impl_.result(const_buff);
+    if (!error_code) {
+        error_code = impl_.error();
+    }
+    complete(error_code, std::move(result),
+             std::integral_constant<bool, Available>{});
 }
 
 } // namespace bredis
+
+namespace boost {
+namespace asio {
+
+template <typename NextLayer, typename DynamicBuffer, typename ReadCallback,
+          typename Policy, bool Available, typename Executor>
+struct associated_executor<bredis::async_read_op<NextLayer, DynamicBuffer,
+                                                 ReadCallback, Policy,
+                                                 Available>,
+                           Executor> {
+    using type = associated_executor_t<ReadCallback, Executor>;
+
+    static type get(const bredis::async_read_op<NextLayer, DynamicBuffer,
+                                                ReadCallback, Policy,
+                                                Available> &op,
+                    const Executor &executor = Executor()) noexcept {
+        return associated_executor<ReadCallback, Executor>::get(op.callback(),
+                                                                executor);
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename ReadCallback,
+          typename Policy, bool Available, typename Allocator>
+struct associated_allocator<bredis::async_read_op<NextLayer, DynamicBuffer,
+                                                  ReadCallback, Policy,
+                                                  Available>,
+                            Allocator> {
+    using type = associated_allocator_t<ReadCallback, Allocator>;
+
+    static type get(const bredis::async_read_op<NextLayer, DynamicBuffer,
+                                                 ReadCallback, Policy,
+                                                 Available> &op,
+                    const Allocator &allocator = Allocator()) noexcept {
+        return associated_allocator<ReadCallback, Allocator>::get(
+            op.callback(), allocator);
+    }
+};
+
+} // namespace asio
+} // namespace boost
@@ -0,0 +1,70 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bredis {
+
+namespace details {
+
+// The receive buffers, which are returned by their last holder (i.e. the
+// last reply, which refers to the buffer), to be reused with the capacity
+// they have grown to; at most capacity of them are kept. The buffer may
+// be released from any thread (e.g. by the future holder), so the free
+// list is guarded; the pool is kept alive by the buffers it has given out.
+template <typename Buffer>
+class buffer_pool_t
+    : public std::enable_shared_from_this<buffer_pool_t<Buffer>> {
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> free_;
+    std::size_t capacity_;
+
+    void release(Buffer *buffer) {
+        std::unique_ptr<Buffer> holder(buffer);
+        holder->consume(holder->size());
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < capacity_) {
+            free_.push_back(std::move(holder));
+        }
+    }
+
+  public:
+    explicit buffer_pool_t(std::size_t capacity) : capacity_{capacity} {}
+
+    std::shared_ptr<Buffer> acquire() {
+        std::unique_ptr<Buffer> buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                buffer = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        if (!buffer) {
+            buffer.reset(new Buffer());
+        }
+        auto self = this->shared_from_this();
+        return std::shared_ptr<Buffer>(
+            buffer.release(),
+            [self](Buffer *released) { self->release(released); });
+    }
+
+    // the amount of the buffers, which are ready to be reused
+    std::size_t available() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return free_.size();
+    }
+};
+
+} // namespace details
+
+} // namespace bredis
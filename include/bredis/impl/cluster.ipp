@@ -0,0 +1,735 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "../Protocol.hpp"
+#include "common.ipp"
+#include "numbers.ipp"
+
+namespace bredis {
+
+namespace details {
+
+struct crc16_table_t {
+    std::uint16_t values[256];
+};
+
+// CRC16-CCITT (XMODEM), as used by Redis Cluster
+constexpr crc16_table_t make_crc16_table() {
+    crc16_table_t table{};
+    for (unsigned i = 0; i < 256; ++i) {
+        unsigned crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        table.values[i] = static_cast<std::uint16_t>(crc);
+    }
+    return table;
+}
+
+inline std::uint16_t crc16(const char *data, std::size_t size) {
+    static constexpr crc16_table_t table = make_crc16_table();
+    std::uint16_t crc = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        auto byte = static_cast<unsigned char>(data[i]);
+        crc = static_cast<std::uint16_t>((crc << 8) ^
+                                         table.values[(crc >> 8) ^ byte]);
+    }
+    return crc;
+}
+
+// reads the "<intro><number>\r\n" header of the serialized command
+inline bool read_header(boost::string_ref &data, char intro,
+                        std::size_t &value) {
+    auto end = data.find("\r\n");
+    if (data.empty() || data[0] != intro || end == boost::string_ref::npos) {
+        return false;
+    }
+    long long number;
+    if (!parse_integer(data.data() + 1, data.data() + end, number) ||
+        number < 0) {
+        return false;
+    }
+    value = static_cast<std::size_t>(number);
+    data.remove_prefix(end + 2);
+    return true;
+}
+
+// all the arguments of the serialized single command
+inline bool command_arguments(boost::string_ref serialized,
+                              std::vector<boost::string_ref> &arguments) {
+    std::size_t count, size;
+    if (!read_header(serialized, '*', count)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!read_header(serialized, '$', size) ||
+            serialized.size() < size + 2) {
+            return false;
+        }
+        arguments.push_back(serialized.substr(0, size));
+        serialized.remove_prefix(size + 2);
+    }
+    return true;
+}
+
+// the key, which the command is routed by: the first argument after the
+// command name, unless the command is known to have it elsewhere
+inline boost::optional<boost::string_ref>
+command_key(const std::vector<boost::string_ref> &arguments) {
+    enum class rule_t {
+        // the key is at the position
+        at,
+        // the amount of the keys is at the position, the keys follow it
+        numkeys,
+        // the keys follow the STREAMS argument
+        streams
+    };
+    struct command_t {
+        const char *name;
+        rule_t rule;
+        std::size_t position;
+    };
+    static const command_t commands[] = {
+        {"EVAL", rule_t::numkeys, 2},       {"EVALSHA", rule_t::numkeys, 2},
+        {"EVAL_RO", rule_t::numkeys, 2},    {"EVALSHA_RO", rule_t::numkeys, 2},
+        {"FCALL", rule_t::numkeys, 2},      {"FCALL_RO", rule_t::numkeys, 2},
+        {"ZUNION", rule_t::numkeys, 1},     {"ZINTER", rule_t::numkeys, 1},
+        {"ZDIFF", rule_t::numkeys, 1},      {"ZINTERCARD", rule_t::numkeys, 1},
+        {"SINTERCARD", rule_t::numkeys, 1}, {"LMPOP", rule_t::numkeys, 1},
+        {"ZMPOP", rule_t::numkeys, 1},      {"BLMPOP", rule_t::numkeys, 2},
+        {"BZMPOP", rule_t::numkeys, 2},     {"XREAD", rule_t::streams, 1},
+        {"XREADGROUP", rule_t::streams, 1}, {"BITOP", rule_t::at, 2},
+        {"OBJECT", rule_t::at, 2},          {"MEMORY", rule_t::at, 2},
+        {"XINFO", rule_t::at, 2},           {"XGROUP", rule_t::at, 2}};
+
+    if (arguments.size() < 2) {
+        return boost::none;
+    }
+    auto &name = arguments.front();
+    auto command = std::find_if(
+        std::begin(commands), std::end(commands), [&](const command_t &c) {
+            return boost::algorithm::iequals(name, c.name);
+        });
+    std::size_t position = 1;
+    if (command != std::end(commands)) {
+        position = command->position;
+        if (command->rule == rule_t::numkeys) {
+            long long keys;
+            if (position >= arguments.size() ||
+                !parse_integer(arguments[position].begin(),
+                               arguments[position].end(), keys) ||
+                keys <= 0) {
+                return boost::none;
+            }
+            ++position;
+        } else if (command->rule == rule_t::streams) {
+            while (position < arguments.size() &&
+                   !boost::algorithm::iequals(arguments[position],
+                                              "STREAMS")) {
+                ++position;
+            }
+            ++position;
+        }
+    }
+    if (position >= arguments.size()) {
+        return boost::none;
+    }
+    return arguments[position];
+}
+
+inline boost::optional<boost::string_ref>
+command_key(boost::string_ref serialized) {
+    std::vector<boost::string_ref> arguments;
+    if (!command_arguments(serialized, arguments)) {
+        return boost::none;
+    }
+    return command_key(arguments);
+}
+
+// the reply (to MGET) element is serialized back, to be merged
+template <typename Iterator>
+struct reply_serializer : public boost::static_visitor<bool> {
+    std::string &out;
+
+    explicit reply_serializer(std::string &out_) : out{out_} {}
+
+    bool operator()(const markers::string_t<Iterator> &value) const {
+        out += '$';
+        out += std::to_string(std::distance(value.from, value.to));
+        out += "\r\n";
+        out.append(value.from, value.to);
+        out += "\r\n";
+        return true;
+    }
+
+    bool operator()(const markers::nil_t<Iterator> &) const {
+        out += "$-1\r\n";
+        return true;
+    }
+
+    template <typename T> bool operator()(const T &) const { return false; }
+};
+
+template <typename Iterator, typename Integer>
+bool marker_integer(const markers::redis_result_t<Iterator> &marker,
+                    Integer &value) {
+    auto integer = boost::get<markers::int_t<Iterator>>(&marker);
+    long long number;
+    if (!integer || !parse_integer(integer->string.from, integer->string.to,
+                                   number) ||
+        number < 0 || number > std::numeric_limits<Integer>::max()) {
+        return false;
+    }
+    value = static_cast<Integer>(number);
+    return true;
+}
+
+} // namespace details
+
+inline std::uint16_t key_slot(boost::string_ref key) {
+    auto open = key.find('{');
+    if (open != boost::string_ref::npos) {
+        auto tag = key.substr(open + 1);
+        auto close = tag.find('}');
+        if (close != boost::string_ref::npos && close != 0) {
+            key = tag.substr(0, close);
+        }
+    }
+    return details::crc16(key.data(), key.size()) & (cluster_slots_count - 1);
+}
+
+template <typename Iterator>
+bool parse_cluster_slots(const markers::redis_result_t<Iterator> &reply,
+                         std::vector<slot_range_t> &ranges) {
+    using array_t = markers::array_holder_t<Iterator>;
+    using string_t = markers::string_t<Iterator>;
+    auto slots = boost::get<array_t>(&reply);
+    if (!slots) {
+        return false;
+    }
+    for (const auto &item : slots->elements) {
+        // start, end, master [host, port, id...], replicas...
+        auto range = boost::get<array_t>(&item);
+        if (!range || range->elements.size() < 3) {
+            return false;
+        }
+        auto node = boost::get<array_t>(&range->elements[2]);
+        if (!node || node->elements.size() < 2) {
+            return false;
+        }
+        auto host = boost::get<string_t>(&node->elements[0]);
+        slot_range_t slot_range;
+        if (!host ||
+            !details::marker_integer(range->elements[0], slot_range.first) ||
+            !details::marker_integer(range->elements[1], slot_range.last) ||
+            !details::marker_integer(node->elements[1], slot_range.port) ||
+            slot_range.first > slot_range.last ||
+            slot_range.last >= cluster_slots_count) {
+            return false;
+        }
+        slot_range.host.assign(host->from, host->to);
+        ranges.push_back(std::move(slot_range));
+    }
+    return true;
+}
+
+inline boost::optional<redirection_t>
+parse_redirection(boost::string_ref error) {
+    redirection_t redirection;
+    if (error.starts_with("MOVED ")) {
+        redirection.moved = true;
+        error.remove_prefix(6);
+    } else if (error.starts_with("ASK ")) {
+        redirection.moved = false;
+        error.remove_prefix(4);
+    } else {
+        return boost::none;
+    }
+
+    // <slot> <host>:<port>
+    auto space = error.find(' ');
+    auto colon = error.rfind(':');
+    long long slot, port;
+    if (space == boost::string_ref::npos || colon == boost::string_ref::npos ||
+        colon < space ||
+        !details::parse_integer(error.data(), error.data() + space, slot) ||
+        !details::parse_integer(error.data() + colon + 1,
+                                error.data() + error.size(), port) ||
+        slot < 0 || slot >= static_cast<long long>(cluster_slots_count) ||
+        port < 0 || port > 65535) {
+        return boost::none;
+    }
+    redirection.slot = static_cast<std::uint16_t>(slot);
+    redirection.host = error.substr(space + 1, colon - space - 1).to_string();
+    redirection.port = static_cast<std::uint16_t>(port);
+    return redirection;
+}
+
+template <typename NextLayer>
+constexpr std::size_t Cluster<NextLayer>::max_redirections;
+
+template <typename NextLayer>
+Cluster<NextLayer>::Cluster(const executor_type &executor,
+                            const std::string &host, std::uint16_t port,
+                            factory_t factory)
+    : executor_(executor), factory_(std::move(factory)),
+      slots_(cluster_slots_count, 0), moved_{0}, refreshing_{false},
+      refresh_node_{0} {
+    nodes_.push_back(node_t{host, port, nullptr, false, {}});
+}
+
+template <typename NextLayer>
+void Cluster<NextLayer>::async_connect(slots_handler_t handler) {
+    refresh(0, std::move(handler));
+}
+
+template <typename NextLayer>
+template <typename CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+                              void(boost::system::error_code,
+                                   typename Cluster<NextLayer>::result_t))
+Cluster<NextLayer>::async_execute(const command_wrapper_t &command,
+                                  CompletionToken &&token) {
+    using Signature = void(boost::system::error_code, result_t);
+    using AsyncResult =
+        boost::asio::async_result<std::decay_t<CompletionToken>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler handler(std::forward<CompletionToken>(token));
+    AsyncResult result(handler);
+    // the handler is shared by the copies of the callback
+    auto completion = std::make_shared<completion_t>(std::move(handler));
+    execute(command, [this, completion](const boost::system::error_code &ec,
+                                        result_t reply) {
+        completion->dispatch(ec, std::move(reply), executor_);
+    });
+    return result.get();
+}
+
+template <typename NextLayer>
+void Cluster<NextLayer>::execute(const command_wrapper_t &command,
+                                 callback_t callback) {
+    if (details::command_replies(command) != 1) {
+        throw std::invalid_argument("single command is expected");
+    }
+    auto request = std::make_shared<request_t>();
+    request->wrap = details::replies_wrapped(command);
+    request->command.resize(command_size(command));
+    write_command(&request->command[0], command);
+
+    std::vector<boost::string_ref> arguments;
+    details::command_arguments(request->command, arguments);
+    if (!request->wrap && !arguments.empty() && fan_out(arguments, callback)) {
+        return;
+    }
+    request->replies = 1;
+    request->callback = std::move(callback);
+    request->redirections = 0;
+
+    auto key = details::command_key(arguments);
+    auto index = key ? slots_[key_slot(*key)] : 0;
+    send(index, std::move(request), false);
+}
+
+template <typename NextLayer>
+bool Cluster<NextLayer>::fan_out(
+    const std::vector<boost::string_ref> &arguments, callback_t &callback) {
+    struct command_t {
+        const char *name;
+        merge_t merge;
+        // the amount of the arguments per key
+        std::size_t step;
+    };
+    static const command_t commands[] = {
+        {"MGET", merge_t::values, 1},  {"MSET", merge_t::status, 2},
+        {"DEL", merge_t::sum, 1},      {"UNLINK", merge_t::sum, 1},
+        {"EXISTS", merge_t::sum, 1},   {"TOUCH", merge_t::sum, 1}};
+
+    auto &name = arguments.front();
+    auto command = std::find_if(
+        std::begin(commands), std::end(commands), [&](const command_t &c) {
+            return boost::algorithm::iequals(name, c.name);
+        });
+    if (command == std::end(commands) || arguments.size() < 3 ||
+        (arguments.size() - 1) % command->step) {
+        return false;
+    }
+
+    // the keys are grouped by the slots, in the order of the first key
+    auto step = command->step;
+    auto keys = (arguments.size() - 1) / step;
+    std::vector<std::pair<std::uint16_t, std::vector<std::size_t>>> groups;
+    std::unordered_map<std::uint16_t, std::size_t> slot_groups;
+    slot_groups.reserve(keys);
+    for (std::size_t key = 0; key < keys; ++key) {
+        auto slot = key_slot(arguments[1 + key * step]);
+        auto group = slot_groups.emplace(slot, groups.size());
+        if (group.second) {
+            groups.emplace_back(slot, std::vector<std::size_t>{});
+        }
+        groups[group.first->second].second.push_back(key);
+    }
+    if (groups.size() == 1) {
+        return false;
+    }
+
+    auto fan_out = std::make_shared<fan_out_t>();
+    fan_out->merge = command->merge;
+    fan_out->callback = std::move(callback);
+    fan_out->parts = groups.size();
+    fan_out->remaining = groups.size();
+    fan_out->succeeded = 0;
+    fan_out->values.resize(command->merge == merge_t::values ? keys : 0);
+    fan_out->sum = 0;
+
+    // the parts are batched per node
+    std::vector<std::vector<request_ptr_t>> batches(nodes_.size());
+    for (auto &group : groups) {
+        std::vector<boost::string_ref> part_arguments{name};
+        for (auto key : group.second) {
+            auto first = arguments.begin() + 1 + key * step;
+            part_arguments.insert(part_arguments.end(), first, first + step);
+        }
+        single_command_t part(part_arguments.begin(), part_arguments.end());
+
+        auto request = std::make_shared<request_t>();
+        request->command.resize(command_size(part));
+        write_command(&request->command[0], part);
+        request->replies = 1;
+        request->wrap = false;
+        request->redirections = 0;
+        request->callback = [this, fan_out, keys = std::move(group.second)](
+                                const boost::system::error_code &ec,
+                                result_t result) {
+            merge(*fan_out, keys, ec, result.result);
+            if (!--fan_out->remaining) {
+                complete(*fan_out);
+            }
+        };
+        batches[slots_[group.first]].push_back(std::move(request));
+    }
+    for (std::size_t index = 0; index < batches.size(); ++index) {
+        send_batch(index, std::move(batches[index]));
+    }
+    return true;
+}
+
+// the parts of the split command, which go to the same node, are sent by
+// one write and are replied by one read; each part is handled on its own
+// then, i.e. it is redirected separately
+template <typename NextLayer>
+void Cluster<NextLayer>::send_batch(std::size_t index,
+                                    std::vector<request_ptr_t> &&parts) {
+    if (parts.size() < 2) {
+        for (auto &part : parts) {
+            send(index, std::move(part), false);
+        }
+        return;
+    }
+    auto batch = std::make_shared<request_t>();
+    for (const auto &part : parts) {
+        batch->command += part->command;
+    }
+    batch->replies = parts.size();
+    batch->wrap = false;
+    batch->redirections = 0;
+    batch->callback = [this, index, parts = std::move(parts)](
+                          const boost::system::error_code &ec,
+                          result_t replies) {
+        using array_t = markers::array_holder_t<Iterator>;
+        auto array = ec ? nullptr : &boost::get<array_t>(replies.result);
+        for (std::size_t i = 0; i < parts.size(); ++i) {
+            node_result_t reply;
+            if (array) {
+                reply.result = std::move(array->elements[i]);
+                reply.buffer = replies.buffer;
+            }
+            on_reply(index, parts[i], ec, std::move(reply));
+        }
+    };
+    send(index, std::move(batch), false);
+}
+
+template <typename NextLayer>
+void Cluster<NextLayer>::merge(fan_out_t &fan_out,
+                               const std::vector<std::size_t> &keys,
+                               const boost::system::error_code &ec,
+                               const reply_t &reply) {
+    if (ec) {
+        fan_out.ec = fan_out.ec ? fan_out.ec : ec;
+        return;
+    }
+    auto error = boost::get<markers::error_t<Iterator>>(&reply);
+    if (!error) {
+        ++fan_out.succeeded;
+    }
+    if (fan_out.ec) {
+        return;
+    }
+    if (error) {
+        if (fan_out.error.empty()) {
+            fan_out.error.assign(error->string.from, error->string.to);
+        }
+        return;
+    }
+
+    bool matched = true;
+    if (fan_out.merge == merge_t::values) {
+        auto array = boost::get<markers::array_holder_t<Iterator>>(&reply);
+        matched = array && array->elements.size() == keys.size();
+        for (std::size_t i = 0; matched && i < keys.size(); ++i) {
+            details::reply_serializer<Iterator> serializer{
+                fan_out.values[keys[i]]};
+            matched = boost::apply_visitor(serializer, array->elements[i]);
+        }
+    } else if (fan_out.merge == merge_t::sum) {
+        long long value = 0;
+        auto integer = boost::get<markers::int_t<Iterator>>(&reply);
+        matched = integer && details::parse_integer(integer->string.from,
+                                                    integer->string.to, value);
+        fan_out.sum += value;
+    }
+    if (!matched) {
+        fan_out.ec = Error::make_error_code(bredis_errors::type_mismatch);
+    }
+}
+
+// the merged reply is serialized and parsed, as if it was received
+template <typename NextLayer>
+void Cluster<NextLayer>::complete(fan_out_t &fan_out) {
+    if (fan_out.ec) {
+        fan_out.callback(fan_out.ec, result_t{});
+        return;
+    }
+    std::string merged;
+    if (!fan_out.error.empty()) {
+        merged = "-" + fan_out.error + "\r\n";
+    } else if (fan_out.merge == merge_t::values) {
+        merged = "*" + std::to_string(fan_out.values.size()) + "\r\n";
+        for (const auto &value : fan_out.values) {
+            merged += value;
+        }
+    } else if (fan_out.merge == merge_t::sum) {
+        merged = ":" + std::to_string(fan_out.sum) + "\r\n";
+    } else {
+        merged = "+OK\r\n";
+    }
+
+    using Policy = parsing_policy::keep_result;
+    using Buffer = typename multiplexer_t::Buffer;
+    auto buffer = std::make_shared<Buffer>();
+    buffer->commit(boost::asio::buffer_copy(buffer->prepare(merged.size()),
+                                            boost::asio::buffer(merged)));
+    auto parsed = Protocol::parse<Iterator, Policy>(
+        Iterator::begin(buffer->data()), Iterator::end(buffer->data()));
+    auto &positive =
+        boost::get<positive_parse_result_t<Iterator, Policy>>(parsed);
+    // the parts are not atomic, so the partial failure is told apart
+    result_t result;
+    result.result = std::move(positive.result);
+    result.buffer = std::move(buffer);
+    result.parts = fan_out.parts;
+    result.succeeded = fan_out.succeeded;
+    fan_out.callback(boost::system::error_code{}, std::move(result));
+}
+
+template <typename NextLayer>
+typename Cluster<NextLayer>::multiplexer_t *
+Cluster<NextLayer>::node(std::uint16_t slot) {
+    return nodes_[slots_.at(slot)].connection.get();
+}
+
+template <typename NextLayer>
+std::size_t Cluster<NextLayer>::node_index(const std::string &host,
+                                           std::uint16_t port) {
+    for (std::size_t i = 0; i < nodes_.size(); ++i) {
+        if (nodes_[i].port == port && nodes_[i].host == host) {
+            return i;
+        }
+    }
+    nodes_.push_back(node_t{host, port, nullptr, false, {}});
+    return nodes_.size() - 1;
+}
+
+// the connection is established on demand, the failed one is replaced
+// once its operations complete
+template <typename NextLayer>
+void Cluster<NextLayer>::connect(std::size_t index) {
+    auto &node = nodes_[index];
+    if (node.connecting) {
+        return;
+    }
+    node.connecting = true;
+    // the factory may complete in any thread
+    factory_(node.host, node.port,
+             [this, index](const boost::system::error_code &ec,
+                           NextLayer stream) {
+                 boost::asio::dispatch(executor_, [this, index, ec,
+                                                   stream = std::move(
+                                                       stream)]() mutable {
+                     on_connect(index, ec, std::move(stream));
+                 });
+             });
+}
+
+template <typename NextLayer>
+void Cluster<NextLayer>::on_connect(std::size_t index,
+                                    const boost::system::error_code &ec,
+                                    NextLayer &&stream) {
+    auto &node = nodes_[index];
+    auto waiting = std::move(node.waiting);
+    node.waiting.clear();
+    node.connecting = false;
+    if (ec) {
+        for (auto &request : waiting) {
+            request.first->callback(ec, result_t{});
+        }
+        return;
+    }
+    node.connection = std::make_unique<multiplexer_t>(std::move(stream));
+    for (auto &request : waiting) {
+        send(index, std::move(request.first), request.second);
+    }
+}
+
+// the slot map is updated in place, so the commands in flight are not
+// affected; the unlisted slots keep their nodes. The reply, which is sent
+// before -MOVED re-assigns a slot, may be stale, so it is dropped, and the
+// map is requested again
+template <typename NextLayer>
+void Cluster<NextLayer>::refresh(std::size_t index, slots_handler_t handler) {
+    if (handler) {
+        refresh_handlers_.push_back(std::move(handler));
+    }
+    refresh_node_ = index;
+    if (refreshing_) {
+        return;
+    }
+    refreshing_ = true;
+    auto moved = moved_;
+    auto request = std::make_shared<request_t>();
+    single_command_t command{"CLUSTER", "SLOTS"};
+    request->command.resize(command_size(command));
+    write_command(&request->command[0], command);
+    request->replies = 1;
+    request->wrap = false;
+    // the reply is not redirected
+    request->redirections = max_redirections;
+    request->callback = [this, moved](const boost::system::error_code &ec,
+                                      const result_t &reply) {
+        refreshing_ = false;
+        if (!ec && moved != moved_) {
+            refresh(refresh_node_, nullptr);
+            return;
+        }
+        auto result = ec;
+        std::vector<slot_range_t> ranges;
+        if (!result && !parse_cluster_slots(reply.result, ranges)) {
+            result = Error::make_error_code(bredis_errors::cluster_slots);
+        }
+        for (const auto &range : ranges) {
+            auto node = node_index(range.host, range.port);
+            for (std::size_t slot = range.first; slot <= range.last; ++slot) {
+                slots_[slot] = node;
+            }
+        }
+        auto handlers = std::move(refresh_handlers_);
+        refresh_handlers_.clear();
+        for (auto &handler : handlers) {
+            handler(result);
+        }
+    };
+    send(index, std::move(request), false);
+}
+
+// the request waits for the connection to the node, if it is not up
+template <typename NextLayer>
+void Cluster<NextLayer>::send(std::size_t index, request_ptr_t request,
+                              bool asking) {
+    auto &node = nodes_[index];
+    auto &connection = node.connection;
+    if (node.connecting || !connection ||
+        (connection->error() && connection->idle())) {
+        node.waiting.emplace_back(std::move(request), asking);
+        connect(index);
+        return;
+    }
+    auto &target = *connection;
+    if (!asking) {
+        target.async_send(request->command, request->replies,
+                          request->replies > 1,
+                          [this, index, request](
+                              const boost::system::error_code &ec,
+                              node_result_t result) {
+                              on_reply(index, request, ec, std::move(result));
+                          });
+        return;
+    }
+
+    // the command is preceded by ASKING, its reply is skipped
+    static const std::string asking_command = "*1\r\n$6\r\nASKING\r\n";
+    target.async_send(
+        asking_command + request->command, 2, true,
+        [this, index, request](const boost::system::error_code &ec,
+                               node_result_t replies) {
+            if (!ec) {
+                auto &array = boost::get<markers::array_holder_t<Iterator>>(
+                    replies.result);
+                auto reply = std::move(array.elements[1]);
+                replies.result = std::move(reply);
+            }
+            on_reply(index, request, ec, std::move(replies));
+        });
+}
+
+template <typename NextLayer>
+void Cluster<NextLayer>::on_reply(std::size_t index,
+                                  const request_ptr_t &request,
+                                  const boost::system::error_code &ec,
+                                  node_result_t &&result) {
+    auto error = boost::get<markers::error_t<Iterator>>(&result.result);
+    if (!ec && error && request->replies == 1 &&
+        request->redirections < max_redirections) {
+        std::string message(error->string.from, error->string.to);
+        if (auto redirection = parse_redirection(message)) {
+            ++request->redirections;
+            auto host = redirection->host.empty() ? nodes_[index].host
+                                                  : redirection->host;
+            auto target = node_index(host, redirection->port);
+            // the slot map is reloaded, unless it already agrees
+            if (redirection->moved && slots_[redirection->slot] != target) {
+                slots_[redirection->slot] = target;
+                ++moved_;
+                refresh(target, nullptr);
+            }
+            send(target, request, !redirection->moved);
+            return;
+        }
+    }
+    result_t reply;
+    reply.succeeded = !ec && !error;
+    if (request->wrap && !ec) {
+        markers::array_holder_t<Iterator> array;
+        array.elements.push_back(std::move(result.result));
+        result.result = std::move(array);
+    }
+    static_cast<node_result_t &>(reply) = std::move(result);
+    request->callback(ec, std::move(reply));
+}
+
+} // namespace bredis
@@ -10,8 +10,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/type_traits.hpp>
 #include <iostream>
-#include <locale>
-#include <sstream>
+#include <iterator>
+#include <string>
 
 #ifdef BREDIS_DEBUG
 #define BREDIS_LOG_DEBUG(msg)                                                  \
@@ -34,64 +34,81 @@ struct consumed_parse : public boost::static_visitor<int> {
     int operator()(const protocol_error_t & /*value*/) const { return -1; }
 };
 
+// Deprecated: the library reads via async_read_op / incremental_parser_t
+// and does not use it anymore; it will be removed in the next version.
+//
+// Completion condition for async_read_until. The scan state is preserved
+// between the invocations, and the scanned position is reported back to
+// asio, so the next invocation resumes right where the previous one has
+// stopped instead of re-parsing the incomplete reply from its beginning.
 template <typename Iterator> class MatchResult {
   private:
     std::size_t expected_count_;
     std::size_t matched_results_;
+    details::incremental_parser_t parser_;
 
   public:
     MatchResult(std::size_t expected_count)
         : expected_count_(expected_count), matched_results_(0) {}
 
     std::pair<Iterator, bool> operator()(Iterator begin, Iterator end) {
-        using Policy = bredis::parsing_policy::drop_result;
-
-        auto parsing_complete = false;
-        size_t consumed = 0;
         auto parse_from = begin;
         do {
-            auto from = parse_from;
-            auto parse_result = Protocol::parse<Iterator, Policy>(from, end);
-            auto consumable = boost::apply_visitor(
-                consumed_parse<Iterator, Policy>(), parse_result);
-            if (consumable == -1) {
+            auto parse_result = parser_.feed(parse_from, end);
+            if (parse_result.error) {
                 // parse error
-                consumed = 0;
-                parsing_complete = true;
-                break;
+                return std::make_pair(begin, true);
             }
-            if (consumable == 0) {
+            parse_from += parse_result.consumed;
+            if (!parse_result.complete) {
                 // no enough data
-                break;
+                return std::make_pair(parse_from, false);
             }
             ++matched_results_;
-            auto iteration_consumed = static_cast<std::size_t>(consumable);
-            consumed += iteration_consumed;
-            parse_from += iteration_consumed;
-            parsing_complete = (matched_results_ == expected_count_);
-        } while (!parsing_complete);
-        return std::make_pair(begin + consumed, parsing_complete);
+        } while (matched_results_ != expected_count_);
+        return std::make_pair(parse_from, true);
     }
 };
 
-class command_serializer_visitor : public boost::static_visitor<std::string> {
-  public:
-    std::string operator()(const single_command_t &value) const {
-        std::stringstream out;
-        out.imbue(std::locale::classic());
-        Protocol::serialize(out, value);
-        return out.str();
-    }
+inline std::size_t command_size(const command_wrapper_t &command) {
+    std::size_t size = 0;
+    for_each_command(command, [&size](const auto &arguments) {
+        size += details::serialized_size(arguments);
+    });
+    return size;
+}
+
+// writes the command into the memory of the exact size (see
+// command_size), returns the end of the written data
+inline char *write_command(char *out, const command_wrapper_t &command) {
+    for_each_command(command, [&out](const auto &arguments) {
+        out = details::serialize(out, arguments);
+    });
+    return out;
+}
 
-    std::string operator()(const command_container_t &value) const {
-        std::stringstream out;
-        out.imbue(std::locale::classic());
-        for (const auto &cmd : value) {
-            Protocol::serialize(out, cmd);
-        }
-        return out.str();
+// Serializes the command directly into the prepared area of tx_buff, i.e.
+// without intermediate string and stream; the prepared area is
+// contiguous for asio::streambuf, otherwise the command is serialized
+// into temporary string and copied.
+template <typename DynamicBuffer>
+void serialize_command(DynamicBuffer &tx_buff,
+                       const command_wrapper_t &command) {
+    namespace asio = boost::asio;
+    auto size = command_size(command);
+    auto buffers = tx_buff.prepare(size);
+    auto first = asio::buffer_sequence_begin(buffers);
+    if (std::next(first) == asio::buffer_sequence_end(buffers)) {
+        asio::mutable_buffer contiguous_buff(*first);
+        auto out = static_cast<char *>(contiguous_buff.data());
+        write_command(out, command);
+    } else {
+        std::string serialized(size, '\0');
+        write_command(&serialized[0], command);
+        asio::buffer_copy(buffers, asio::buffer(serialized));
     }
-};
+    tx_buff.commit(size);
+}
 
 } // namespace bredis
 
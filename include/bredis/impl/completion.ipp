@@ -0,0 +1,126 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+namespace bredis {
+
+namespace details {
+
+// The completion handler of the queued command, with its type erased, but
+// with the Asio handler requirements kept: the handler may be move-only,
+// it is stored in the memory of its associated allocator, and it is
+// invoked via its associated executor (the I/O executor by default).
+template <typename Result, typename Executor> class completion_t {
+    struct base_t {
+        virtual void complete(const boost::system::error_code &ec,
+                              Result &&result, const Executor &executor,
+                              bool defer) = 0;
+        virtual void destroy() = 0;
+
+      protected:
+        ~base_t() = default;
+    };
+
+    template <typename Handler> struct impl_t final : base_t {
+        using allocator_t = typename std::allocator_traits<
+            boost::asio::associated_allocator_t<Handler>>::
+            template rebind_alloc<impl_t>;
+        using traits_t = std::allocator_traits<allocator_t>;
+
+        Handler handler;
+
+        explicit impl_t(Handler &&handler_) : handler(std::move(handler_)) {}
+
+        static impl_t *create(Handler handler) {
+            allocator_t allocator(
+                boost::asio::get_associated_allocator(handler));
+            auto impl = traits_t::allocate(allocator, 1);
+            try {
+                traits_t::construct(allocator, impl, std::move(handler));
+            } catch (...) {
+                traits_t::deallocate(allocator, impl, 1);
+                throw;
+            }
+            return impl;
+        }
+
+        void destroy() override {
+            allocator_t allocator(
+                boost::asio::get_associated_allocator(handler));
+            traits_t::destroy(allocator, this);
+            traits_t::deallocate(allocator, this, 1);
+        }
+
+        // the memory is released before the upcall
+        void complete(const boost::system::error_code &ec, Result &&result,
+                      const Executor &executor, bool defer) override {
+            auto target =
+                boost::asio::get_associated_executor(handler, executor);
+            auto function = [handler = std::move(handler), ec,
+                             result = std::move(result)]() mutable {
+                handler(ec, std::move(result));
+            };
+            destroy();
+            if (defer) {
+                boost::asio::post(target, std::move(function));
+            } else {
+                boost::asio::dispatch(target, std::move(function));
+            }
+        }
+    };
+
+    base_t *impl_;
+
+  public:
+    template <typename Handler>
+    explicit completion_t(Handler handler)
+        : impl_{impl_t<Handler>::create(std::move(handler))} {}
+
+    completion_t(completion_t &&other) noexcept : impl_{other.impl_} {
+        other.impl_ = nullptr;
+    }
+
+    completion_t &operator=(completion_t &&other) noexcept {
+        std::swap(impl_, other.impl_);
+        return *this;
+    }
+
+    ~completion_t() {
+        if (impl_) {
+            impl_->destroy();
+        }
+    }
+
+    // the handler is invoked in place, if the executor allows it
+    void dispatch(const boost::system::error_code &ec, Result result,
+                  const Executor &executor) {
+        release()->complete(ec, std::move(result), executor, false);
+    }
+
+    // the handler is never invoked from within the call
+    void post(const boost::system::error_code &ec, Result result,
+              const Executor &executor) {
+        release()->complete(ec, std::move(result), executor, true);
+    }
+
+  private:
+    base_t *release() {
+        auto impl = impl_;
+        impl_ = nullptr;
+        return impl;
+    }
+};
+
+} // namespace details
+
+} // namespace bredis
@@ -14,6 +14,9 @@
 #include <type_traits>
 
 #include "async_op.ipp"
+#include "elements_op.ipp"
+#include "stream_op.ipp"
+#include "write_op.ipp"
 
 namespace bredis {
 
@@ -31,16 +34,37 @@ Connection<NextLayer>::async_write(DynamicBuffer &tx_buff,
     using AsyncResult = asio::async_result<std::decay_t<WriteCallback>,Signature>;
     using CompletionHandler = typename AsyncResult::completion_handler_type;
 
-    std::ostream os(&tx_buff);
-    auto string = boost::apply_visitor(command_serializer_visitor(), command);
-    os.write(string.c_str(), string.size());
-    
+    serialize_command(tx_buff, command);
+
     CompletionHandler handler(std::forward<WriteCallback>(write_callback));
     AsyncResult result(handler);
     async_write(stream_, tx_buff, handler);
     return result.get();
 }
 
+template <typename NextLayer>
+template <typename WriteCallback>
+BOOST_ASIO_INITFN_RESULT_TYPE(WriteCallback,
+                              void(boost::system::error_code, std::size_t))
+Connection<NextLayer>::async_write_gather(const command_wrapper_t &command,
+                                          WriteCallback &&write_callback,
+                                          std::size_t copy_threshold) {
+    namespace asio = boost::asio;
+    using Signature = void(boost::system::error_code, std::size_t);
+    using AsyncResult =
+        asio::async_result<std::decay_t<WriteCallback>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler handler(std::forward<WriteCallback>(write_callback));
+    AsyncResult result(handler);
+
+    gather_write_op<NextLayer, CompletionHandler> async_op(
+        handler, stream_,
+        std::make_unique<command_buffers_t>(command, copy_threshold));
+    async_op.start();
+    return result.get();
+}
+
 template <typename NextLayer>
 template <typename DynamicBuffer, typename ReadCallback, typename Policy>
 BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
@@ -48,12 +72,11 @@ BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
                                    BREDIS_PARSE_RESULT(DynamicBuffer, Policy)))
 Connection<NextLayer>::async_read(DynamicBuffer &rx_buff,
                                   ReadCallback &&read_callback,
-                                  std::size_t replies_count, Policy) {
+                                  std::size_t replies_count, Policy,
+                                  memory_resource_t *resource) {
 
     namespace asio = boost::asio;
     namespace sys = boost::system;
-    using boost::asio::async_read_until;
-    using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
     using ParseResult = BREDIS_PARSE_RESULT(DynamicBuffer, Policy);
     using Signature = void(boost::system::error_code, ParseResult);
     using AsyncResult = asio::async_result<std::decay_t<ReadCallback>,Signature>;
@@ -63,10 +86,88 @@ Connection<NextLayer>::async_read(DynamicBuffer &rx_buff,
     AsyncResult result(handler);
 		
     async_read_op<NextLayer, DynamicBuffer, CompletionHandler, Policy> async_op(
-        handler, stream_, rx_buff, replies_count);
+        handler, stream_, rx_buff, replies_count, resource);
+    async_op(sys::error_code{}, 0, true);
+    return result.get();
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename ReadCallback, typename Policy>
+BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                              void(boost::system::error_code,
+                                   BREDIS_PARSE_RESULT(DynamicBuffer, Policy),
+                                   std::size_t))
+Connection<NextLayer>::async_read_available(DynamicBuffer &rx_buff,
+                                            ReadCallback &&read_callback,
+                                            std::size_t max_replies, Policy,
+                                            memory_resource_t *resource) {
+    namespace asio = boost::asio;
+    namespace sys = boost::system;
+    using ParseResult = BREDIS_PARSE_RESULT(DynamicBuffer, Policy);
+    using Signature =
+        void(boost::system::error_code, ParseResult, std::size_t);
+    using AsyncResult =
+        asio::async_result<std::decay_t<ReadCallback>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler handler(std::forward<ReadCallback>(read_callback));
+    AsyncResult result(handler);
+
+    async_read_op<NextLayer, DynamicBuffer, CompletionHandler, Policy, true>
+        async_op(handler, stream_, rx_buff, max_replies, resource);
+    async_op(sys::error_code{}, 0, true);
+    return result.get();
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename Sink, typename ReadCallback>
+BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                              void(boost::system::error_code, stream_result_t))
+Connection<NextLayer>::async_read_stream(DynamicBuffer &rx_buff, Sink sink,
+                                         ReadCallback &&read_callback,
+                                         std::size_t chunk_size) {
+    namespace asio = boost::asio;
+    namespace sys = boost::system;
+    using Signature = void(boost::system::error_code, stream_result_t);
+    using AsyncResult =
+        asio::async_result<std::decay_t<ReadCallback>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler handler(std::forward<ReadCallback>(read_callback));
+    AsyncResult result(handler);
+
+    stream_read_op<NextLayer, DynamicBuffer, Sink, CompletionHandler> async_op(
+        handler, stream_, rx_buff, std::move(sink), chunk_size);
+    async_op(sys::error_code{}, 0, true);
+    return result.get();
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename ElementsHandler,
+          typename ReadCallback>
+BOOST_ASIO_INITFN_RESULT_TYPE(ReadCallback,
+                              void(boost::system::error_code,
+                                   elements_result_t))
+Connection<NextLayer>::async_read_elements(DynamicBuffer &rx_buff,
+                                           ElementsHandler handler,
+                                           ReadCallback &&read_callback,
+                                           std::size_t batch_size) {
+    namespace asio = boost::asio;
+    namespace sys = boost::system;
+    using Signature = void(boost::system::error_code, elements_result_t);
+    using AsyncResult =
+        asio::async_result<std::decay_t<ReadCallback>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler completion_handler(
+        std::forward<ReadCallback>(read_callback));
+    AsyncResult result(completion_handler);
 
-    async_read_until(stream_, rx_buff, MatchResult<Iterator>(replies_count),
-                     std::move(async_op));
+    elements_read_op<NextLayer, DynamicBuffer, ElementsHandler,
+                     CompletionHandler>
+        async_op(completion_handler, stream_, rx_buff, std::move(handler),
+                 batch_size);
+    async_op(sys::error_code{}, 0, true);
     return result.get();
 }
 
@@ -74,9 +175,27 @@ template <typename NextLayer>
 void Connection<NextLayer>::write(const command_wrapper_t &command,
                                   boost::system::error_code &ec) {
     namespace asio = boost::asio;
-    auto str = boost::apply_visitor(command_serializer_visitor(), command);
-    auto const output_buf = asio::buffer(str.c_str(), str.size());
-    asio::write(stream_, output_buf, ec);
+    std::string str(command_size(command), '\0');
+    write_command(&str[0], command);
+    asio::write(stream_, asio::buffer(str), ec);
+}
+
+template <typename NextLayer>
+void Connection<NextLayer>::write_gather(const command_wrapper_t &command,
+                                         std::size_t copy_threshold,
+                                         boost::system::error_code &ec) {
+    command_buffers_t buffers(command, copy_threshold);
+    boost::asio::write(stream_, buffers.sequence(), ec);
+}
+
+template <typename NextLayer>
+void Connection<NextLayer>::write_gather(const command_wrapper_t &command,
+                                         std::size_t copy_threshold) {
+    boost::system::error_code ec;
+    this->write_gather(command, copy_threshold, ec);
+    if (ec) {
+        throw boost::system::system_error{ec};
+    }
 }
 
 template <typename NextLayer>
@@ -94,29 +213,31 @@ BREDIS_PARSE_RESULT(DynamicBuffer, bredis::parsing_policy::keep_result)
 Connection<NextLayer>::read(DynamicBuffer &rx_buff,
                             boost::system::error_code &ec) {
     namespace asio = boost::asio;
-    using boost::asio::read_until;
-    using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
     using Policy = bredis::parsing_policy::keep_result;
     using result_t = BREDIS_PARSE_RESULT(DynamicBuffer, Policy);
 
-    /*auto rx_bytes =*/read_until(stream_, rx_buff, MatchResult<Iterator>(1),
-                                  ec);
-    if (ec) {
-        return result_t{{}, 0};
+    async_read_op_impl<DynamicBuffer, Policy> read_op(1);
+    while (!read_op.feed(rx_buff)) {
+        if (rx_buff.size() == rx_buff.max_size()) {
+            ec = asio::error::not_found;
+            return result_t{};
+        }
+        auto buffers = rx_buff.prepare(read_op.read_size(rx_buff));
+        auto bytes_transferred =
+            read_op.needed() > 1
+                ? asio::read(stream_, buffers,
+                             asio::transfer_at_least(read_op.needed()), ec)
+                : stream_.read_some(buffers, ec);
+        rx_buff.commit(bytes_transferred);
+        if (ec) {
+            return result_t{};
+        }
     }
 
     auto const_buff = rx_buff.data();
-    auto begin = Iterator::begin(const_buff);
-    auto end = Iterator::end(const_buff);
-
-    auto parse_result = Protocol::parse(begin, end);
-
-    auto *parse_error = boost::get<protocol_error_t>(&parse_result);
-    if (parse_error) {
-        ec = parse_error->code;
-        return result_t{};
-    }
-    return boost::get<result_t>(parse_result);
+    auto result = read_op.result(const_buff);
+    ec = read_op.error();
+    return result;
 }
 
 template <typename NextLayer>
@@ -133,4 +254,88 @@ Connection<NextLayer>::read(DynamicBuffer &rx_buff) {
     return result;
 }
 
+template <typename NextLayer>
+template <typename DynamicBuffer, typename Sink>
+stream_result_t Connection<NextLayer>::read_stream(
+    DynamicBuffer &rx_buff, Sink sink, std::size_t chunk_size,
+    boost::system::error_code &ec) {
+    namespace asio = boost::asio;
+
+    stream_read_op_impl<DynamicBuffer, Sink> read_op(std::move(sink),
+                                                     chunk_size);
+    while (!read_op.feed(rx_buff)) {
+        if (rx_buff.size() == rx_buff.max_size()) {
+            ec = asio::error::not_found;
+            return read_op.result();
+        }
+        auto bytes_transferred =
+            stream_.read_some(rx_buff.prepare(read_op.read_size(rx_buff)), ec);
+        rx_buff.commit(bytes_transferred);
+        if (ec) {
+            return read_op.result();
+        }
+    }
+
+    ec = read_op.error();
+    return read_op.result();
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename Sink>
+stream_result_t Connection<NextLayer>::read_stream(DynamicBuffer &rx_buff,
+                                                   Sink sink,
+                                                   std::size_t chunk_size) {
+    boost::system::error_code ec;
+    auto result = this->read_stream(rx_buff, std::move(sink), chunk_size, ec);
+    if (ec) {
+        throw boost::system::system_error{ec};
+    }
+    return result;
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename ElementsHandler>
+elements_result_t Connection<NextLayer>::read_elements(
+    DynamicBuffer &rx_buff, ElementsHandler handler, std::size_t batch_size,
+    boost::system::error_code &ec) {
+    namespace asio = boost::asio;
+
+    elements_read_op_impl<DynamicBuffer, ElementsHandler> read_op(
+        std::move(handler), batch_size);
+    while (!read_op.feed(rx_buff)) {
+        if (rx_buff.size() == rx_buff.max_size()) {
+            ec = asio::error::not_found;
+            return read_op.result();
+        }
+        auto buffers = rx_buff.prepare(read_op.read_size(rx_buff));
+        auto bytes_transferred =
+            read_op.needed() > 1
+                ? asio::read(stream_, buffers,
+                             asio::transfer_at_least(read_op.needed()), ec)
+                : stream_.read_some(buffers, ec);
+        rx_buff.commit(bytes_transferred);
+        if (ec) {
+            return read_op.result();
+        }
+    }
+
+    ec = read_op.error();
+    return read_op.result();
+}
+
+template <typename NextLayer>
+template <typename DynamicBuffer, typename ElementsHandler>
+elements_result_t
+Connection<NextLayer>::read_elements(DynamicBuffer &rx_buff,
+                                     ElementsHandler handler,
+                                     std::size_t batch_size) {
+    boost::system::error_code ec;
+    auto result =
+        this->read_elements(rx_buff, std::move(handler), batch_size, ec);
+    if (ec) {
+        throw boost::system::system_error{ec};
+    }
+    return result;
+}
+
 } // namespace bredis
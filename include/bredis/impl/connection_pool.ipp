@@ -0,0 +1,299 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace bredis {
+
+template <typename NextLayer>
+ConnectionPool<NextLayer>::ConnectionPool(boost::asio::io_context &context,
+                                          factory_t factory,
+                                          const pool_options_t &options)
+    : ConnectionPool(std::vector<boost::asio::io_context *>{&context},
+                     std::move(factory), options) {}
+
+template <typename NextLayer>
+ConnectionPool<NextLayer>::ConnectionPool(
+    const std::vector<boost::asio::io_context *> &contexts, factory_t factory,
+    const pool_options_t &options)
+    : factory_(std::move(factory)), options_(options), next_shard_{0} {
+    if (contexts.empty() || !options.max_connections ||
+        options.min_connections > options.max_connections) {
+        throw std::invalid_argument("invalid connection pool bounds");
+    }
+    // the shards are not reallocated, i.e. they can be referred
+    shards_.reserve(contexts.size());
+    for (auto context : contexts) {
+        strand_t strand(context->get_executor());
+        shards_.push_back(shard_t{context, strand, {},
+                                  boost::asio::steady_timer(strand), false});
+    }
+    for (auto &shard : shards_) {
+        boost::asio::dispatch(shard.strand, [this, &shard]() {
+            for (std::size_t i = 0; i < options_.min_connections; ++i) {
+                add(shard);
+            }
+        });
+    }
+}
+
+template <typename NextLayer>
+template <typename CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(
+    CompletionToken,
+    void(boost::system::error_code,
+         typename ConnectionPool<NextLayer>::result_t))
+ConnectionPool<NextLayer>::async_execute(const command_wrapper_t &command,
+                                         CompletionToken &&token) {
+    using Signature = void(boost::system::error_code, result_t);
+    using AsyncResult =
+        boost::asio::async_result<std::decay_t<CompletionToken>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    if (!details::command_replies(command)) {
+        throw std::invalid_argument("no commands to execute");
+    }
+    CompletionHandler handler(std::forward<CompletionToken>(token));
+    AsyncResult result(handler);
+    auto &shard = route();
+    if (shard.strand.running_in_this_thread()) {
+        execute(shard, command, std::move(handler));
+    } else {
+        // the command is serialized, i.e. it need not outlive the call
+        auto queued = make_queued(command, completion_t(std::move(handler)));
+        boost::asio::post(shard.strand,
+                          [this, &shard, queued = std::move(queued)]() mutable {
+                              submit(shard, std::move(queued));
+                          });
+    }
+    return result.get();
+}
+
+template <typename NextLayer> std::size_t ConnectionPool<NextLayer>::size() {
+    return current_shard().connections.size();
+}
+
+template <typename NextLayer>
+typename ConnectionPool<NextLayer>::shard_t &
+ConnectionPool<NextLayer>::current_shard() {
+    for (auto &shard : shards_) {
+        if (shard.context->get_executor().running_in_this_thread()) {
+            return shard;
+        }
+    }
+    if (shards_.size() == 1) {
+        return shards_.front();
+    }
+    throw std::logic_error("connection pool is used outside of its threads");
+}
+
+// the io_context of the calling thread, otherwise the next one
+template <typename NextLayer>
+typename ConnectionPool<NextLayer>::shard_t &
+ConnectionPool<NextLayer>::route() {
+    for (auto &shard : shards_) {
+        if (shard.context->get_executor().running_in_this_thread()) {
+            return shard;
+        }
+    }
+    return shards_[next_shard_++ % shards_.size()];
+}
+
+template <typename NextLayer>
+template <typename Handler>
+void ConnectionPool<NextLayer>::execute(shard_t &shard,
+                                        const command_wrapper_t &command,
+                                        Handler &&handler) {
+    auto &connection = select(shard);
+    if (connection.multiplexer) {
+        connection.multiplexer->async_execute(command,
+                                              std::forward<Handler>(handler));
+    } else {
+        connection.queued.push_back(make_queued(
+            command, completion_t(std::forward<Handler>(handler))));
+    }
+}
+
+template <typename NextLayer>
+void ConnectionPool<NextLayer>::submit(shard_t &shard, queued_t &&queued) {
+    auto &connection = select(shard);
+    if (connection.multiplexer) {
+        // the type-erased handler is passed as is
+        connection.multiplexer->async_send(queued.command, queued.replies,
+                                           queued.wrap,
+                                           std::move(queued.completion));
+    } else {
+        connection.queued.push_back(std::move(queued));
+    }
+}
+
+// the least loaded connection, which is up; if there is none, the
+// command waits for the connecting one
+template <typename NextLayer>
+typename ConnectionPool<NextLayer>::connection_t &
+ConnectionPool<NextLayer>::select(shard_t &shard) {
+    auto &connections = shard.connections;
+
+    // the failed connections are dropped once their operations complete
+    connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                     [](const connection_ptr_t &c) {
+                                         auto &m = c->multiplexer;
+                                         return m && m->error() && m->idle();
+                                     }),
+                      connections.end());
+
+    connection_t *selected = nullptr;
+    connection_t *connecting = nullptr;
+    for (auto &connection : connections) {
+        auto &multiplexer = connection->multiplexer;
+        if (!multiplexer) {
+            connecting = connecting ? connecting : connection.get();
+        } else if (!multiplexer->error() &&
+                   (!selected || load(*connection) < load(*selected))) {
+            selected = connection.get();
+        }
+    }
+
+    // the connections are added one at a time
+    bool busy = !selected || (options_.grow_threshold &&
+                              load(*selected) >= options_.grow_threshold);
+    if (busy && !connecting && connections.size() < options_.max_connections) {
+        add(shard);
+        auto &added = *connections.back();
+        if (!selected || added.multiplexer) {
+            selected = &added;
+        }
+        schedule_shrink(shard);
+    } else if (!selected) {
+        // all the connections have failed, the command fails too
+        selected = connecting ? connecting : connections.front().get();
+    }
+    selected->used = clock_t::now();
+    return *selected;
+}
+
+template <typename NextLayer>
+void ConnectionPool<NextLayer>::add(shard_t &shard) {
+    shard.connections.push_back(std::make_unique<connection_t>());
+    auto connection = shard.connections.back().get();
+    connection->used = clock_t::now();
+    // the factory may complete in any thread
+    factory_(shard.strand, [this, &shard, connection](
+                               const boost::system::error_code &ec,
+                               NextLayer stream) {
+        boost::asio::dispatch(shard.strand, [this, &shard, connection, ec,
+                                             stream = std::move(
+                                                 stream)]() mutable {
+            on_connect(shard, *connection, ec, std::move(stream));
+        });
+    });
+}
+
+template <typename NextLayer>
+void ConnectionPool<NextLayer>::on_connect(shard_t &shard,
+                                           connection_t &connection,
+                                           const boost::system::error_code &ec,
+                                           NextLayer &&stream) {
+    auto queued = std::move(connection.queued);
+    connection.queued.clear();
+    if (ec) {
+        auto &connections = shard.connections;
+        connections.erase(std::find_if(connections.begin(), connections.end(),
+                                       [&](const connection_ptr_t &c) {
+                                           return c.get() == &connection;
+                                       }));
+        for (auto &command : queued) {
+            command.completion.post(ec, result_t{}, shard.strand);
+        }
+        return;
+    }
+    connection.multiplexer = std::make_unique<multiplexer_t>(std::move(stream));
+    connection.multiplexer->set_window(options_.window);
+    for (auto &command : queued) {
+        connection.multiplexer->async_send(command.command, command.replies,
+                                           command.wrap,
+                                           std::move(command.completion));
+    }
+}
+
+// the timer is armed, while there are surplus connections: it expires,
+// when the least recently used one has not been used for idle_timeout
+template <typename NextLayer>
+void ConnectionPool<NextLayer>::schedule_shrink(shard_t &shard) {
+    auto &connections = shard.connections;
+    if (shard.shrink_scheduled ||
+        connections.size() <= options_.min_connections) {
+        return;
+    }
+    auto now = clock_t::now();
+    auto expiry = std::min_element(connections.begin(), connections.end(),
+                                   [](const connection_ptr_t &a,
+                                      const connection_ptr_t &b) {
+                                       return a->used < b->used;
+                                   })
+                      ->get()
+                      ->used +
+                  options_.idle_timeout;
+    // the busy connection is checked again after the whole timeout
+    if (expiry <= now) {
+        expiry = now + options_.idle_timeout;
+    }
+    shard.shrink_scheduled = true;
+    shard.shrink_timer.expires_at(expiry);
+    // the timer is bound to the strand; it is cancelled, when the pool is
+    // destroyed, i.e. the pool is not accessed then
+    shard.shrink_timer.async_wait(
+        [this, &shard](const boost::system::error_code &ec) {
+            if (ec) {
+                return;
+            }
+            shard.shrink_scheduled = false;
+            shrink(shard);
+            schedule_shrink(shard);
+        });
+}
+
+// the surplus connections are closed, when they are idle long enough, so
+// the pool does not shrink and grow back on the load bursts
+template <typename NextLayer>
+void ConnectionPool<NextLayer>::shrink(shard_t &shard) {
+    auto &connections = shard.connections;
+    if (connections.size() <= options_.min_connections) {
+        return;
+    }
+    auto surplus = connections.size() - options_.min_connections;
+    auto idle_since = clock_t::now() - options_.idle_timeout;
+    connections.erase(
+        std::remove_if(connections.begin(), connections.end(),
+                       [&](const connection_ptr_t &c) {
+                           if (!surplus || !c->multiplexer ||
+                               !c->multiplexer->idle() ||
+                               c->used > idle_since) {
+                               return false;
+                           }
+                           --surplus;
+                           return true;
+                       }),
+        connections.end());
+}
+
+template <typename NextLayer>
+typename ConnectionPool<NextLayer>::queued_t
+ConnectionPool<NextLayer>::make_queued(const command_wrapper_t &command,
+                                       completion_t completion) {
+    queued_t queued{std::string(command_size(command), '\0'),
+                    details::command_replies(command),
+                    details::replies_wrapped(command), std::move(completion)};
+    write_command(&queued.command[0], command);
+    return queued;
+}
+
+} // namespace bredis
@@ -0,0 +1,320 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include "../Protocol.hpp"
+#include "../Result.hpp"
+#include "tape.ipp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+namespace bredis {
+
+// The element-by-element read state: the aggregate header is parsed, and
+// then its elements are passed to the handler (and consumed from rx_buff)
+// by batches of at most batch_size elements as soon as they arrive. The
+// elements are parsed in a single pass, like in async_read_op_impl.
+//
+// Any other reply (including nil and attribute) is not consumed at all, so
+// it can be read via the regular async_read.
+template <typename DynamicBuffer, typename Handler>
+class elements_read_op_impl {
+    using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
+    using array_t = markers::array_holder_t<Iterator>;
+    enum class stage_t { header, elements, done };
+
+    Handler handler_;
+    std::size_t batch_size_;
+    stage_t stage_;
+    // elements left in the aggregate
+    std::size_t left_;
+    // parsed, but not yet delivered elements
+    std::size_t batched_;
+    std::size_t scanned_;
+    std::size_t needed_;
+    details::incremental_parser_t parser_;
+    tape_t tape_;
+    array_t batch_;
+    elements_result_t result_;
+    boost::system::error_code error_code_;
+
+  public:
+    elements_read_op_impl(Handler handler, std::size_t batch_size)
+        : handler_(std::move(handler)), batch_size_{std::max<std::size_t>(
+                                            batch_size, 1)},
+          stage_{stage_t::header}, left_{0}, batched_{0}, scanned_{0},
+          needed_{0}, parser_{BREDIS_MAX_DEPTH - 1}, result_{false, 0} {}
+
+    bool done() const { return error_code_ || stage_ == stage_t::done; }
+
+    const boost::system::error_code &error() const { return error_code_; }
+
+    const elements_result_t &result() const { return result_; }
+
+    // processes the newly arrived data, returns true if the read is done
+    bool feed(DynamicBuffer &rx_buff) {
+        while (!done()) {
+            bool progress = stage_ == stage_t::header
+                                ? feed_header(rx_buff)
+                                : feed_elements(rx_buff);
+            if (!progress) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the amount of bytes to be requested from the stream, see
+    // async_read_op_impl::read_size
+    std::size_t read_size(const DynamicBuffer &rx_buff) const {
+        auto room = rx_buff.max_size() - rx_buff.size();
+        auto size = std::min<std::size_t>(
+            std::max<std::size_t>(512, rx_buff.capacity() - rx_buff.size()),
+            std::min<std::size_t>(65536, room));
+        auto pending = std::min<std::size_t>(needed_, BREDIS_MAX_READ_SIZE);
+        return std::max(size, std::min(pending, room));
+    }
+
+    std::size_t needed() const { return needed_; }
+
+  private:
+    bool feed_header(DynamicBuffer &rx_buff) {
+        auto const_buff = rx_buff.data();
+        auto from = Iterator::begin(const_buff);
+        auto to = Iterator::end(const_buff);
+        if (from == to) {
+            return false;
+        }
+        char introduction = *from;
+        if (!details::is_aggregate(introduction) || introduction == '|') {
+            stage_ = stage_t::done;
+            return true;
+        }
+        auto count_from = std::next(from);
+        auto found_terminator = terminator.search(count_from, to);
+        if (found_terminator == to) {
+            return false;
+        }
+
+        std::int64_t count;
+        if (!details::convert_count(count_from, found_terminator, count)) {
+            error_code_ =
+                Error::make_error_code(bredis_errors::count_conversion);
+        } else if (count == -1) {
+            stage_ = stage_t::done;
+        } else if (count < -1 ||
+                   !details::aggregate_elements(
+                       introduction, static_cast<size_t>(count), left_)) {
+            error_code_ = Error::make_error_code(bredis_errors::count_range);
+        } else {
+            result_ = elements_result_t{true, left_};
+            stage_ = left_ ? stage_t::elements : stage_t::done;
+            rx_buff.consume(std::distance(from, found_terminator) +
+                            terminator.size);
+        }
+        return true;
+    }
+
+    bool feed_elements(DynamicBuffer &rx_buff) {
+        namespace asio = boost::asio;
+
+        auto const_buff = rx_buff.data();
+        auto first = asio::buffer_sequence_begin(const_buff);
+        auto last = asio::buffer_sequence_end(const_buff);
+        bool batch_ready;
+        if (first == last) {
+            return false;
+        } else if (std::next(first) == last) {
+            asio::const_buffer contiguous_buff(*first);
+            auto begin = static_cast<const char *>(contiguous_buff.data());
+            batch_ready = scan(begin, begin + contiguous_buff.size());
+        } else {
+            batch_ready =
+                scan(Iterator::begin(const_buff), Iterator::end(const_buff));
+        }
+        if (!batch_ready) {
+            return false;
+        } else if (!error_code_) {
+            deliver(rx_buff);
+        }
+        return true;
+    }
+
+    // returns true if the batch is complete or on error
+    template <typename DataIterator>
+    bool scan(const DataIterator &begin, const DataIterator &end) {
+        details::tape_builder_t<DataIterator> builder{tape_, begin};
+        while (batched_ < batch_size_ && batched_ < left_) {
+            auto parse_result = parser_.feed(begin + scanned_, end, builder);
+            if (parse_result.error) {
+                error_code_ = parse_result.error;
+                return true;
+            }
+            scanned_ += parse_result.consumed;
+            if (!parse_result.complete) {
+                needed_ = parse_result.needed;
+                return false;
+            }
+            ++batched_;
+        }
+        return true;
+    }
+
+    void deliver(DynamicBuffer &rx_buff) {
+        // the markers refer to the buffer sequence
+        auto const_buff = rx_buff.data();
+        details::tape_materializer_t<Iterator> materializer(
+            tape_, Iterator::begin(const_buff));
+        batch_.elements.clear();
+        for (std::size_t i = 0; i < batched_; ++i) {
+            batch_.elements.emplace_back(materializer.next());
+        }
+        handler_(static_cast<const array_t &>(batch_), error_code_);
+        batch_.elements.clear();
+
+        rx_buff.consume(scanned_);
+        left_ -= batched_;
+        batched_ = 0;
+        scanned_ = 0;
+        needed_ = 0;
+        tape_.nodes.clear();
+        if (!left_) {
+            stage_ = stage_t::done;
+        }
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Handler,
+          typename ReadCallback>
+class elements_read_op {
+    NextLayer &stream_;
+    DynamicBuffer &rx_buff_;
+    elements_read_op_impl<DynamicBuffer, Handler> impl_;
+    ReadCallback callback_;
+
+  public:
+    elements_read_op(elements_read_op &&) = default;
+    elements_read_op(const elements_read_op &) = default;
+
+    template <class DeducedHandler>
+    elements_read_op(DeducedHandler &&deduced_handler, NextLayer &stream,
+                     DynamicBuffer &rx_buff, Handler handler,
+                     std::size_t batch_size)
+        : stream_(stream), rx_buff_(rx_buff),
+          impl_(std::move(handler), batch_size),
+          callback_(std::forward<ReadCallback>(deduced_handler)) {}
+
+    void operator()(boost::system::error_code, std::size_t bytes_transferred,
+                    bool start = false);
+
+    const ReadCallback &callback() const { return callback_; }
+
+    friend bool asio_handler_is_continuation(elements_read_op *op) {
+        using boost::asio::asio_handler_is_continuation;
+        return asio_handler_is_continuation(std::addressof(op->callback_));
+    }
+
+    friend void *asio_handler_allocate(std::size_t size,
+                                       elements_read_op *op) {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(size, std::addressof(op->callback_));
+    }
+
+    friend void asio_handler_deallocate(void *p, std::size_t size,
+                                        elements_read_op *op) {
+        using boost::asio::asio_handler_deallocate;
+        return asio_handler_deallocate(p, size, std::addressof(op->callback_));
+    }
+
+    template <class Function>
+    friend void asio_handler_invoke(Function &&f, elements_read_op *op) {
+        using boost::asio::asio_handler_invoke;
+        return asio_handler_invoke(f, std::addressof(op->callback_));
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Handler,
+          typename ReadCallback>
+void elements_read_op<NextLayer, DynamicBuffer, Handler, ReadCallback>::
+operator()(boost::system::error_code error_code,
+           std::size_t bytes_transferred, bool start) {
+    if (!start) {
+        rx_buff_.commit(bytes_transferred);
+    }
+    if (!error_code && !impl_.done()) {
+        if (!impl_.feed(rx_buff_)) {
+            if (rx_buff_.size() == rx_buff_.max_size()) {
+                error_code = boost::asio::error::not_found;
+            } else {
+                auto buffers = rx_buff_.prepare(impl_.read_size(rx_buff_));
+                auto needed = impl_.needed();
+                if (needed > 1) {
+                    boost::asio::async_read(
+                        stream_, buffers,
+                        boost::asio::transfer_at_least(needed),
+                        std::move(*this));
+                } else {
+                    stream_.async_read_some(buffers, std::move(*this));
+                }
+                return;
+            }
+        } else if (start) {
+            // the callback must not be invoked from the initiating function
+            stream_.async_read_some(boost::asio::mutable_buffer(),
+                                    std::move(*this));
+            return;
+        }
+    }
+    if (!error_code) {
+        error_code = impl_.error();
+    }
+    callback_(error_code, impl_.result());
+}
+
+} // namespace bredis
+
+namespace boost {
+namespace asio {
+
+template <typename NextLayer, typename DynamicBuffer, typename Handler,
+          typename ReadCallback, typename Executor>
+struct associated_executor<
+    bredis::elements_read_op<NextLayer, DynamicBuffer, Handler, ReadCallback>,
+    Executor> {
+    using type = associated_executor_t<ReadCallback, Executor>;
+
+    static type get(const bredis::elements_read_op<NextLayer, DynamicBuffer,
+                                                   Handler, ReadCallback> &op,
+                    const Executor &executor = Executor()) noexcept {
+        return associated_executor<ReadCallback, Executor>::get(op.callback(),
+                                                                executor);
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Handler,
+          typename ReadCallback, typename Allocator>
+struct associated_allocator<
+    bredis::elements_read_op<NextLayer, DynamicBuffer, Handler, ReadCallback>,
+    Allocator> {
+    using type = associated_allocator_t<ReadCallback, Allocator>;
+
+    static type get(const bredis::elements_read_op<NextLayer, DynamicBuffer,
+                                                   Handler, ReadCallback> &op,
+                    const Allocator &allocator = Allocator()) noexcept {
+        return associated_allocator<ReadCallback, Allocator>::get(
+            op.callback(), allocator);
+    }
+};
+
+} // namespace asio
+} // namespace boost
@@ -0,0 +1,145 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "../Error.hpp"
+#include "incremental_parser.ipp"
+#include "numbers.ipp"
+#include "protocol.ipp"
+
+namespace bredis {
+
+namespace details {
+
+// translates incremental_parser_t events into the decoded ones; once the
+// decoding fails, the rest of the events is ignored
+template <typename Iterator, typename Handler> struct events_adapter_t {
+    using string_t = markers::string_t<Iterator>;
+
+    Handler &handler_;
+    std::vector<bool> &arrays_;
+    boost::system::error_code &error_;
+
+    void on_string(const Iterator &from, const Iterator &to) {
+        if (!error_) {
+            handler_.on_string(string_t{from, to});
+        }
+    }
+
+    void on_error(const Iterator &from, const Iterator &to) {
+        if (!error_) {
+            handler_.on_error(string_t{from, to});
+        }
+    }
+
+    void on_int(const Iterator &from, const Iterator &to) {
+        std::int64_t value;
+        if (error_) {
+            return;
+        } else if (!parse_integer(from, to, value)) {
+            error_ = Error::make_error_code(bredis_errors::count_conversion);
+            return;
+        }
+        handler_.on_int(value);
+    }
+
+    void on_nil(const Iterator & /*from*/, const Iterator & /*to*/) {
+        if (!error_) {
+            handler_.on_nil();
+        }
+    }
+
+    void on_double(const Iterator &from, const Iterator &to) {
+        double value;
+        if (error_) {
+            return;
+        } else if (!parse_double(from, to, value)) {
+            error_ = Error::make_error_code(bredis_errors::parser_error);
+            return;
+        }
+        handler_.on_double(value);
+    }
+
+    void on_bool(const Iterator &from, const Iterator & /*to*/) {
+        if (!error_) {
+            handler_.on_bool(*from == 't');
+        }
+    }
+
+    void on_big_number(const Iterator &from, const Iterator &to) {
+        if (!error_) {
+            handler_.on_big_number(string_t{from, to});
+        }
+    }
+
+    void on_verbatim(const Iterator &from, const Iterator &to) {
+        if (!error_) {
+            auto format_end = std::next(from, 3);
+            handler_.on_verbatim(markers::verbatim_t<Iterator>{
+                string_t{from, format_end},
+                string_t{std::next(format_end), to}});
+        }
+    }
+
+    void on_aggregate_begin(tape_kind_t kind, size_t count) {
+        bool is_array = kind == tape_kind_t::array;
+        arrays_.push_back(is_array);
+        if (error_) {
+            return;
+        } else if (is_array) {
+            handler_.on_array_begin(count);
+        } else {
+            handler_.on_aggregate_begin(kind, count);
+        }
+    }
+
+    void on_aggregate_end() {
+        bool is_array = arrays_.back();
+        arrays_.pop_back();
+        if (error_) {
+            return;
+        } else if (is_array) {
+            handler_.on_array_end();
+        } else {
+            handler_.on_aggregate_end();
+        }
+    }
+};
+
+} // namespace details
+
+template <typename Iterator, typename Handler>
+events_result_t event_parser_t::feed(const Iterator &from, const Iterator &to,
+                                     Handler &handler) {
+    events_result_t result{0, 0, {}};
+    details::events_adapter_t<Iterator, Handler> events{handler, arrays_,
+                                                        result.error};
+    auto it = from;
+    while (it != to) {
+        auto parsed = parser_.feed(it, to, events);
+        if (parsed.error) {
+            result.error = parsed.error;
+        }
+        if (result.error) {
+            break;
+        }
+        result.consumed += parsed.consumed;
+        std::advance(it, parsed.consumed);
+        if (!parsed.complete) {
+            break;
+        }
+        ++result.replies;
+    }
+    return result;
+}
+
+} // namespace bredis
@@ -0,0 +1,328 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <boost/system/error_code.hpp>
+
+#include "../Error.hpp"
+#include "../Tape.hpp"
+
+namespace bredis {
+
+namespace details {
+
+struct incremental_result_t {
+    // amount of processed bytes, i.e. the next feed should start from the
+    // previous position advanced by this value
+    size_t consumed;
+    // the top-level reply has been completely scanned
+    bool complete;
+    boost::system::error_code error;
+    // the minimal amount of bytes, which should be appended to the data
+    // before the next feed can make a progress; it is exact for the pending
+    // bulk string, and it is 1 when the size of the element is unknown
+    size_t needed;
+};
+
+// events sink, which ignores everything, i.e. just validates the reply
+struct drop_events_t {
+    template <typename Iterator>
+    void on_string(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_error(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_int(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_nil(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_double(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_bool(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    template <typename Iterator>
+    void on_big_number(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    // the whole payload, i.e. including the format prefix
+    template <typename Iterator>
+    void on_verbatim(const Iterator & /*from*/, const Iterator & /*to*/) {}
+
+    // array, map, set, push or attribute; the count is the amount of
+    // the nested elements, see tape_node_t::size
+    void on_aggregate_begin(tape_kind_t /*kind*/, size_t /*count*/) {}
+
+    void on_aggregate_end() {}
+};
+
+// Resumable counterpart of Protocol::parse. Unlike the one-shot parser it
+// does not restart from the reply beginning when more data arrives: the
+// nesting stack, the left array elements and the size of the pending bulk
+// string are kept between the feeds, so each byte of the (possibly huge)
+// reply is scanned only once.
+//
+// The incomplete element is never reported as consumed, i.e. the next feed
+// starts from its beginning. This guarantees that every element is passed
+// to the events handler as a whole range within a single feed. It costs
+// nothing for bulk strings (the payload is not scanned, only its size
+// is checked), and the already scanned part of an incomplete line (simple
+// string, error, int or count header) is skipped.
+//
+// The events handler is notified about markers in the order of their
+// appearance, see drop_events_t for the interface. The aggregates nested
+// deeper than max_depth are rejected with bredis_errors::nesting_depth.
+class incremental_parser_t {
+    enum class stage_t { introduction, line, bulk };
+
+    stage_t stage_;
+    char line_kind_;
+    size_t line_scanned_;
+    size_t bulk_size_;
+    // elements left in the nested arrays
+    std::vector<size_t> stack_;
+    size_t max_depth_;
+
+  public:
+    explicit incremental_parser_t(size_t max_depth = BREDIS_MAX_DEPTH)
+        : max_depth_{max_depth} {
+        reset();
+    }
+
+    void reset() {
+        stage_ = stage_t::introduction;
+        line_kind_ = 0;
+        line_scanned_ = 0;
+        bulk_size_ = 0;
+        stack_.clear();
+    }
+
+    template <typename Iterator>
+    incremental_result_t feed(const Iterator &from, const Iterator &to) {
+        drop_events_t events;
+        return feed(from, to, events);
+    }
+
+    template <typename Iterator, typename Handler>
+    incremental_result_t feed(const Iterator &from, const Iterator &to,
+                              Handler &handler) {
+        Iterator it = from;
+        size_t consumed = 0;
+        while (true) {
+            switch (stage_) {
+            case stage_t::introduction: {
+                if (it == to) {
+                    return incremental_result_t{consumed, false, {}, 1};
+                }
+                switch (*it) {
+                case '+':
+                case '-':
+                case ':':
+                case '$':
+                case '*':
+                // RESP3
+                case ',':
+                case '#':
+                case '(':
+                case '_':
+                case '!':
+                case '=':
+                case '%':
+                case '~':
+                case '>':
+                case '|':
+                    line_kind_ = *it;
+                    break;
+                default:
+                    return failure(bredis_errors::wrong_intoduction);
+                }
+                ++it;
+                ++consumed;
+                stage_ = stage_t::line;
+                line_scanned_ = 0;
+                break;
+            }
+            case stage_t::line: {
+                // the terminator might be split between the feeds
+                size_t skip = line_scanned_ >= terminator.size
+                                  ? line_scanned_ - (terminator.size - 1)
+                                  : 0;
+                auto found_terminator = terminator.search(it + skip, to);
+                if (found_terminator == to) {
+                    line_scanned_ = std::distance(it, to);
+                    return incremental_result_t{consumed, false, {}, 1};
+                }
+
+                bool element_complete = false;
+                switch (line_kind_) {
+                case '+':
+                    handler.on_string(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case '-':
+                    handler.on_error(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case ':':
+                    handler.on_int(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case ',':
+                    handler.on_double(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case '#':
+                    if (!marker_factory_t<markers::bool_t>::valid(
+                            it, found_terminator)) {
+                        return failure(bredis_errors::parser_error);
+                    }
+                    handler.on_bool(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case '(':
+                    handler.on_big_number(it, found_terminator);
+                    element_complete = true;
+                    break;
+                case '_':
+                    handler.on_nil(it, found_terminator);
+                    element_complete = true;
+                    break;
+                default: {
+                    std::int64_t count;
+                    if (!convert_count(it, found_terminator, count)) {
+                        return failure(bredis_errors::count_conversion);
+                    } else if (count < -1) {
+                        return failure(bredis_errors::count_range);
+                    }
+                    if (count == -1) {
+                        handler.on_nil(it, found_terminator);
+                        element_complete = true;
+                    } else if (line_kind_ == '$' || line_kind_ == '!' ||
+                               line_kind_ == '=') {
+                        if (count > BREDIS_MAX_BULK_SIZE) {
+                            return failure(bredis_errors::count_range);
+                        }
+                        stage_ = stage_t::bulk;
+                        bulk_size_ = static_cast<size_t>(count);
+                    } else {
+                        auto kind = aggregate_kind(line_kind_);
+                        auto elements = static_cast<size_t>(count);
+                        if (kind == tape_kind_t::map ||
+                            kind == tape_kind_t::attribute) {
+                            if (elements > (SIZE_MAX - 1) / 2) {
+                                return failure(bredis_errors::count_range);
+                            }
+                            // keys and values; the attributed reply
+                            elements = elements * 2 +
+                                       (kind == tape_kind_t::attribute);
+                        }
+                        if (elements > static_cast<size_t>(
+                                           BREDIS_MAX_AGGREGATE_SIZE)) {
+                            return failure(bredis_errors::count_range);
+                        }
+                        if (stack_.size() >= max_depth_) {
+                            return failure(bredis_errors::nesting_depth);
+                        }
+                        handler.on_aggregate_begin(kind, elements);
+                        if (elements == 0) {
+                            handler.on_aggregate_end();
+                            element_complete = true;
+                        } else {
+                            stage_ = stage_t::introduction;
+                            stack_.push_back(elements);
+                        }
+                    }
+                }
+                }
+
+                consumed += std::distance(it, found_terminator) +
+                            terminator.size;
+                it = found_terminator + terminator.size;
+                if (element_complete && pop_element(handler)) {
+                    return incremental_result_t{consumed, true, {}, 0};
+                }
+                break;
+            }
+            case stage_t::bulk: {
+                size_t available = std::distance(it, to);
+                size_t bulk_end = bulk_size_ + terminator.size;
+                if (available < bulk_end) {
+                    return incremental_result_t{consumed, false, {},
+                                                bulk_end - available};
+                }
+                auto tail = it + bulk_size_;
+                auto tail_end = tail + terminator.size;
+                if (!terminator.equal(tail, tail_end)) {
+                    return failure(bredis_errors::bulk_terminator);
+                }
+                if (line_kind_ == '!') {
+                    handler.on_error(it, tail);
+                } else if (line_kind_ == '=') {
+                    if (!marker_factory_t<markers::verbatim_t>::valid(it,
+                                                                      tail)) {
+                        return failure(bredis_errors::parser_error);
+                    }
+                    handler.on_verbatim(it, tail);
+                } else {
+                    handler.on_string(it, tail);
+                }
+                it = tail_end;
+                consumed += bulk_size_ + terminator.size;
+                if (pop_element(handler)) {
+                    return incremental_result_t{consumed, true, {}, 0};
+                }
+                break;
+            }
+            }
+        }
+    }
+
+  private:
+    static tape_kind_t aggregate_kind(char line_kind) {
+        switch (line_kind) {
+        case '%':
+            return tape_kind_t::map;
+        case '~':
+            return tape_kind_t::set;
+        case '>':
+            return tape_kind_t::push;
+        case '|':
+            return tape_kind_t::attribute;
+        default:
+            return tape_kind_t::array;
+        }
+    }
+
+    static incremental_result_t failure(bredis_errors error) {
+        return incremental_result_t{0, false, Error::make_error_code(error),
+                                    0};
+    }
+
+    // returns true if the top-level reply has been completed
+    template <typename Handler> bool pop_element(Handler &handler) {
+        stage_ = stage_t::introduction;
+        while (!stack_.empty()) {
+            if (--stack_.back()) {
+                return false;
+            }
+            stack_.pop_back();
+            handler.on_aggregate_end();
+        }
+        return true;
+    }
+};
+
+} // namespace details
+
+} // namespace bredis
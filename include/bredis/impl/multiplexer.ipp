@@ -0,0 +1,321 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "async_op.ipp"
+#include "common.ipp"
+
+namespace bredis {
+
+namespace details {
+
+inline std::size_t command_replies(const command_wrapper_t &command) {
+    std::size_t replies = 0;
+    for_each_command(command, [&replies](const auto &) { ++replies; });
+    return replies;
+}
+
+// the replies are passed as array by the type of the command, not by the
+// amount of them, i.e. a container of one command gets array too
+inline bool replies_wrapped(const command_wrapper_t &command) {
+    return !boost::get<single_command_t>(&command) &&
+           !boost::get<bound_command_t>(&command);
+}
+
+} // namespace details
+
+template <typename NextLayer>
+template <typename CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(
+    CompletionToken,
+    void(boost::system::error_code,
+         typename Multiplexer<NextLayer>::result_t))
+Multiplexer<NextLayer>::async_execute(const command_wrapper_t &command,
+                                      CompletionToken &&token) {
+    using Signature = void(boost::system::error_code, result_t);
+    using AsyncResult =
+        boost::asio::async_result<std::decay_t<CompletionToken>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    CompletionHandler handler(std::forward<CompletionToken>(token));
+    AsyncResult result(handler);
+    submit(details::command_replies(command),
+           details::replies_wrapped(command), command_size(command),
+           [&command](char *out) { write_command(out, command); },
+           completion_t(std::move(handler)));
+    return result.get();
+}
+
+template <typename NextLayer>
+template <typename CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(
+    CompletionToken,
+    void(boost::system::error_code,
+         typename Multiplexer<NextLayer>::result_t))
+Multiplexer<NextLayer>::async_send(boost::string_ref serialized,
+                                   std::size_t replies, bool wrap,
+                                   CompletionToken &&token) {
+    using Signature = void(boost::system::error_code, result_t);
+    using AsyncResult =
+        boost::asio::async_result<std::decay_t<CompletionToken>, Signature>;
+    using CompletionHandler = typename AsyncResult::completion_handler_type;
+
+    if (replies > 1 && !wrap) {
+        throw std::invalid_argument("multiple replies must be wrapped");
+    }
+    CompletionHandler handler(std::forward<CompletionToken>(token));
+    AsyncResult result(handler);
+    submit(replies, wrap, serialized.size(),
+           [serialized](char *out) {
+               std::copy(serialized.begin(), serialized.end(), out);
+           },
+           completion_t(std::move(handler)));
+    return result.get();
+}
+
+template <typename NextLayer>
+template <typename Writer>
+void Multiplexer<NextLayer>::submit(std::size_t replies, bool wrap,
+                                    std::size_t size, Writer &&writer,
+                                    completion_t completion) {
+    if (!replies) {
+        throw std::invalid_argument("no commands to execute");
+    }
+    if (error_) {
+        completion.post(error_, result_t{}, get_executor());
+        return;
+    }
+
+    if (!waiting_.empty() || !fits(replies, size)) {
+        if (window_.fail_fast) {
+            completion.post(Error::make_error_code(bredis_errors::window_full),
+                            result_t{}, get_executor());
+            return;
+        }
+        waiting_t waiting{std::string(size, '\0'), replies, wrap,
+                          std::move(completion)};
+        writer(&waiting.command[0]);
+        waiting_.push_back(std::move(waiting));
+        return;
+    }
+
+    auto offset = queued_.size();
+    queued_.resize(offset + size);
+    writer(&queued_[offset]);
+    pending_.push_back(pending_t{replies, wrap, std::move(completion)});
+    awaited_ += replies;
+
+    schedule_flush();
+    read();
+}
+
+template <typename NextLayer>
+void Multiplexer<NextLayer>::set_window(const pipeline_window_t &window) {
+    window_ = window;
+    admit();
+}
+
+template <typename NextLayer>
+bool Multiplexer<NextLayer>::fits(std::size_t replies,
+                                  std::size_t size) const {
+    auto tx_bytes = queued_.size() + tx_buff_.size();
+    bool in_flight = !window_.max_in_flight || !awaited_ ||
+                     awaited_ + replies <= window_.max_in_flight;
+    bool bytes = !window_.max_tx_bytes || !tx_bytes ||
+                 tx_bytes + size <= window_.max_tx_bytes;
+    return in_flight && bytes;
+}
+
+// the waiting commands are moved into the window in their order, as the
+// replies are dispatched and the queued commands are written
+template <typename NextLayer> void Multiplexer<NextLayer>::admit() {
+    if (error_ || waiting_.empty()) {
+        return;
+    }
+    bool admitted = false;
+    while (!waiting_.empty() &&
+           fits(waiting_.front().replies, waiting_.front().command.size())) {
+        auto &waiting = waiting_.front();
+        queued_.append(waiting.command);
+        pending_.push_back(pending_t{waiting.replies, waiting.wrap,
+                                     std::move(waiting.completion)});
+        awaited_ += waiting.replies;
+        waiting_.pop_front();
+        admitted = true;
+    }
+    if (admitted) {
+        schedule_flush();
+        read();
+    }
+}
+
+// the flush is posted, so all the commands of the current tick are queued
+// by then; while the write is in progress, the commands are queued to be
+// written right after it
+template <typename NextLayer> void Multiplexer<NextLayer>::schedule_flush() {
+    if (writing_ || flush_scheduled_) {
+        return;
+    }
+    flush_scheduled_ = true;
+    boost::asio::post(next_layer().get_executor(), [this]() {
+        flush_scheduled_ = false;
+        write();
+    });
+}
+
+template <typename NextLayer> void Multiplexer<NextLayer>::write() {
+    if (writing_ || error_ || queued_.empty()) {
+        return;
+    }
+    // the buffers are swapped, i.e. their capacity is reused
+    std::swap(tx_buff_, queued_);
+    writing_ = true;
+    boost::asio::async_write(
+        next_layer(), boost::asio::buffer(tx_buff_),
+        [this](const boost::system::error_code &ec, std::size_t) {
+            writing_ = false;
+            tx_buff_.clear();
+            if (ec) {
+                fail(ec);
+                return;
+            }
+            admit();
+            write();
+        });
+}
+
+template <typename NextLayer> void Multiplexer<NextLayer>::read() {
+    if (reading_ || error_ || !awaited_) {
+        return;
+    }
+    using parse_result_t =
+        BREDIS_PARSE_RESULT(Buffer, bredis::parsing_policy::keep_result);
+    reading_ = true;
+    connection_.async_read_available(
+        *rx_buff_,
+        [this](const boost::system::error_code &ec, parse_result_t &&result,
+               std::size_t count) {
+            on_replies(ec, result.result, count, result.consumed);
+        },
+        awaited_);
+}
+
+// the available replies do not cover the front command, so all of its
+// replies are awaited
+template <typename NextLayer> void Multiplexer<NextLayer>::read_front() {
+    using parse_result_t =
+        BREDIS_PARSE_RESULT(Buffer, bredis::parsing_policy::keep_result);
+    auto count = pending_.front().replies;
+    reading_ = true;
+    connection_.async_read(
+        *rx_buff_,
+        [this, count](const boost::system::error_code &ec,
+                      parse_result_t &&result) {
+            on_replies(ec, result.result, count, result.consumed);
+        },
+        count);
+}
+
+template <typename NextLayer>
+void Multiplexer<NextLayer>::on_replies(const boost::system::error_code &ec,
+                                        reply_t &replies, std::size_t count,
+                                        std::size_t consumed) {
+    if (error_) {
+        reading_ = false;
+        return;
+    }
+    if (ec) {
+        reading_ = false;
+        fail(ec);
+        return;
+    }
+
+    // the read is still marked as in progress, so the commands issued by
+    // the handlers do not start the new one until rx_buff is consumed
+    auto &elements =
+        boost::get<markers::array_holder_t<Iterator>>(replies).elements;
+    std::size_t dispatched = 0;
+    while (!pending_.empty() &&
+           pending_.front().replies <= count - dispatched) {
+        auto pending = std::move(pending_.front());
+        pending_.pop_front();
+        awaited_ -= pending.replies;
+
+        auto first = elements.begin() + dispatched;
+        dispatched += pending.replies;
+        result_t result{reply_t{}, rx_buff_};
+        if (!pending.wrap) {
+            result.result = std::move(*first);
+        } else {
+            markers::array_holder_t<Iterator> array;
+            array.elements.assign(
+                std::make_move_iterator(first),
+                std::make_move_iterator(first + pending.replies));
+            result.result = std::move(array);
+        }
+        pending.completion.dispatch(ec, std::move(result), get_executor());
+        if (error_) {
+            reading_ = false;
+            return;
+        }
+    }
+
+    if (dispatched < count) {
+        if (!dispatched) {
+            read_front();
+            return;
+        }
+        // the replies of the partially read command are left in rx_buff
+        async_read_op_impl<Buffer, parsing_policy::drop_result> skipped(
+            dispatched);
+        skipped.feed(*rx_buff_);
+        consumed = skipped.result(rx_buff_->data()).consumed;
+    }
+    if (rx_buff_.use_count() > 1) {
+        // the replies are kept by the handlers, so the rest of the data
+        // is moved into the released buffer
+        auto rest = buffers_->acquire();
+        auto data = rx_buff_->data();
+        auto size = data.size() - consumed;
+        rest->commit(boost::asio::buffer_copy(rest->prepare(size),
+                                              data + consumed));
+        rx_buff_ = std::move(rest);
+    } else {
+        rx_buff_->consume(consumed);
+    }
+    reading_ = false;
+    admit();
+    read();
+}
+
+// the stream is closed, so the operations in progress are aborted and the
+// multiplexer becomes idle, i.e. it can be replaced
+template <typename NextLayer>
+void Multiplexer<NextLayer>::fail(const boost::system::error_code &ec) {
+    boost::system::error_code ignored;
+    next_layer().lowest_layer().close(ignored);
+    error_ = ec;
+    awaited_ = 0;
+    queued_.clear();
+    auto pending = std::move(pending_);
+    pending_.clear();
+    auto waiting = std::move(waiting_);
+    waiting_.clear();
+    for (auto &command : pending) {
+        command.completion.dispatch(ec, result_t{}, get_executor());
+    }
+    for (auto &command : waiting) {
+        command.completion.dispatch(ec, result_t{}, get_executor());
+    }
+}
+
+} // namespace bredis
@@ -0,0 +1,456 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace bredis {
+
+namespace details {
+
+// Converts decimal (optionally negative) integer directly from the iterator
+// range, without memory allocations and without touching errno. Returns
+// false if the range is empty, contains anything besides digits (and the
+// leading minus) or the value does not fit into Integer.
+template <typename Integer, typename Iterator>
+bool parse_integer(Iterator from, const Iterator &to, Integer &value) {
+    static_assert(std::is_integral<Integer>::value &&
+                      std::is_signed<Integer>::value,
+                  "signed integer is expected");
+    using unsigned_t = std::make_unsigned_t<Integer>;
+
+    if (from == to) {
+        return false;
+    }
+    bool negative = (*from == '-');
+    if (negative && (++from == to)) {
+        return false;
+    }
+
+    const unsigned_t max = std::numeric_limits<Integer>::max();
+    const unsigned_t limit = negative ? max + 1 : max;
+    unsigned_t result = 0;
+    for (; from != to; ++from) {
+        auto digit = static_cast<unsigned_t>(static_cast<unsigned char>(*from) -
+                                             static_cast<unsigned char>('0'));
+        if (digit > 9 || result > (limit - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+
+    if (negative && result) {
+        // -limit is not representable as positive Integer
+        value = -static_cast<Integer>(result - 1) - 1;
+    } else {
+        value = static_cast<Integer>(result);
+    }
+    return true;
+}
+
+// Converts RESP3 double, i.e. decimal floating point number (the exponent
+// is allowed) or "inf", "-inf", "nan"; the conversion does not depend on
+// the global locale.
+template <typename Iterator>
+bool parse_double(const Iterator &from, const Iterator &to, double &value) {
+    std::string str{from, to};
+    if (str == "inf" || str == "+inf") {
+        value = std::numeric_limits<double>::infinity();
+        return true;
+    } else if (str == "-inf") {
+        value = -std::numeric_limits<double>::infinity();
+        return true;
+    } else if (str == "nan" || str == "-nan") {
+        value = std::numeric_limits<double>::quiet_NaN();
+        return true;
+    } else if (str.empty() || std::strchr("+-.0123456789", str[0]) == nullptr) {
+        return false;
+    }
+
+    std::istringstream is{str};
+    is.imbue(std::locale::classic());
+    is >> value;
+    return !is.fail() && is.peek() == std::char_traits<char>::eof();
+}
+
+// the amount of digits in the decimal representation
+inline std::size_t decimal_length(std::uint64_t value) {
+    std::size_t length = 1;
+    for (; value >= 100; value /= 100) {
+        length += 2;
+    }
+    return value >= 10 ? length + 1 : length;
+}
+
+// Writes the decimal representation (two digits per step, without locale
+// and intermediate string), returns the end of the written digits.
+inline char *write_decimal(char *out, std::uint64_t value) {
+    static const char digit_pairs[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+    auto end = out + decimal_length(value);
+    auto digit = end;
+    for (; value >= 100; value /= 100) {
+        auto pair = digit_pairs + (value % 100) * 2;
+        *--digit = pair[1];
+        *--digit = pair[0];
+    }
+    if (value >= 10) {
+        *--digit = digit_pairs[value * 2 + 1];
+        *--digit = digit_pairs[value * 2];
+    } else {
+        *--digit = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+// the magnitude of the integer (without overflow for the minimal one)
+inline std::uint64_t magnitude(std::int64_t value) {
+    return value < 0 ? ~static_cast<std::uint64_t>(value) + 1
+                     : static_cast<std::uint64_t>(value);
+}
+
+// The shortest decimal representation of double, which is parsed back to
+// the same value, via Grisu2 (F. Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers"), i.e. with integer arithmetic only:
+// it does not depend on the locale, and it does not use the C library.
+namespace grisu {
+
+// the floating point number f * 2^e
+struct diyfp_t {
+    std::uint64_t f;
+    int e;
+
+    diyfp_t operator-(const diyfp_t &other) const {
+        return diyfp_t{f - other.f, e};
+    }
+
+    // the upper 64 bits of the product (rounded)
+    diyfp_t operator*(const diyfp_t &other) const {
+        const std::uint64_t mask = 0xFFFFFFFFu;
+        auto a = f >> 32, b = f & mask;
+        auto c = other.f >> 32, d = other.f & mask;
+        auto ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        auto middle = (bd >> 32) + (ad & mask) + (bc & mask);
+        middle += std::uint64_t{1} << 31;
+        return diyfp_t{ac + (ad >> 32) + (bc >> 32) + (middle >> 32),
+                       e + other.e + 64};
+    }
+
+    diyfp_t normalized() const {
+        auto value = *this;
+        while (!(value.f >> 63)) {
+            value.f <<= 1;
+            --value.e;
+        }
+        return value;
+    }
+};
+
+// the value and its boundaries, i.e. the half-way points to the adjacent
+// doubles; all of them have the same exponent
+struct boundaries_t {
+    diyfp_t w;
+    diyfp_t minus;
+    diyfp_t plus;
+};
+
+// the value is positive and finite
+inline boundaries_t boundaries(double value) {
+    const int bias = 1023 + 52;
+    const std::uint64_t hidden_bit = std::uint64_t{1} << 52;
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto biased_e = static_cast<int>(bits >> 52);
+    auto fraction = bits & (hidden_bit - 1);
+
+    auto v = biased_e ? diyfp_t{fraction + hidden_bit, biased_e - bias}
+                      : diyfp_t{fraction, 1 - bias};
+    // the lower boundary is closer for the powers of 2
+    bool closer = !fraction && biased_e > 1;
+    auto plus = diyfp_t{2 * v.f + 1, v.e - 1}.normalized();
+    auto minus = closer ? diyfp_t{4 * v.f - 1, v.e - 2}
+                        : diyfp_t{2 * v.f - 1, v.e - 1};
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    return boundaries_t{v.normalized(), minus, plus};
+}
+
+// the binary exponent of the scaled value is in [alpha, alpha + 28]
+constexpr int alpha = -60;
+
+// c * 2^e approximates 10^k
+struct cached_power_t {
+    std::uint64_t f;
+    int e;
+    int k;
+};
+
+// the power of ten, which scales the number of binary exponent e into
+// [alpha, gamma]
+inline cached_power_t cached_power(int e) {
+    static const cached_power_t powers[] = {
+        {0xAB70FE17C79AC6CA, -1060, -300},
+        {0xFF77B1FCBEBCDC4F, -1034, -292},
+        {0xBE5691EF416BD60C, -1007, -284},
+        {0x8DD01FAD907FFC3C, -980, -276},
+        {0xD3515C2831559A83, -954, -268},
+        {0x9D71AC8FADA6C9B5, -927, -260},
+        {0xEA9C227723EE8BCB, -901, -252},
+        {0xAECC49914078536D, -874, -244},
+        {0x823C12795DB6CE57, -847, -236},
+        {0xC21094364DFB5637, -821, -228},
+        {0x9096EA6F3848984F, -794, -220},
+        {0xD77485CB25823AC7, -768, -212},
+        {0xA086CFCD97BF97F4, -741, -204},
+        {0xEF340A98172AACE5, -715, -196},
+        {0xB23867FB2A35B28E, -688, -188},
+        {0x84C8D4DFD2C63F3B, -661, -180},
+        {0xC5DD44271AD3CDBA, -635, -172},
+        {0x936B9FCEBB25C996, -608, -164},
+        {0xDBAC6C247D62A584, -582, -156},
+        {0xA3AB66580D5FDAF6, -555, -148},
+        {0xF3E2F893DEC3F126, -529, -140},
+        {0xB5B5ADA8AAFF80B8, -502, -132},
+        {0x87625F056C7C4A8B, -475, -124},
+        {0xC9BCFF6034C13053, -449, -116},
+        {0x964E858C91BA2655, -422, -108},
+        {0xDFF9772470297EBD, -396, -100},
+        {0xA6DFBD9FB8E5B88F, -369, -92},
+        {0xF8A95FCF88747D94, -343, -84},
+        {0xB94470938FA89BCF, -316, -76},
+        {0x8A08F0F8BF0F156B, -289, -68},
+        {0xCDB02555653131B6, -263, -60},
+        {0x993FE2C6D07B7FAC, -236, -52},
+        {0xE45C10C42A2B3B06, -210, -44},
+        {0xAA242499697392D3, -183, -36},
+        {0xFD87B5F28300CA0E, -157, -28},
+        {0xBCE5086492111AEB, -130, -20},
+        {0x8CBCCC096F5088CC, -103, -12},
+        {0xD1B71758E219652C, -77, -4},
+        {0x9C40000000000000, -50, 4},
+        {0xE8D4A51000000000, -24, 12},
+        {0xAD78EBC5AC620000, 3, 20},
+        {0x813F3978F8940984, 30, 28},
+        {0xC097CE7BC90715B3, 56, 36},
+        {0x8F7E32CE7BEA5C70, 83, 44},
+        {0xD5D238A4ABE98068, 109, 52},
+        {0x9F4F2726179A2245, 136, 60},
+        {0xED63A231D4C4FB27, 162, 68},
+        {0xB0DE65388CC8ADA8, 189, 76},
+        {0x83C7088E1AAB65DB, 216, 84},
+        {0xC45D1DF942711D9A, 242, 92},
+        {0x924D692CA61BE758, 269, 100},
+        {0xDA01EE641A708DEA, 295, 108},
+        {0xA26DA3999AEF774A, 322, 116},
+        {0xF209787BB47D6B85, 348, 124},
+        {0xB454E4A179DD1877, 375, 132},
+        {0x865B86925B9BC5C2, 402, 140},
+        {0xC83553C5C8965D3D, 428, 148},
+        {0x952AB45CFA97A0B3, 455, 156},
+        {0xDE469FBD99A05FE3, 481, 164},
+        {0xA59BC234DB398C25, 508, 172},
+        {0xF6C69A72A3989F5C, 534, 180},
+        {0xB7DCBF5354E9BECE, 561, 188},
+        {0x88FCF317F22241E2, 588, 196},
+        {0xCC20CE9BD35C78A5, 614, 204},
+        {0x98165AF37B2153DF, 641, 212},
+        {0xE2A0B5DC971F303A, 667, 220},
+        {0xA8D9D1535CE3B396, 694, 228},
+        {0xFB9B7CD9A4A7443C, 720, 236},
+        {0xBB764C4CA7A44410, 747, 244},
+        {0x8BAB8EEFB6409C1A, 774, 252},
+        {0xD01FEF10A657842C, 800, 260},
+        {0x9B10A4E5E9913129, 827, 268},
+        {0xE7109BFBA19C0C9D, 853, 276},
+        {0xAC2820D9623BF429, 880, 284},
+        {0x80444B5E7AA7CF85, 907, 292},
+        {0xBF21E44003ACDD2D, 933, 300},
+        {0x8E679C2F5E44FF8F, 960, 308},
+        {0xD433179D9C8CB841, 986, 316},
+        {0x9E19DB92B4E31BA9, 1013, 324},
+    };
+    const int min_k = -300;
+    const int step = 8;
+    // ceil((alpha - e - 1) * log10(2))
+    auto f = alpha - e - 1;
+    auto k = (f * 78913) / (1 << 18) + (f > 0);
+    auto idx = (k - min_k + step - 1) / step;
+    return powers[idx];
+}
+
+// the amount of digits and the largest power of ten, which is not greater
+// than n
+inline int largest_pow10(std::uint32_t n, std::uint32_t &pow10) {
+    int digits = 10;
+    pow10 = 1000000000;
+    while (digits > 1 && n < pow10) {
+        pow10 /= 10;
+        --digits;
+    }
+    return digits;
+}
+
+// moves the last digit towards w (i.e. to the closest representation)
+inline void round_last(char *digits, int length, std::uint64_t dist,
+                       std::uint64_t delta, std::uint64_t rest,
+                       std::uint64_t ten_k) {
+    while (rest < dist && delta - rest >= ten_k &&
+           (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        --digits[length - 1];
+        rest += ten_k;
+    }
+}
+
+// generates the shortest digits of the scaled value within (minus, plus),
+// the value is digits * 10^exponent
+inline int generate(char *digits, int &exponent, const diyfp_t &minus,
+                    const diyfp_t &w, const diyfp_t &plus) {
+    auto delta = (plus - minus).f;
+    auto dist = (plus - w).f;
+    const diyfp_t one{std::uint64_t{1} << -plus.e, plus.e};
+
+    auto integral = static_cast<std::uint32_t>(plus.f >> -one.e);
+    auto fractional = plus.f & (one.f - 1);
+
+    int length = 0;
+    std::uint32_t pow10;
+    auto n = largest_pow10(integral, pow10);
+    while (n > 0) {
+        digits[length++] = static_cast<char>('0' + integral / pow10);
+        integral %= pow10;
+        --n;
+        auto rest = (std::uint64_t{integral} << -one.e) + fractional;
+        if (rest <= delta) {
+            exponent += n;
+            round_last(digits, length, dist, delta, rest,
+                       std::uint64_t{pow10} << -one.e);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    do {
+        fractional *= 10;
+        digits[length++] = static_cast<char>('0' + (fractional >> -one.e));
+        fractional &= one.f - 1;
+        ++m;
+        delta *= 10;
+        dist *= 10;
+    } while (fractional > delta);
+    exponent -= m;
+    round_last(digits, length, dist, delta, fractional, one.f);
+    return length;
+}
+
+// the digits (up to 17) of the positive finite value, which is
+// digits * 10^exponent
+inline int shortest(char *digits, int &exponent, double value) {
+    auto b = boundaries(value);
+    auto cached = cached_power(b.plus.e);
+    const diyfp_t c{cached.f, cached.e};
+    auto w = b.w * c;
+    auto minus = b.minus * c;
+    auto plus = b.plus * c;
+    // the boundaries are inexact after the scaling, so they are narrowed
+    minus.f += 1;
+    plus.f -= 1;
+    exponent = -cached.k;
+    return generate(digits, exponent, minus, w, plus);
+}
+
+// writes the exponent with the sign and at least 2 digits (as printf)
+inline char *write_exponent(char *out, int exponent) {
+    *out++ = exponent < 0 ? '-' : '+';
+    auto value = static_cast<unsigned>(exponent < 0 ? -exponent : exponent);
+    if (value >= 100) {
+        *out++ = static_cast<char>('0' + value / 100);
+        value %= 100;
+    }
+    *out++ = static_cast<char>('0' + value / 10);
+    *out++ = static_cast<char>('0' + value % 10);
+    return out;
+}
+
+} // namespace grisu
+
+// the longest formatted double, e.g. "-1.2345678901234567e-308"
+constexpr std::size_t double_max_length = 24;
+
+// Formats the double into the buffer of at least double_max_length bytes,
+// returns the length. The digits, which are parsed back to the same value
+// (and which are the shortest ones in the most cases), are written in the
+// notation of printf("%.17g"), e.g. "0.1" rather than "0.10000000000000001",
+// "1e+300"; inf and nan are formatted as "inf", "-inf", "nan".
+inline std::size_t format_double(char *buff, double value) {
+    if (std::isnan(value)) {
+        std::memcpy(buff, "nan", 3);
+        return 3;
+    }
+    auto out = buff;
+    if (std::signbit(value)) {
+        *out++ = '-';
+        value = -value;
+    }
+    if (std::isinf(value)) {
+        std::memcpy(out, "inf", 3);
+        return static_cast<std::size_t>(out + 3 - buff);
+    } else if (value == 0) {
+        *out++ = '0';
+        return static_cast<std::size_t>(out - buff);
+    }
+
+    char digits[17];
+    int exponent;
+    auto length = grisu::shortest(digits, exponent, value);
+    // the position of the decimal point relative to the digits
+    auto point = length + exponent;
+    if (point < -3 || point > 17) {
+        *out++ = digits[0];
+        if (length > 1) {
+            *out++ = '.';
+            out = std::copy(digits + 1, digits + length, out);
+        }
+        *out++ = 'e';
+        out = grisu::write_exponent(out, point - 1);
+    } else if (point >= length) {
+        out = std::copy(digits, digits + length, out);
+        out = std::fill_n(out, point - length, '0');
+    } else if (point > 0) {
+        out = std::copy(digits, digits + point, out);
+        *out++ = '.';
+        out = std::copy(digits + point, digits + length, out);
+    } else {
+        *out++ = '0';
+        *out++ = '.';
+        out = std::fill_n(out, -point, '0');
+        out = std::copy(digits, digits + length, out);
+    }
+    return static_cast<std::size_t>(out - buff);
+}
+
+} // namespace details
+
+} // namespace bredis
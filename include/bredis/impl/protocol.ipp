@@ -10,9 +10,45 @@
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/variant.hpp>
-#include <errno.h>
-#include <stdlib.h>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <vector>
+
+#include "numbers.ipp"
+#include "search.ipp"
+
+// The maximum nesting of aggregates (arrays, maps etc.) in a reply; the
+// deeper replies are rejected with bredis_errors::nesting_depth.
+#ifndef BREDIS_MAX_DEPTH
+#define BREDIS_MAX_DEPTH 512
+#endif
+
+// The maximum size of a bulk string in a reply (the same as the default
+// proto-max-bulk-len of redis); the longer ones are rejected with
+// bredis_errors::count_range.
+#ifndef BREDIS_MAX_BULK_SIZE
+#define BREDIS_MAX_BULK_SIZE (512 * 1024 * 1024)
+#endif
+
+// The maximum amount of elements of an aggregate in a reply (the keys and
+// the values of a map are counted separately); the bigger ones are rejected
+// with bredis_errors::count_range.
+#ifndef BREDIS_MAX_AGGREGATE_SIZE
+#define BREDIS_MAX_AGGREGATE_SIZE (512 * 1024 * 1024)
+#endif
+
+// The maximum amount of elements reserved for an aggregate up front, i.e.
+// the memory is not allocated for the elements, which have not arrived.
+#ifndef BREDIS_MAX_RESERVE
+#define BREDIS_MAX_RESERVE 1024
+#endif
+
+// The maximum amount of bytes requested from the stream at once, i.e. the
+// pending bulk string is read by such portions.
+#ifndef BREDIS_MAX_READ_SIZE
+#define BREDIS_MAX_READ_SIZE (1024 * 1024)
+#endif
 
 namespace bredis {
 
@@ -42,6 +78,21 @@ struct static_string_t {
         }
     }
 
+    // contiguous memory: the candidates are located via vectorized scan
+    const char *search(const char *first, const char *last) const {
+        auto tail_size = static_cast<std::ptrdiff_t>(size);
+        while (true) {
+            first = details::find_char(first, last, *begin);
+            if (last - first < tail_size) {
+                return last;
+            }
+            if (std::memcmp(first + 1, begin + 1, size - 1) == 0) {
+                return first;
+            }
+            ++first;
+        }
+    }
+
     template <typename Iterator>
     bool equal(Iterator first, Iterator last) const {
         auto *start = begin;
@@ -66,20 +117,110 @@ constexpr static_string_t terminator{"\r\n", 2};
 
 namespace details {
 
-// forward declaration
-template <typename Iterator, typename Policy>
-parse_result_t<Iterator, Policy> raw_parse(const Iterator &from,
-                                           const Iterator &to);
-
 struct count_value_t {
     size_t value;
     size_t consumed;
 };
 
+// converts count string (i.e. the size of a bulk string or of an array)
+// into number; returns false if the conversion failed
+template <typename Iterator>
+bool convert_count(const Iterator &from, const Iterator &to,
+                   std::int64_t &count) {
+    return parse_integer(from, to, count);
+}
+
 template <typename Iterator, typename Policy>
 using count_variant_t =
     boost::variant<count_value_t, parse_result_t<Iterator, Policy>>;
 
+// Creates the marker of the given type from its string; the string might
+// be validated beforehand
+template <template <typename> class Marker> struct marker_factory_t {
+    template <typename Iterator>
+    static bool valid(const Iterator & /*from*/, const Iterator & /*to*/) {
+        return true;
+    }
+
+    template <typename Iterator>
+    static markers::redis_result_t<Iterator> make(const Iterator &from,
+                                                  const Iterator &to) {
+        return Marker<Iterator>{markers::string_t<Iterator>{from, to}};
+    }
+};
+
+template <> struct marker_factory_t<markers::string_t> {
+    template <typename Iterator>
+    static bool valid(const Iterator & /*from*/, const Iterator & /*to*/) {
+        return true;
+    }
+
+    template <typename Iterator>
+    static markers::redis_result_t<Iterator> make(const Iterator &from,
+                                                  const Iterator &to) {
+        return markers::string_t<Iterator>{from, to};
+    }
+};
+
+template <> struct marker_factory_t<markers::bool_t> {
+    template <typename Iterator>
+    static bool valid(const Iterator &from, const Iterator &to) {
+        return std::distance(from, to) == 1 && (*from == 't' || *from == 'f');
+    }
+
+    template <typename Iterator>
+    static markers::redis_result_t<Iterator> make(const Iterator &from,
+                                                  const Iterator &to) {
+        return markers::bool_t<Iterator>{markers::string_t<Iterator>{from, to}};
+    }
+};
+
+// the payload is prefixed by the format, i.e. "txt:"
+template <> struct marker_factory_t<markers::verbatim_t> {
+    template <typename Iterator>
+    static bool valid(const Iterator &from, const Iterator &to) {
+        return std::distance(from, to) >= 4 && *(from + 3) == ':';
+    }
+
+    template <typename Iterator>
+    static markers::redis_result_t<Iterator> make(const Iterator &from,
+                                                  const Iterator &to) {
+        using string_t = markers::string_t<Iterator>;
+        return markers::verbatim_t<Iterator>{string_t{from, from + 3},
+                                             string_t{from + 4, to}};
+    }
+};
+
+inline bool is_aggregate(char introduction) {
+    switch (introduction) {
+    case '*':
+    case '%':
+    case '~':
+    case '>':
+    case '|':
+        return true;
+    }
+    return false;
+}
+
+// the amount of elements for the declared aggregate count; false, if it
+// exceeds BREDIS_MAX_AGGREGATE_SIZE
+inline bool aggregate_elements(char introduction, size_t declared,
+                               size_t &elements) {
+    switch (introduction) {
+    case '%':
+    case '|':
+        if (declared > (SIZE_MAX - 1) / 2) {
+            return false;
+        }
+        elements = declared * 2 + (introduction == '|');
+        break;
+    default:
+        elements = declared;
+    }
+    return elements <= static_cast<size_t>(BREDIS_MAX_AGGREGATE_SIZE);
+}
+
 template <typename Iterator, typename Policy> struct markup_helper_t {
     using result_wrapper_t = parse_result_t<Iterator, Policy>;
     using positive_wrapper_t = parse_result_mapper_t<Iterator, Policy>;
@@ -98,19 +239,11 @@ template <typename Iterator, typename Policy> struct markup_helper_t {
             result_t{markers::nil_t<Iterator>{str}}, consumed}};
     }
 
-    static auto markup_error(positive_wrapper_t &wrapped_string)
-        -> result_wrapper_t {
-        auto &str = boost::get<string_t>(wrapped_string.result);
-        return result_wrapper_t{
-            positive_wrapper_t{result_t{markers::error_t<Iterator>{str}},
-                               wrapped_string.consumed}};
-    }
-
-    static auto markup_int(positive_wrapper_t &wrapped_string)
-        -> result_wrapper_t {
-        auto &str = boost::get<string_t>(wrapped_string.result);
+    template <template <typename> class Marker>
+    static auto markup(size_t consumed, const Iterator &from,
+                       const Iterator &to) -> result_wrapper_t {
         return result_wrapper_t{positive_wrapper_t{
-            result_t{markers::int_t<Iterator>{str}}, wrapped_string.consumed}};
+            marker_factory_t<Marker>::make(from, to), consumed}};
     }
 };
 
@@ -132,54 +265,73 @@ struct markup_helper_t<Iterator, parsing_policy::drop_result> {
         return result_wrapper_t{positive_wrapper_t{consumed}};
     }
 
-    static auto markup_error(positive_wrapper_t &wrapped_string)
-        -> result_wrapper_t {
-        return result_wrapper_t{positive_wrapper_t{wrapped_string.consumed}};
-    }
-
-    static auto markup_int(positive_wrapper_t &wrapped_string)
-        -> result_wrapper_t {
-        return result_wrapper_t{positive_wrapper_t{wrapped_string.consumed}};
+    template <template <typename> class Marker>
+    static auto markup(size_t consumed, const Iterator & /*from*/,
+                       const Iterator & /*to*/) -> result_wrapper_t {
+        return result_wrapper_t{positive_wrapper_t{consumed}};
     }
 };
 
-template <typename Iterator, typename Policy> struct array_helper_t {
-    using policy_t = Policy;
-    using array_t = markers::array_holder_t<Iterator>;
-    using item_t = parse_result_mapper_t<Iterator, policy_t>;
-    using result_t = parse_result_t<Iterator, policy_t>;
+// the aggregate, which elements are being parsed by raw_parse
+template <typename Iterator, typename Policy> struct aggregate_frame_t {
+    using item_t = parse_result_mapper_t<Iterator, Policy>;
+    using result_t = markers::redis_result_t<Iterator>;
+    using elements_t =
+        typename markers::array_holder_t<Iterator>::recursive_array_t;
 
-    size_t consumed_;
-    size_t count_;
-    array_t array_;
+    char introduction;
+    size_t left;
+    size_t consumed;
+    elements_t elements;
 
-    array_helper_t(size_t consumed, size_t count)
-        : consumed_{consumed}, count_{count} {
-        array_.elements.reserve(count);
+    aggregate_frame_t(char introduction_, size_t count, size_t consumed_)
+        : introduction{introduction_}, left{count}, consumed{consumed_} {
+        elements.reserve(
+            std::min(count, static_cast<size_t>(BREDIS_MAX_RESERVE)));
     }
 
-    void push(const item_t &item) {
-        consumed_ += item.consumed;
-        array_.elements.emplace_back(item.result);
+    void push(item_t &&item) {
+        consumed += item.consumed;
+        elements.emplace_back(std::move(item.result));
+        --left;
     }
 
-    result_t get() { return result_t{item_t{std::move(array_), consumed_}}; }
+    item_t get() {
+        switch (introduction) {
+        case '%':
+            return wrap<markers::map_holder_t<Iterator>>();
+        case '~':
+            return wrap<markers::set_holder_t<Iterator>>();
+        case '>':
+            return wrap<markers::push_holder_t<Iterator>>();
+        case '|':
+            return wrap<markers::attribute_holder_t<Iterator>>();
+        }
+        return wrap<markers::array_holder_t<Iterator>>();
+    }
+
+  private:
+    template <typename Holder> item_t wrap() {
+        return item_t{result_t{Holder{std::move(elements)}}, consumed};
+    }
 };
 
 template <typename Iterator>
-struct array_helper_t<Iterator, parsing_policy::drop_result> {
-    using policy_t = parsing_policy::drop_result;
-    using array_t = markers::array_holder_t<Iterator>;
-    using item_t = parse_result_mapper_t<Iterator, policy_t>;
-    using result_t = parse_result_t<Iterator, policy_t>;
+struct aggregate_frame_t<Iterator, parsing_policy::drop_result> {
+    using item_t = parse_result_mapper_t<Iterator, parsing_policy::drop_result>;
 
-    size_t consumed_;
+    size_t left;
+    size_t consumed;
 
-    array_helper_t(size_t consumed, size_t /*count*/) : consumed_{consumed} {}
+    aggregate_frame_t(char /*introduction*/, size_t count, size_t consumed_)
+        : left{count}, consumed{consumed_} {}
 
-    void push(const item_t &item) { consumed_ += item.consumed; }
+    void push(item_t &&item) {
+        consumed += item.consumed;
+        --left;
+    }
 
-    result_t get() { return result_t{item_t{consumed_}}; }
+    item_t get() { return item_t{consumed}; }
 };
 
 template <typename Iterator, typename Policy>
@@ -199,14 +351,10 @@ struct unwrap_count_t
         using helper = markup_helper_t<Iterator, Policy>;
 
         auto &count_string_ref = boost::get<string_t>(value.result);
-        std::string count_string{count_string_ref.from, count_string_ref.to};
         auto count_consumed = value.consumed;
-        const char *count_ptr = count_string.c_str();
-        char *count_end;
 
-        errno = 0;
-        long count = strtol(count_ptr, &count_end, 10);
-        if (errno) {
+        std::int64_t count;
+        if (!convert_count(count_string_ref.from, count_string_ref.to, count)) {
             return wrapped_result_t{protocol_error_t{
                 Error::make_error_code(bredis_errors::count_conversion)}};
         } else if (count == -1) {
@@ -240,41 +388,43 @@ template <typename Iterator, typename Policy> struct string_parser_t {
     }
 };
 
-template <typename Iterator, typename Policy> struct error_parser_t {
+// the single-line types besides the simple string, i.e. error, int etc.
+template <typename Iterator, typename Policy,
+          template <typename> class Marker>
+struct typed_string_parser_t {
     static auto apply(const Iterator &from, const Iterator &to,
                       size_t already_consumed)
         -> parse_result_t<Iterator, Policy> {
         using helper = markup_helper_t<Iterator, Policy>;
-        using parser_t = string_parser_t<Iterator, Policy>;
-        using wrapped_result_t = parse_result_mapper_t<Iterator, Policy>;
+        using factory_t = marker_factory_t<Marker>;
+
+        auto found_terminator = terminator.search(from, to);
 
-        auto result = parser_t::apply(from, to, already_consumed);
-        auto *wrapped_string = boost::get<wrapped_result_t>(&result);
-        if (!wrapped_string) {
-            return result;
+        if (found_terminator == to) {
+            return not_enough_data_t{};
         }
-        return helper::markup_error(*wrapped_string);
+        if (!factory_t::valid(from, found_terminator)) {
+            return protocol_error_t{
+                Error::make_error_code(bredis_errors::parser_error)};
+        }
+
+        size_t consumed = already_consumed + terminator.size +
+                          std::distance(from, found_terminator);
+        return helper::template markup<Marker>(consumed, from,
+                                               found_terminator);
     }
 };
 
-template <typename Iterator, typename Policy> struct int_parser_t {
-    static auto apply(const Iterator &from, const Iterator &to,
-                      size_t already_consumed)
-        -> parse_result_t<Iterator, Policy> {
-        using helper = markup_helper_t<Iterator, Policy>;
-        using parser_t = string_parser_t<Iterator, Policy>;
-        using wrapped_result_t = parse_result_mapper_t<Iterator, Policy>;
+template <typename Iterator, typename Policy>
+using error_parser_t =
+    typed_string_parser_t<Iterator, Policy, markers::error_t>;
 
-        auto result = parser_t::apply(from, to, already_consumed);
-        auto *wrapped_string = boost::get<wrapped_result_t>(&result);
-        if (!wrapped_string) {
-            return result;
-        }
-        return helper::markup_int(*wrapped_string);
-    }
-};
+template <typename Iterator, typename Policy>
+using int_parser_t = typed_string_parser_t<Iterator, Policy, markers::int_t>;
 
-template <typename Iterator, typename Policy> struct bulk_string_parser_t {
+template <typename Iterator, typename Policy,
+          template <typename> class Marker = markers::string_t>
+struct bulk_string_parser_t {
     static auto apply(const Iterator &from, const Iterator &to,
                       size_t already_consumed)
         -> parse_result_t<Iterator, Policy> {
@@ -296,6 +446,10 @@ template <typename Iterator, typename Policy> struct bulk_string_parser_t {
         auto head = from + (count_wrapped->consumed - already_consumed);
         size_t left = std::distance(head, to);
         size_t count = count_wrapped->value;
+        if (count > static_cast<size_t>(BREDIS_MAX_BULK_SIZE)) {
+            return protocol_error_t{
+                Error::make_error_code(bredis_errors::count_range)};
+        }
         auto terminator_size = terminator.size;
         if (left < count + terminator_size) {
             return not_enough_data_t{};
@@ -308,48 +462,13 @@ template <typename Iterator, typename Policy> struct bulk_string_parser_t {
             return protocol_error_t{
                 Error::make_error_code(bredis_errors::bulk_terminator)};
         }
-        size_t consumed = count_wrapped->consumed + count + terminator_size;
-
-        return helper::markup_string(consumed, head, tail);
-    }
-};
-
-template <typename Iterator, typename Policy> struct array_parser_t {
-    static auto apply(const Iterator &from, const Iterator &to,
-                      size_t already_consumed)
-        -> parse_result_t<Iterator, Policy> {
-
-        using count_unwrapper_t = unwrap_count_t<Iterator, Policy>;
-        using result_t = parse_result_t<Iterator, Policy>;
-        using keep_policy = parsing_policy::keep_result;
-        using count_parser_t = string_parser_t<Iterator, keep_policy>;
-        using array_helper = array_helper_t<Iterator, Policy>;
-        using element_t = parse_result_mapper_t<Iterator, Policy>;
-
-        auto count_result = count_parser_t::apply(from, to, already_consumed);
-        auto count_int_result =
-            boost::apply_visitor(count_unwrapper_t{}, count_result);
-        auto *count_wrapped = boost::get<count_value_t>(&count_int_result);
-        if (!count_wrapped) {
-            return boost::get<result_t>(count_int_result);
+        if (!marker_factory_t<Marker>::valid(head, tail)) {
+            return protocol_error_t{
+                Error::make_error_code(bredis_errors::parser_error)};
         }
+        size_t consumed = count_wrapped->consumed + count + terminator_size;
 
-        auto count = count_wrapped->value;
-        array_helper elements{count_wrapped->consumed, count};
-        size_t marked_elements{0};
-        Iterator element_from =
-            from + (count_wrapped->consumed - already_consumed);
-        while (marked_elements < count) {
-            auto element_result = raw_parse<Iterator, Policy>(element_from, to);
-            auto *element = boost::get<element_t>(&element_result);
-            if (!element) {
-                return element_result;
-            }
-            element_from += element->consumed;
-            elements.push(*element);
-            ++marked_elements;
-        }
-        return elements.get();
+        return helper::template markup<Marker>(consumed, head, tail);
     }
 };
 
@@ -357,7 +476,14 @@ template <typename Iterator, typename Policy>
 using primary_parser_t = boost::variant<
     not_enough_data_t, protocol_error_t, string_parser_t<Iterator, Policy>,
     int_parser_t<Iterator, Policy>, error_parser_t<Iterator, Policy>,
-    bulk_string_parser_t<Iterator, Policy>, array_parser_t<Iterator, Policy>>;
+    bulk_string_parser_t<Iterator, Policy>,
+    // RESP3
+    typed_string_parser_t<Iterator, Policy, markers::double_t>,
+    typed_string_parser_t<Iterator, Policy, markers::bool_t>,
+    typed_string_parser_t<Iterator, Policy, markers::big_number_t>,
+    typed_string_parser_t<Iterator, Policy, markers::nil_t>,
+    bulk_string_parser_t<Iterator, Policy, markers::error_t>,
+    bulk_string_parser_t<Iterator, Policy, markers::verbatim_t>>;
 
 template <typename Iterator, typename Policy>
 struct unwrap_primary_parser_t
@@ -407,31 +533,210 @@ struct construct_primary_parcer_t {
         case '$': {
             return bulk_string_parser_t<Iterator, Policy>{};
         }
-        case '*': {
-            return array_parser_t<Iterator, Policy>{};
+        // RESP3
+        case ',': {
+            return typed_string_parser_t<Iterator, Policy, markers::double_t>{};
+        }
+        case '#': {
+            return typed_string_parser_t<Iterator, Policy, markers::bool_t>{};
+        }
+        case '(': {
+            return typed_string_parser_t<Iterator, Policy,
+                                         markers::big_number_t>{};
         }
+        case '_': {
+            return typed_string_parser_t<Iterator, Policy, markers::nil_t>{};
         }
-        // wrong introduction;
+        case '!': {
+            return bulk_string_parser_t<Iterator, Policy, markers::error_t>{};
+        }
+        case '=': {
+            return bulk_string_parser_t<Iterator, Policy,
+                                        markers::verbatim_t>{};
+        }
+        }
+        // wrong introduction; aggregates are handled by raw_parse
         return protocol_error_t{
             Error::make_error_code(bredis_errors::wrong_intoduction)};
     }
 };
 
+// Parses the reply without recursion: the open aggregates are kept in the
+// explicit stack, and the completed element is folded into its parent.
 template <typename Iterator, typename Policy>
 parse_result_t<Iterator, Policy> raw_parse(const Iterator &from,
                                            const Iterator &to) {
-    auto primary =
-        construct_primary_parcer_t<Iterator, Policy>::apply(from, to);
-    return boost::apply_visitor(
-        unwrap_primary_parser_t<Iterator, Policy>(from, to), primary);
+    using result_t = parse_result_t<Iterator, Policy>;
+    using item_t = parse_result_mapper_t<Iterator, Policy>;
+    using frame_t = aggregate_frame_t<Iterator, Policy>;
+    using count_unwrapper_t = unwrap_count_t<Iterator, Policy>;
+    using keep_policy = parsing_policy::keep_result;
+    using count_parser_t = string_parser_t<Iterator, keep_policy>;
+
+    std::vector<frame_t> stack;
+    Iterator element_from = from;
+    while (true) {
+        result_t element_result{not_enough_data_t{}};
+        if (element_from != to && is_aggregate(*element_from)) {
+            auto count_result = count_parser_t::apply(element_from + 1, to, 1);
+            auto count_int_result =
+                boost::apply_visitor(count_unwrapper_t{}, count_result);
+            auto *count_wrapped = boost::get<count_value_t>(&count_int_result);
+            if (!count_wrapped) {
+                // nil or error
+                element_result = boost::get<result_t>(count_int_result);
+            } else if (stack.size() >= BREDIS_MAX_DEPTH) {
+                return protocol_error_t{
+                    Error::make_error_code(bredis_errors::nesting_depth)};
+            } else {
+                char introduction = *element_from;
+                size_t count;
+                if (!aggregate_elements(introduction, count_wrapped->value,
+                                        count)) {
+                    return protocol_error_t{
+                        Error::make_error_code(bredis_errors::count_range)};
+                }
+                stack.emplace_back(introduction, count,
+                                   count_wrapped->consumed);
+                if (count) {
+                    element_from += count_wrapped->consumed;
+                    continue;
+                }
+                element_result = result_t{stack.back().get()};
+                stack.pop_back();
+            }
+        } else {
+            auto primary = construct_primary_parcer_t<Iterator, Policy>::apply(
+                element_from, to);
+            element_result = boost::apply_visitor(
+                unwrap_primary_parser_t<Iterator, Policy>(element_from, to),
+                primary);
+        }
+
+        auto *element = boost::get<item_t>(&element_result);
+        if (!element || stack.empty()) {
+            return element_result;
+        }
+        element_from += element->consumed;
+        item_t item{std::move(*element)};
+        while (true) {
+            auto &frame = stack.back();
+            frame.push(std::move(item));
+            if (frame.left) {
+                break;
+            }
+            item = frame.get();
+            stack.pop_back();
+            if (stack.empty()) {
+                return result_t{std::move(item)};
+            }
+        }
+    }
+}
+
+template <typename Iterator, typename Policy>
+parse_result_t<Iterator, Policy>
+parse_reply(const Iterator &from, const Iterator &to, Policy,
+            memory_resource_t * /*resource*/) {
+    return raw_parse<Iterator, Policy>(from, to);
+}
+
+// the reply is just validated by incremental_parser_t, see tape.ipp
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::drop_result>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::drop_result, memory_resource_t *resource);
+
+// the tape is recorded by incremental_parser_t, see tape.ipp
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::keep_result>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::keep_result, memory_resource_t *resource);
+
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::keep_tape>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::keep_tape, memory_resource_t *resource);
+
+template <typename Iterator, typename T>
+parse_result_t<Iterator, parsing_policy::decode_to<T>>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::decode_to<T>, memory_resource_t *resource);
+
+// writes the header line (e.g. "$5\r\n"), returns the end of it
+inline char *write_header(char *out, char introduction, std::size_t value) {
+    *out++ = introduction;
+    auto end = write_decimal(out, value);
+    end[0] = '\r';
+    end[1] = '\n';
+    return end + terminator.size;
+}
+
+// the size of the argument as bulk string, i.e. with the header; the
+// numbers are already formatted, see command_arg_t
+inline std::size_t bulk_size(const command_arg_t &arg) {
+    auto size = arg.string().size();
+    return 1 + decimal_length(size) + size + terminator.size * 2;
+}
+
+// writes the argument as bulk string, returns the end of it
+inline char *write_bulk(char *out, const command_arg_t &arg) {
+    auto str = arg.string();
+    out = write_header(out, '$', str.size());
+    out = std::copy(str.begin(), str.end(), out);
+    *out++ = '\r';
+    *out++ = '\n';
+    return out;
+}
+
+// the exact size of the serialized command with the arguments (i.e. with
+// the range of command_arg_t)
+template <typename Arguments>
+std::size_t serialized_size(const Arguments &arguments) {
+    auto size = 1 + decimal_length(arguments.size()) + terminator.size;
+    for (const auto &arg : arguments) {
+        size += bulk_size(arg);
+    }
+    return size;
+}
+
+template <typename Arguments>
+char *serialize(char *out, const Arguments &arguments) {
+    out = write_header(out, '*', arguments.size());
+    for (const auto &arg : arguments) {
+        out = write_bulk(out, arg);
+    }
+    return out;
+}
+
+// only the variable arguments of the prepared command are serialized
+inline std::size_t serialized_size(const bound_command_t &cmd) {
+    auto &prepared = cmd.prepared();
+    auto size = prepared.fragment(prepared.variables()).size();
+    for (std::size_t i = 0; i < prepared.variables(); ++i) {
+        size += prepared.fragment(i).size() + bulk_size(cmd.variables()[i]);
+    }
+    return size;
+}
+
+inline char *serialize(char *out, const bound_command_t &cmd) {
+    auto &prepared = cmd.prepared();
+    for (std::size_t i = 0; i < prepared.variables(); ++i) {
+        auto fragment = prepared.fragment(i);
+        out = std::copy(fragment.begin(), fragment.end(), out);
+        out = write_bulk(out, cmd.variables()[i]);
+    }
+    auto tail = prepared.fragment(prepared.variables());
+    return std::copy(tail.begin(), tail.end(), out);
 }
 
 } // namespace details
 
 template <typename Iterator, typename Policy>
-parse_result_t<Iterator, Policy> Protocol::parse(const Iterator &from,
-                                                 const Iterator &to) {
-    return details::raw_parse<Iterator, Policy>(from, to);
+parse_result_t<Iterator, Policy>
+Protocol::parse(const Iterator &from, const Iterator &to,
+                memory_resource_t *resource) {
+    return details::parse_reply(from, to, Policy{}, resource);
 }
 
 std::ostream &Protocol::serialize(std::ostream &buff,
@@ -439,9 +744,18 @@ std::ostream &Protocol::serialize(std::ostream &buff,
     buff << '*' << (cmd.arguments.size()) << terminator;
 
     for (const auto &arg : cmd.arguments) {
-        buff << '$' << arg.size() << terminator << arg << terminator;
+        buff << '$' << arg.string().size() << terminator << arg.string()
+             << terminator;
     }
     return buff;
 }
 
+std::size_t Protocol::serialized_size(const single_command_t &cmd) {
+    return details::serialized_size(cmd.arguments);
+}
+
+char *Protocol::serialize(char *out, const single_command_t &cmd) {
+    return details::serialize(out, cmd.arguments);
+}
+
 } // namespace bredis
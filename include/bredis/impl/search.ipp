@@ -0,0 +1,90 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <cstring>
+
+// The instruction set is selected at compile time, i.e. AVX2 is used only
+// when the code is compiled for it (e.g. -mavx2 or /arch:AVX2); SSE2 is
+// always available on x86-64. Define BREDIS_NO_SIMD to use memchr instead.
+#if !defined(BREDIS_NO_SIMD)
+#if defined(__AVX2__)
+#define BREDIS_SIMD_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BREDIS_SIMD_SSE2
+#endif
+#endif
+
+#if defined(BREDIS_SIMD_AVX2) || defined(BREDIS_SIMD_SSE2)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace bredis {
+
+namespace details {
+
+#if defined(BREDIS_SIMD_AVX2) || defined(BREDIS_SIMD_SSE2)
+inline unsigned count_trailing_zeros(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return static_cast<unsigned>(idx);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// Returns the pointer to the first occurrence of c in [first, last) or last.
+//
+// Redis lines are usually short, so the first bytes are checked inline via
+// SIMD, avoiding the call overhead; the long tail is passed to memchr, which
+// is runtime-dispatched by libc to the best instruction set of the CPU.
+inline const char *find_char(const char *first, const char *last, char c) {
+    constexpr std::ptrdiff_t inline_scan = 64;
+    const char *inline_last =
+        last - first > inline_scan ? first + inline_scan : last;
+#if defined(BREDIS_SIMD_AVX2)
+    const __m256i pattern32 = _mm256_set1_epi8(c);
+    for (; inline_last - first >= 32; first += 32) {
+        auto chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+        auto mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern32)));
+        if (mask) {
+            return first + count_trailing_zeros(mask);
+        }
+    }
+#endif
+#if defined(BREDIS_SIMD_SSE2)
+    const __m128i pattern16 = _mm_set1_epi8(c);
+    for (; inline_last - first >= 16; first += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern16)));
+        if (mask) {
+            return first + count_trailing_zeros(mask);
+        }
+    }
+#endif
+    if (first == last) {
+        return last;
+    }
+    auto found = static_cast<const char *>(
+        std::memchr(first, c, static_cast<std::size_t>(last - first)));
+    return found ? found : last;
+}
+
+} // namespace details
+
+} // namespace bredis
@@ -0,0 +1,292 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include "../Protocol.hpp"
+#include "../Result.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+namespace bredis {
+
+// The streaming read state: the bulk string header is parsed, and then
+// the payload is passed to the sink (and consumed from rx_buff) as it
+// arrives, by chunks of at most chunk_size bytes. The amount of requested
+// bytes never exceeds the chunk size, i.e. rx_buff does not grow beyond it.
+//
+// Any other reply (including nil) is not consumed at all, so it can be
+// read via the regular async_read.
+template <typename DynamicBuffer, typename Sink> class stream_read_op_impl {
+    using Iterator = typename to_iterator<DynamicBuffer>::iterator_t;
+    enum class stage_t { header, payload, terminator, done };
+
+    Sink sink_;
+    std::size_t chunk_size_;
+    stage_t stage_;
+    // payload bytes left
+    std::size_t left_;
+    stream_result_t result_;
+    boost::system::error_code error_code_;
+
+  public:
+    stream_read_op_impl(Sink sink, std::size_t chunk_size)
+        : sink_(std::move(sink)), chunk_size_{std::max<std::size_t>(
+                                      chunk_size, 1)},
+          stage_{stage_t::header}, left_{0}, result_{false, 0} {}
+
+    bool done() const { return error_code_ || stage_ == stage_t::done; }
+
+    const boost::system::error_code &error() const { return error_code_; }
+
+    const stream_result_t &result() const { return result_; }
+
+    // processes the newly arrived data, returns true if the read is done
+    bool feed(DynamicBuffer &rx_buff) {
+        while (!done()) {
+            bool progress = false;
+            switch (stage_) {
+            case stage_t::header:
+                progress = feed_header(rx_buff);
+                break;
+            case stage_t::payload:
+                progress = feed_payload(rx_buff);
+                break;
+            default:
+                progress = feed_terminator(rx_buff);
+                break;
+            }
+            if (!progress) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the amount of bytes to be requested from the stream
+    std::size_t read_size(const DynamicBuffer &rx_buff) const {
+        std::size_t wanted;
+        switch (stage_) {
+        case stage_t::header:
+            wanted = std::max<std::size_t>(
+                512, rx_buff.capacity() - rx_buff.size());
+            break;
+        case stage_t::payload:
+            wanted = left_ + terminator.size;
+            break;
+        default:
+            wanted = terminator.size - rx_buff.size();
+            break;
+        }
+        return std::min(std::min(wanted, chunk_size_),
+                        rx_buff.max_size() - rx_buff.size());
+    }
+
+  private:
+    bool feed_header(DynamicBuffer &rx_buff) {
+        auto const_buff = rx_buff.data();
+        auto from = Iterator::begin(const_buff);
+        auto to = Iterator::end(const_buff);
+        if (from == to) {
+            return false;
+        }
+        if (*from != '$') {
+            stage_ = stage_t::done;
+            return true;
+        }
+        auto count_from = std::next(from);
+        auto found_terminator = terminator.search(count_from, to);
+        if (found_terminator == to) {
+            return false;
+        }
+
+        std::int64_t count;
+        if (!details::convert_count(count_from, found_terminator, count)) {
+            error_code_ =
+                Error::make_error_code(bredis_errors::count_conversion);
+        } else if (count == -1) {
+            stage_ = stage_t::done;
+        } else if (count < -1) {
+            error_code_ = Error::make_error_code(bredis_errors::count_range);
+        } else {
+            left_ = static_cast<std::size_t>(count);
+            result_ = stream_result_t{true, left_};
+            stage_ = stage_t::payload;
+            rx_buff.consume(std::distance(from, found_terminator) +
+                            terminator.size);
+        }
+        return true;
+    }
+
+    bool feed_payload(DynamicBuffer &rx_buff) {
+        namespace asio = boost::asio;
+
+        std::size_t delivered = 0;
+        auto const_buff = rx_buff.data();
+        auto first = asio::buffer_sequence_begin(const_buff);
+        auto last = asio::buffer_sequence_end(const_buff);
+        for (; first != last && delivered < left_; ++first) {
+            asio::const_buffer segment(*first);
+            auto data = static_cast<const char *>(segment.data());
+            auto size = std::min(segment.size(), left_ - delivered);
+            while (size) {
+                auto chunk = std::min(size, chunk_size_);
+                sink_(data, chunk, error_code_);
+                if (error_code_) {
+                    return true;
+                }
+                data += chunk;
+                size -= chunk;
+                delivered += chunk;
+            }
+        }
+        rx_buff.consume(delivered);
+        left_ -= delivered;
+        if (left_) {
+            return false;
+        }
+        stage_ = stage_t::terminator;
+        return true;
+    }
+
+    bool feed_terminator(DynamicBuffer &rx_buff) {
+        if (rx_buff.size() < terminator.size) {
+            return false;
+        }
+        auto const_buff = rx_buff.data();
+        auto from = Iterator::begin(const_buff);
+        if (!terminator.equal(from, from + terminator.size)) {
+            error_code_ =
+                Error::make_error_code(bredis_errors::bulk_terminator);
+            return true;
+        }
+        rx_buff.consume(terminator.size);
+        stage_ = stage_t::done;
+        return true;
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Sink,
+          typename ReadCallback>
+class stream_read_op {
+    NextLayer &stream_;
+    DynamicBuffer &rx_buff_;
+    stream_read_op_impl<DynamicBuffer, Sink> impl_;
+    ReadCallback callback_;
+
+  public:
+    stream_read_op(stream_read_op &&) = default;
+    stream_read_op(const stream_read_op &) = default;
+
+    template <class DeducedHandler>
+    stream_read_op(DeducedHandler &&deduced_handler, NextLayer &stream,
+                   DynamicBuffer &rx_buff, Sink sink, std::size_t chunk_size)
+        : stream_(stream), rx_buff_(rx_buff),
+          impl_(std::move(sink), chunk_size),
+          callback_(std::forward<ReadCallback>(deduced_handler)) {}
+
+    void operator()(boost::system::error_code, std::size_t bytes_transferred,
+                    bool start = false);
+
+    const ReadCallback &callback() const { return callback_; }
+
+    friend bool asio_handler_is_continuation(stream_read_op *op) {
+        using boost::asio::asio_handler_is_continuation;
+        return asio_handler_is_continuation(std::addressof(op->callback_));
+    }
+
+    friend void *asio_handler_allocate(std::size_t size, stream_read_op *op) {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(size, std::addressof(op->callback_));
+    }
+
+    friend void asio_handler_deallocate(void *p, std::size_t size,
+                                        stream_read_op *op) {
+        using boost::asio::asio_handler_deallocate;
+        return asio_handler_deallocate(p, size, std::addressof(op->callback_));
+    }
+
+    template <class Function>
+    friend void asio_handler_invoke(Function &&f, stream_read_op *op) {
+        using boost::asio::asio_handler_invoke;
+        return asio_handler_invoke(f, std::addressof(op->callback_));
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Sink,
+          typename ReadCallback>
+void stream_read_op<NextLayer, DynamicBuffer, Sink, ReadCallback>::
+operator()(boost::system::error_code error_code,
+           std::size_t bytes_transferred, bool start) {
+    if (!start) {
+        rx_buff_.commit(bytes_transferred);
+    }
+    if (!error_code && !impl_.done()) {
+        if (!impl_.feed(rx_buff_)) {
+            if (rx_buff_.size() == rx_buff_.max_size()) {
+                error_code = boost::asio::error::not_found;
+            } else {
+                stream_.async_read_some(
+                    rx_buff_.prepare(impl_.read_size(rx_buff_)),
+                    std::move(*this));
+                return;
+            }
+        } else if (start) {
+            // the callback must not be invoked from the initiating function
+            stream_.async_read_some(boost::asio::mutable_buffer(),
+                                    std::move(*this));
+            return;
+        }
+    }
+    if (!error_code) {
+        error_code = impl_.error();
+    }
+    callback_(error_code, impl_.result());
+}
+
+} // namespace bredis
+
+namespace boost {
+namespace asio {
+
+template <typename NextLayer, typename DynamicBuffer, typename Sink,
+          typename ReadCallback, typename Executor>
+struct associated_executor<
+    bredis::stream_read_op<NextLayer, DynamicBuffer, Sink, ReadCallback>,
+    Executor> {
+    using type = associated_executor_t<ReadCallback, Executor>;
+
+    static type get(const bredis::stream_read_op<NextLayer, DynamicBuffer,
+                                                 Sink, ReadCallback> &op,
+                    const Executor &executor = Executor()) noexcept {
+        return associated_executor<ReadCallback, Executor>::get(op.callback(),
+                                                                executor);
+    }
+};
+
+template <typename NextLayer, typename DynamicBuffer, typename Sink,
+          typename ReadCallback, typename Allocator>
+struct associated_allocator<
+    bredis::stream_read_op<NextLayer, DynamicBuffer, Sink, ReadCallback>,
+    Allocator> {
+    using type = associated_allocator_t<ReadCallback, Allocator>;
+
+    static type get(const bredis::stream_read_op<NextLayer, DynamicBuffer,
+                                                 Sink, ReadCallback> &op,
+                    const Allocator &allocator = Allocator()) noexcept {
+        return associated_allocator<ReadCallback, Allocator>::get(
+            op.callback(), allocator);
+    }
+};
+
+} // namespace asio
+} // namespace boost
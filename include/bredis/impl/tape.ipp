@@ -0,0 +1,252 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "../Decode.hpp"
+#include "../Markers.hpp"
+#include "../Result.hpp"
+#include "../Tape.hpp"
+#include "incremental_parser.ipp"
+
+namespace bredis {
+
+namespace details {
+
+// incremental_parser_t events handler, which records the markers into tape
+template <typename Iterator> struct tape_builder_t {
+    tape_t &tape_;
+    const Iterator begin_;
+
+    tape_builder_t(tape_t &tape, const Iterator &begin)
+        : tape_{tape}, begin_{begin} {}
+
+    void on_string(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::string, from, to);
+    }
+
+    void on_error(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::error, from, to);
+    }
+
+    void on_int(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::int_, from, to);
+    }
+
+    void on_nil(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::nil, from, to);
+    }
+
+    void on_double(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::double_, from, to);
+    }
+
+    void on_bool(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::bool_, from, to);
+    }
+
+    void on_big_number(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::big_number, from, to);
+    }
+
+    void on_verbatim(const Iterator &from, const Iterator &to) {
+        push(tape_kind_t::verbatim, from, to);
+    }
+
+    void on_aggregate_begin(tape_kind_t kind, std::size_t count) {
+        tape_.open(kind, count);
+    }
+
+    void on_aggregate_end() { tape_.close(); }
+
+  private:
+    void push(tape_kind_t kind, const Iterator &from, const Iterator &to) {
+        tape_.push(kind, static_cast<std::size_t>(std::distance(begin_, from)),
+                   static_cast<std::size_t>(std::distance(from, to)));
+    }
+};
+
+// Converts tape back to markers. As the node offsets do not decrease, the
+// iterator is moved forward only, i.e. a fragmented buffer is walked once.
+template <typename Iterator> class tape_materializer_t {
+    using result_t = markers::redis_result_t<Iterator>;
+    using string_t = markers::string_t<Iterator>;
+
+
+    const tape_t &tape_;
+    std::size_t idx_;
+    Iterator cursor_;
+    std::size_t cursor_offset_;
+
+  public:
+    tape_materializer_t(const tape_t &tape, const Iterator &begin)
+        : tape_{tape}, idx_{0}, cursor_{begin}, cursor_offset_{0} {}
+
+    // the aggregates are allocated from the same memory resource as the tape
+    result_t next() {
+        const auto &node = tape_.nodes[idx_++];
+        switch (node.kind) {
+        case tape_kind_t::array:
+            return aggregate<markers::array_holder_t<Iterator>>(node);
+        case tape_kind_t::map:
+            return aggregate<markers::map_holder_t<Iterator>>(node);
+        case tape_kind_t::set:
+            return aggregate<markers::set_holder_t<Iterator>>(node);
+        case tape_kind_t::push:
+            return aggregate<markers::push_holder_t<Iterator>>(node);
+        case tape_kind_t::attribute:
+            return aggregate<markers::attribute_holder_t<Iterator>>(node);
+        default:
+            break;
+        }
+
+        auto from = seek(node.offset);
+        auto to = seek(node.offset + node.size);
+        string_t str{from, to};
+        switch (node.kind) {
+        case tape_kind_t::error:
+            return result_t{markers::error_t<Iterator>{str}};
+        case tape_kind_t::int_:
+            return result_t{markers::int_t<Iterator>{str}};
+        case tape_kind_t::nil:
+            return result_t{markers::nil_t<Iterator>{str}};
+        case tape_kind_t::double_:
+            return result_t{markers::double_t<Iterator>{str}};
+        case tape_kind_t::bool_:
+            return result_t{markers::bool_t<Iterator>{str}};
+        case tape_kind_t::big_number:
+            return result_t{markers::big_number_t<Iterator>{str}};
+        case tape_kind_t::verbatim:
+            return marker_factory_t<markers::verbatim_t>::make(from, to);
+        default:
+            return result_t{str};
+        }
+    }
+
+  private:
+    template <typename Holder>
+    result_t aggregate(const tape_node_t &node) {
+        using elements_t = typename Holder::recursive_array_t;
+        using allocator_t = typename Holder::allocator_t;
+        Holder holder{elements_t(allocator_t{tape_.resource()})};
+        holder.elements.reserve(node.size);
+        for (std::size_t i = 0; i < node.size; ++i) {
+            holder.elements.emplace_back(next());
+        }
+        return result_t{std::move(holder)};
+    }
+
+    Iterator seek(std::size_t offset) {
+        cursor_ += static_cast<std::ptrdiff_t>(offset - cursor_offset_);
+        cursor_offset_ = offset;
+        return cursor_;
+    }
+};
+
+// records the whole reply into the tape; returns the parse error or
+// not_enough_data_t if the reply is not complete
+template <typename Iterator>
+boost::variant<not_enough_data_t, size_t, protocol_error_t>
+record_tape(const Iterator &from, const Iterator &to, tape_t &tape) {
+    incremental_parser_t parser;
+    tape_builder_t<Iterator> builder(tape, from);
+    auto result = parser.feed(from, to, builder);
+    if (result.error) {
+        return protocol_error_t{result.error};
+    } else if (!result.complete) {
+        return not_enough_data_t{};
+    }
+    return result.consumed;
+}
+
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::drop_result>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::drop_result, memory_resource_t * /*resource*/) {
+    using positive_result_t =
+        parse_result_mapper_t<Iterator, parsing_policy::drop_result>;
+    incremental_parser_t parser;
+    auto result = parser.feed(from, to);
+    if (result.error) {
+        return protocol_error_t{result.error};
+    } else if (!result.complete) {
+        return not_enough_data_t{};
+    }
+    return positive_result_t{result.consumed};
+}
+
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::keep_result>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::keep_result, memory_resource_t *resource) {
+    using positive_result_t =
+        parse_result_mapper_t<Iterator, parsing_policy::keep_result>;
+    if (!resource) {
+        return raw_parse<Iterator, parsing_policy::keep_result>(from, to);
+    }
+
+    tape_t tape{resource};
+    auto recorded = record_tape(from, to, tape);
+    if (auto *error = boost::get<protocol_error_t>(&recorded)) {
+        return *error;
+    } else if (boost::get<not_enough_data_t>(&recorded)) {
+        return not_enough_data_t{};
+    }
+    tape_materializer_t<Iterator> materializer(tape, from);
+    return positive_result_t{materializer.next(), boost::get<size_t>(recorded)};
+}
+
+template <typename Iterator>
+parse_result_t<Iterator, parsing_policy::keep_tape>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::keep_tape, memory_resource_t *resource) {
+    using positive_result_t =
+        parse_result_mapper_t<Iterator, parsing_policy::keep_tape>;
+
+    tape_reply_t<Iterator> reply{tape_t{resource}, from};
+    auto recorded = record_tape(from, to, reply.tape);
+    if (auto *error = boost::get<protocol_error_t>(&recorded)) {
+        return *error;
+    } else if (boost::get<not_enough_data_t>(&recorded)) {
+        return not_enough_data_t{};
+    }
+    return positive_result_t{std::move(reply), boost::get<size_t>(recorded)};
+}
+
+// the reply is decoded from the tape; the mismatch of the reply and T is
+// reported as protocol error, which carries the reply size (i.e. the reply
+// can be skipped)
+template <typename Iterator, typename T>
+parse_result_t<Iterator, parsing_policy::decode_to<T>>
+parse_reply(const Iterator &from, const Iterator &to,
+            parsing_policy::decode_to<T>, memory_resource_t *resource) {
+    using positive_result_t =
+        parse_result_mapper_t<Iterator, parsing_policy::decode_to<T>>;
+
+    tape_t tape{resource};
+    auto recorded = record_tape(from, to, tape);
+    if (auto *error = boost::get<protocol_error_t>(&recorded)) {
+        return *error;
+    } else if (boost::get<not_enough_data_t>(&recorded)) {
+        return not_enough_data_t{};
+    }
+    positive_result_t result{T{}, boost::get<size_t>(recorded)};
+    tape_cursor_t<Iterator> root{tape.nodes.data(), from};
+    if (!decode(root, result.result)) {
+        return protocol_error_t{Error::make_error_code(mismatch_of(root)),
+                                result.consumed};
+    }
+    return result;
+}
+
+} // namespace details
+
+} // namespace bredis
@@ -0,0 +1,192 @@
+//
+//
+// Copyright (c) 2017, 2019 Ivan Baidakou (basiliscos) (the dot dmol at gmail
+// dot com)
+//
+// Distributed under the MIT Software License
+//
+#pragma once
+
+#include "../Command.hpp"
+#include "../Protocol.hpp"
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace bredis {
+
+// The serialized command as the sequence of buffers: the generated headers
+// (and the arguments shorter than copy_threshold) are written into the
+// owned storage, while the longer arguments are referred in place, i.e. the
+// whole command is sent via single writev without copying the payload. The
+// command arguments must outlive the buffers.
+class command_buffers_t {
+    using buffers_t = std::vector<boost::asio::const_buffer>;
+
+    std::vector<char> storage_;
+    buffers_t buffers_;
+    std::size_t size_;
+
+  public:
+    using value_type = boost::asio::const_buffer;
+    using const_iterator = buffers_t::const_iterator;
+
+    // the cheaply copyable ConstBufferSequence, which refers the buffers
+    struct sequence_t {
+        using value_type = boost::asio::const_buffer;
+        using const_iterator = buffers_t::const_iterator;
+
+        const_iterator first;
+        const_iterator last;
+
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+    };
+
+    explicit command_buffers_t(const command_wrapper_t &command,
+                               std::size_t copy_threshold = 4096)
+        : size_{0} {
+        std::size_t stored = 0;
+        for_each_command(command, [&](const auto &arguments) {
+            auto size = details::serialized_size(arguments);
+            size_ += size;
+            stored += size;
+            for (const auto &arg : arguments) {
+                if (in_place(arg, copy_threshold)) {
+                    stored -= arg.string().size();
+                }
+            }
+        });
+        storage_.resize(stored);
+
+        auto chunk = storage_.data();
+        auto out = chunk;
+        for_each_command(command, [&](const auto &arguments) {
+            out = details::write_header(out, '*', arguments.size());
+            for (const auto &arg : arguments) {
+                if (in_place(arg, copy_threshold)) {
+                    auto str = arg.string();
+                    out = details::write_header(out, '$', str.size());
+                    buffers_.emplace_back(chunk, out - chunk);
+                    buffers_.emplace_back(str.data(), str.size());
+                    chunk = out;
+                    *out++ = '\r';
+                    *out++ = '\n';
+                } else {
+                    out = details::write_bulk(out, arg);
+                }
+            }
+        });
+        buffers_.emplace_back(chunk, out - chunk);
+    }
+
+    // the storage is referred by the buffers, so it must not be copied
+    command_buffers_t(const command_buffers_t &) = delete;
+    command_buffers_t(command_buffers_t &&) = default;
+
+    const_iterator begin() const { return buffers_.begin(); }
+    const_iterator end() const { return buffers_.end(); }
+
+    sequence_t sequence() const {
+        return sequence_t{buffers_.begin(), buffers_.end()};
+    }
+
+    // the total size of the serialized command
+    std::size_t size() const { return size_; }
+
+  private:
+    static bool in_place(const command_arg_t &arg,
+                         std::size_t copy_threshold) {
+        return arg.kind() == command_arg_t::kind_t::string &&
+               arg.string().size() >= copy_threshold;
+    }
+};
+
+template <typename NextLayer, typename WriteCallback> class gather_write_op {
+    NextLayer &stream_;
+    std::unique_ptr<command_buffers_t> buffers_;
+    WriteCallback callback_;
+
+  public:
+    gather_write_op(gather_write_op &&) = default;
+
+    template <class DeducedHandler>
+    gather_write_op(DeducedHandler &&deduced_handler, NextLayer &stream,
+                    std::unique_ptr<command_buffers_t> buffers)
+        : stream_(stream), buffers_(std::move(buffers)),
+          callback_(std::forward<WriteCallback>(deduced_handler)) {}
+
+    // the buffers are owned by the operation until its completion
+    void start() {
+        auto sequence = buffers_->sequence();
+        boost::asio::async_write(stream_, sequence, std::move(*this));
+    }
+
+    void operator()(const boost::system::error_code &error_code,
+                    std::size_t bytes_transferred) {
+        buffers_.reset();
+        callback_(error_code, bytes_transferred);
+    }
+
+    const WriteCallback &callback() const { return callback_; }
+
+    friend bool asio_handler_is_continuation(gather_write_op *op) {
+        using boost::asio::asio_handler_is_continuation;
+        return asio_handler_is_continuation(std::addressof(op->callback_));
+    }
+
+    friend void *asio_handler_allocate(std::size_t size,
+                                       gather_write_op *op) {
+        using boost::asio::asio_handler_allocate;
+        return asio_handler_allocate(size, std::addressof(op->callback_));
+    }
+
+    friend void asio_handler_deallocate(void *p, std::size_t size,
+                                        gather_write_op *op) {
+        using boost::asio::asio_handler_deallocate;
+        return asio_handler_deallocate(p, size, std::addressof(op->callback_));
+    }
+
+    template <class Function>
+    friend void asio_handler_invoke(Function &&f, gather_write_op *op) {
+        using boost::asio::asio_handler_invoke;
+        return asio_handler_invoke(f, std::addressof(op->callback_));
+    }
+};
+
+} // namespace bredis
+
+namespace boost {
+namespace asio {
+
+template <typename NextLayer, typename WriteCallback, typename Executor>
+struct associated_executor<bredis::gather_write_op<NextLayer, WriteCallback>,
+                           Executor> {
+    using type = associated_executor_t<WriteCallback, Executor>;
+
+    static type
+    get(const bredis::gather_write_op<NextLayer, WriteCallback> &op,
+        const Executor &executor = Executor()) noexcept {
+        return associated_executor<WriteCallback, Executor>::get(op.callback(),
+                                                                 executor);
+    }
+};
+
+template <typename NextLayer, typename WriteCallback, typename Allocator>
+struct associated_allocator<bredis::gather_write_op<NextLayer, WriteCallback>,
+                            Allocator> {
+    using type = associated_allocator_t<WriteCallback, Allocator>;
+
+    static type
+    get(const bredis::gather_write_op<NextLayer, WriteCallback> &op,
+        const Allocator &allocator = Allocator()) noexcept {
+        return associated_allocator<WriteCallback, Allocator>::get(
+            op.callback(), allocator);
+    }
+};
+
+} // namespace asio
+} // namespace boost
@@ -1,6 +1,10 @@
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "bredis/Connection.hpp"
 #include "bredis/MarkerHelpers.hpp"
 #include "bredis/Protocol.hpp"
 #include "catch.hpp"
@@ -43,7 +47,7 @@ TEST_CASE("non-finished ", "[protocol]") {
 }
 
 TEST_CASE("wrong start marker", "[protocol]") {
-    std::string ok = "!OK";
+    std::string ok = "@OK";
     Buffer buff(ok.c_str(), ok.size());
     auto from = Iterator::begin(buff), to = Iterator::end(buff);
     auto parsed_result = r::Protocol::parse(from, to);
@@ -213,6 +217,20 @@ TEST_CASE("malformed bulk string(4)", "[protocol]") {
     REQUIRE(r->code.message() == "Cannot convert count to number");
 }
 
+TEST_CASE("malformed bulk string(5)", "[protocol]") {
+    using Policy = r::parsing_policy::drop_result;
+    for (std::string bad : {"$\r\nsome\r\n", "$-\r\nsome\r\n",
+                            "$4x\r\nsome\r\n", "$ 4\r\nsome\r\n"}) {
+        Buffer buff(bad.c_str(), bad.size());
+        auto from = Iterator::begin(buff), to = Iterator::end(buff);
+        auto parsed_result = r::Protocol::parse<Iterator, Policy>(from, to);
+        r::protocol_error_t *r =
+            boost::get<r::protocol_error_t>(&parsed_result);
+        REQUIRE(r);
+        REQUIRE(r->code.message() == "Cannot convert count to number");
+    }
+}
+
 TEST_CASE("empty array", "[protocol]") {
     std::string ok = "*0\r\n";
     Buffer buff(ok.c_str(), ok.size());
@@ -449,3 +467,82 @@ TEST_CASE("serialize", "[protocol]") {
     std::string expected("*2\r\n$4\r\nLLEN\r\n$18\r\nfmm.cheap-travles2\r\n");
     REQUIRE(buff.str() == expected);
 }
+
+TEST_CASE("serialize directly into memory", "[protocol]") {
+    std::vector<std::string> values;
+    for (size_t size : {0, 1, 9, 10, 99, 100, 101, 999, 1000, 12345}) {
+        values.emplace_back(size, 'v');
+    }
+    r::single_command_t cmd(values.begin(), values.end());
+    std::stringstream expected;
+    r::Protocol::serialize(expected, cmd);
+
+    auto size = r::Protocol::serialized_size(cmd);
+    REQUIRE(size == expected.str().size());
+    std::string out(size, '\0');
+    REQUIRE(r::Protocol::serialize(&out[0], cmd) == &out[0] + size);
+    REQUIRE(out == expected.str());
+
+    // the whole batch is written into the buffer at once
+    r::command_container_t cmds{cmd, r::single_command_t{"PING"}};
+    boost::asio::streambuf tx_buff;
+    r::serialize_command(tx_buff, r::command_wrapper_t{cmds});
+    std::string written(
+        boost::asio::buffers_begin(tx_buff.data()),
+        boost::asio::buffers_end(tx_buff.data()));
+    REQUIRE(written == expected.str() + "*1\r\n$4\r\nPING\r\n");
+}
+
+TEST_CASE("command batch", "[protocol]") {
+    std::vector<std::string> args{"RPUSH", "list", "a", "b", "c"};
+    r::command_batch_t batch;
+    batch.push("PING");
+    batch.push(args.begin(), args.end());
+    batch.push(r::single_command_t{"GET", "key"});
+    REQUIRE(batch.size() == 3);
+    REQUIRE(batch[1].size() == args.size());
+    REQUIRE(batch[1][4].string() == "c");
+    REQUIRE(batch[2][0].string() == "GET");
+
+    r::command_container_t cmds{r::single_command_t{"PING"},
+                                r::single_command_t{args.begin(), args.end()},
+                                r::single_command_t{"GET", "key"}};
+    boost::asio::streambuf batch_buff, cmds_buff;
+    r::serialize_command(batch_buff, r::command_wrapper_t{batch});
+    r::serialize_command(cmds_buff, r::command_wrapper_t{cmds});
+    auto as_string = [](const boost::asio::streambuf &buff) {
+        return std::string(boost::asio::buffers_begin(buff.data()),
+                           boost::asio::buffers_end(buff.data()));
+    };
+    REQUIRE(as_string(batch_buff) == as_string(cmds_buff));
+
+    // the arguments of the small commands are stored inline
+    r::single_command_t small("SET", "key", "value");
+    REQUIRE(small.arguments.capacity() == BREDIS_INLINE_ARGS);
+    std::vector<std::string> many(BREDIS_INLINE_ARGS + 1, "x");
+    r::single_command_t big(many.begin(), many.end());
+    REQUIRE(big.arguments.size() == many.size());
+}
+
+TEST_CASE("terminator search in contiguous memory", "[protocol]") {
+    using static_string_t = r::static_string_t;
+    static_string_t terminator{"\r\n", 2};
+
+    for (size_t size = 0; size < 100; ++size) {
+        std::string line(size, 'x');
+        // lone CR and LF are not terminators
+        if (size > 10) {
+            line[size / 3] = '\r';
+            line[size / 2] = '\n';
+        }
+        std::string data = line + "\r\n" + "tail\r\n";
+        const char *from = data.c_str();
+        const char *to = from + data.size();
+        REQUIRE(terminator.search(from, to) == from + size);
+        REQUIRE(terminator.search(from, to) ==
+                terminator.search<const char *>(from, to));
+        // incomplete terminator
+        REQUIRE(terminator.search(from, from + size + 1) == from + size + 1);
+        REQUIRE(terminator.search(from, from + size) == from + size);
+    }
+}
@@ -110,6 +110,26 @@ TEST_CASE("too large int extraction attempt", "[protocol]") {
         boost::apply_visitor(r::extractor<Iterator>(), erased_marker));
 }
 
+TEST_CASE("int extraction limits", "[protocol]") {
+    auto extract = [](const std::string &source) {
+        Buffer buff{source.c_str(), source.size()};
+        r::markers::int_t<Iterator> marker{r::markers::string_t<Iterator>{
+            Iterator::begin(buff), Iterator::end(buff)}};
+        r::markers::redis_result_t<Iterator> erased_marker{marker};
+        auto r = boost::apply_visitor(r::extractor<Iterator>(), erased_marker);
+        return boost::get<r::extracts::int_t>(r);
+    };
+
+    REQUIRE(extract("9223372036854775807") == INT64_MAX);
+    REQUIRE(extract("-9223372036854775808") == INT64_MIN);
+    REQUIRE(extract("-0") == 0);
+    REQUIRE_THROWS(extract("9223372036854775808"));
+    REQUIRE_THROWS(extract("-9223372036854775809"));
+    REQUIRE_THROWS(extract(""));
+    REQUIRE_THROWS(extract("-"));
+    REQUIRE_THROWS(extract("+5"));
+}
+
 TEST_CASE("vector extraction", "[protocol]") {
     std::string source_1 = "src";
     Buffer buff_1{source_1.c_str(), source_1.size()};
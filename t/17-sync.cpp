@@ -57,3 +57,56 @@ TEST_CASE("ping", "[connection]") {
     REQUIRE(boost::apply_visitor(equality, parse_result.result));
     rx_buff.consume(parse_result.consumed);
 }
+
+TEST_CASE("big value", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+    using Buffer = boost::asio::streambuf;
+    using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    std::string value;
+    for (size_t i = 0; value.size() < 1024 * 1024; ++i) {
+        value += boost::lexical_cast<std::string>(i);
+    }
+    c.write(r::single_command_t{"SET", "big-key", value});
+    rx_buff.consume(c.read(rx_buff).consumed);
+
+    c.write(r::single_command_t{"GET", "big-key"});
+    auto parse_result = c.read(rx_buff);
+    auto equality = r::marker_helpers::equality<Iterator>(value);
+    REQUIRE(boost::apply_visitor(equality, parse_result.result));
+    rx_buff.consume(parse_result.consumed);
+
+    r::command_container_t cmds{r::single_command_t{"GET", "big-key"},
+                                r::single_command_t{"PING"}};
+    c.write(r::command_wrapper_t{cmds});
+    bool completion_invoked = false;
+    c.async_read(rx_buff,
+                 [&](const boost::system::error_code &ec, auto &&result) {
+                     REQUIRE(!ec);
+                     auto &replies =
+                         boost::get<r::markers::array_holder_t<Iterator>>(
+                             result.result);
+                     REQUIRE(boost::apply_visitor(equality,
+                                                  replies.elements[0]));
+                     rx_buff.consume(result.consumed);
+                     completion_invoked = true;
+                 },
+                 2);
+    io_service.run();
+    REQUIRE(completion_invoked);
+    REQUIRE(rx_buff.size() == 0);
+}
@@ -0,0 +1,290 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <string>
+#include <vector>
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Protocol.hpp"
+
+#include "catch.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+
+using Iterator = std::string::const_iterator;
+
+TEST_CASE("fragmented nested reply", "[incremental]") {
+    std::string reply = "*3\r\n$7\r\nmessage\r\n*2\r\n:5\r\n+OK\r\n$-1\r\n";
+    std::string tail = "+next\r\n";
+    std::string data = reply + tail;
+
+    r::details::incremental_parser_t parser;
+    size_t position = 0;
+    size_t fed_bytes = 0;
+    bool complete = false;
+    // emulate arriving of reply byte by byte
+    for (size_t available = 0; available <= data.size() && !complete;
+         ++available) {
+        auto from = data.cbegin() + position;
+        auto to = data.cbegin() + available;
+        auto result = parser.feed(from, to);
+        REQUIRE(!result.error);
+        fed_bytes += std::distance(from, to);
+        position += result.consumed;
+        complete = result.complete;
+    }
+    REQUIRE(complete);
+    REQUIRE(position == reply.size());
+    // the only re-scanned bytes are the ones of incomplete lines
+    REQUIRE(fed_bytes < reply.size() * 3);
+
+    auto result = parser.feed(data.cbegin() + position, data.cend());
+    REQUIRE(!result.error);
+    REQUIRE(result.complete);
+    REQUIRE(result.consumed == tail.size());
+}
+
+TEST_CASE("bulk string is skipped without re-scan", "[incremental]") {
+    std::string payload(1000, 'x');
+    std::string data = "$1000\r\n" + payload + "\r\n";
+
+    r::details::incremental_parser_t parser;
+    auto result = parser.feed(data.cbegin(), data.cbegin() + 500);
+    REQUIRE(!result.error);
+    REQUIRE(!result.complete);
+    // the header is processed, the payload is waited as whole
+    REQUIRE(result.consumed == 7);
+    REQUIRE(result.needed == data.size() - 500);
+
+    result = parser.feed(data.cbegin() + 7, data.cend() - 1);
+    REQUIRE(!result.error);
+    REQUIRE(!result.complete);
+    REQUIRE(result.consumed == 0);
+    REQUIRE(result.needed == 1);
+
+    result = parser.feed(data.cbegin() + 7, data.cend());
+    REQUIRE(!result.error);
+    REQUIRE(result.complete);
+    REQUIRE(result.consumed == payload.size() + 2);
+}
+
+TEST_CASE("empty and nil arrays", "[incremental]") {
+    std::string data = "*2\r\n*0\r\n*-1\r\n";
+    r::details::incremental_parser_t parser;
+    auto result = parser.feed(data.cbegin(), data.cend());
+    REQUIRE(!result.error);
+    REQUIRE(result.complete);
+    REQUIRE(result.consumed == data.size());
+}
+
+TEST_CASE("incremental protocol errors", "[incremental]") {
+    r::details::incremental_parser_t parser;
+
+    std::string wrong_intro = "*1\r\n@OK\r\n";
+    auto result = parser.feed(wrong_intro.cbegin(), wrong_intro.cend());
+    REQUIRE(result.error.message() == "Wrong introduction");
+
+    parser.reset();
+    std::string wrong_count = "$-5\r\nsome\r\n";
+    result = parser.feed(wrong_count.cbegin(), wrong_count.cend());
+    REQUIRE(result.error.message() == "Unacceptable count value");
+
+    parser.reset();
+    std::string wrong_terminator = "$4\r\nsome!!";
+    result = parser.feed(wrong_terminator.cbegin(), wrong_terminator.cend());
+    REQUIRE(result.error.message() == "Terminator for bulk string not found");
+}
+
+TEST_CASE("match result resumes scanning", "[incremental]") {
+    std::string data = "+OK\r\n*2\r\n$3\r\nabc\r\n:1\r\n";
+    r::MatchResult<Iterator> match(2);
+
+    // emulate asio::read_until, which continues from the reported position
+    size_t search_position = 0;
+    for (size_t available = 1; available < data.size(); ++available) {
+        auto begin = data.cbegin();
+        auto result =
+            match(begin + search_position, data.cbegin() + available);
+        REQUIRE(!result.second);
+        search_position = std::distance(begin, result.first);
+        REQUIRE(search_position <= available);
+    }
+    auto result = match(data.cbegin() + search_position, data.cend());
+    REQUIRE(result.second);
+    REQUIRE(result.first == data.cend());
+}
+
+TEST_CASE("tape markers are the same as parsed ones", "[incremental]") {
+    using Buffer = std::vector<asio::const_buffers_1>;
+    using BufferIterator = boost::asio::buffers_iterator<Buffer, char>;
+    using Policy = r::parsing_policy::keep_result;
+    using positive_result_t = r::parse_result_mapper_t<BufferIterator, Policy>;
+    using stringizer_t = r::marker_helpers::stringizer<BufferIterator>;
+
+    std::string data = "*4\r\n$7\r\nmessage\r\n*3\r\n:5\r\n-ERR\r\n*0\r\n$-1"
+                       "\r\n+OK\r\n";
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.push_back(asio::const_buffers_1(data.c_str() + i, 1));
+    }
+    auto from = BufferIterator::begin(buff), to = BufferIterator::end(buff);
+
+    r::details::incremental_parser_t parser;
+    r::tape_t tape;
+    r::details::tape_builder_t<BufferIterator> builder(tape, from);
+    auto result = parser.feed(from, to, builder);
+    REQUIRE(!result.error);
+    REQUIRE(result.complete);
+    REQUIRE(result.consumed == data.size());
+    REQUIRE(tape.open_arrays.empty());
+    REQUIRE(tape.nodes.size() == 8);
+    REQUIRE(tape.nodes[0].skip == 8);
+    REQUIRE(tape.nodes[2].skip == 4);
+
+    r::details::tape_materializer_t<BufferIterator> materializer(tape, from);
+    auto materialized = materializer.next();
+
+    auto parsed_result = r::Protocol::parse(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    REQUIRE(boost::apply_visitor(stringizer_t(), materialized) ==
+            boost::apply_visitor(stringizer_t(), parsed.result));
+}
+
+// exposes its content as a sequence of single-byte buffers
+struct fragmented_buffer_t {
+    using const_buffers_type = std::vector<asio::const_buffer>;
+    std::string content;
+
+    const_buffers_type data() const {
+        const_buffers_type buffers;
+        for (size_t i = 0; i < content.size(); i++) {
+            buffers.emplace_back(content.c_str() + i, 1);
+        }
+        return buffers;
+    }
+
+    size_t size() const { return content.size(); }
+    size_t capacity() const { return content.size(); }
+    size_t max_size() const { return content.max_size(); }
+};
+
+TEST_CASE("contiguous and fragmented buffers are read alike",
+          "[incremental]") {
+    using Policy = r::parsing_policy::keep_result;
+    using StreamIterator = r::to_iterator<asio::streambuf>::iterator_t;
+    using FragmentedIterator = r::to_iterator<fragmented_buffer_t>::iterator_t;
+
+    std::string reply_1 = "*2\r\n$5\r\nhello\r\n:42\r\n";
+    std::string reply_2 = "-ERR oops\r\n";
+
+    asio::streambuf stream_buff;
+    std::ostream os(&stream_buff);
+    os << reply_1 << reply_2.substr(0, 3);
+    fragmented_buffer_t fragmented_buff{reply_1 + reply_2.substr(0, 3)};
+
+    r::async_read_op_impl<asio::streambuf, Policy> stream_read(2);
+    r::async_read_op_impl<fragmented_buffer_t, Policy> fragmented_read(2);
+    REQUIRE(!stream_read.feed(stream_buff));
+    REQUIRE(!fragmented_read.feed(fragmented_buff));
+
+    os << reply_2.substr(3);
+    fragmented_buff.content += reply_2.substr(3);
+    REQUIRE(stream_read.feed(stream_buff));
+    REQUIRE(fragmented_read.feed(fragmented_buff));
+    REQUIRE(!stream_read.error());
+    REQUIRE(!fragmented_read.error());
+
+    // the markers refer to the buffer sequences
+    auto stream_data = stream_buff.data();
+    auto fragmented_data = fragmented_buff.data();
+    auto stream_result = stream_read.result(stream_data);
+    auto fragmented_result = fragmented_read.result(fragmented_data);
+    REQUIRE(stream_result.consumed == reply_1.size() + reply_2.size());
+    REQUIRE(fragmented_result.consumed == stream_result.consumed);
+    REQUIRE(boost::apply_visitor(
+                r::marker_helpers::stringizer<StreamIterator>(),
+                stream_result.result) ==
+            boost::apply_visitor(
+                r::marker_helpers::stringizer<FragmentedIterator>(),
+                fragmented_result.result));
+}
+
+TEST_CASE("pending bulk string is requested at once", "[incremental]") {
+    using Policy = r::parsing_policy::drop_result;
+
+    std::string payload(100000, 'x');
+    std::string data = "+OK\r\n$100000\r\n" + payload + "\r\n";
+    fragmented_buffer_t buff{data.substr(0, 3)};
+    r::async_read_op_impl<fragmented_buffer_t, Policy> read_op(2);
+
+    // the size of the line is unknown
+    REQUIRE(!read_op.feed(buff));
+    REQUIRE(read_op.needed() == 1);
+    REQUIRE(read_op.read_size(buff) == 512);
+
+    buff.content = data.substr(0, 1000);
+    REQUIRE(!read_op.feed(buff));
+    REQUIRE(read_op.needed() == data.size() - 1000);
+    REQUIRE(read_op.read_size(buff) == data.size() - 1000);
+
+    buff.content = data;
+    REQUIRE(read_op.feed(buff));
+    REQUIRE(!read_op.error());
+    REQUIRE(read_op.result(buff.data()).consumed == data.size());
+}
+
+TEST_CASE("huge bulk strings are read by portions or rejected",
+          "[incremental]") {
+    using Policy = r::parsing_policy::drop_result;
+
+    // the pending payload is requested by portions
+    std::string big = "$400000000\r\nxx";
+    fragmented_buffer_t buff{big};
+    r::async_read_op_impl<fragmented_buffer_t, Policy> read_op(1);
+    REQUIRE(!read_op.feed(buff));
+    REQUIRE(read_op.needed() == 400000000);
+    REQUIRE(read_op.read_size(buff) == BREDIS_MAX_READ_SIZE);
+
+    // the size above the protocol maximum is rejected
+    fragmented_buffer_t huge{"$9000000000000000000\r\n"};
+    r::async_read_op_impl<fragmented_buffer_t, Policy> huge_op(1);
+    REQUIRE(huge_op.feed(huge));
+    REQUIRE(huge_op.error() ==
+            r::Error::make_error_code(r::bredis_errors::count_range));
+
+    std::string huge_data = "$9000000000000000000\r\n";
+    auto parsed_result =
+        r::Protocol::parse(huge_data.cbegin(), huge_data.cend());
+    auto *error = boost::get<r::protocol_error_t>(&parsed_result);
+    REQUIRE(error);
+    REQUIRE(error->code ==
+            r::Error::make_error_code(r::bredis_errors::count_range));
+}
+
+TEST_CASE("huge aggregate counts are rejected", "[incremental]") {
+    auto count_range = r::Error::make_error_code(r::bredis_errors::count_range);
+
+    // the keys and values of the map would overflow the amount of elements
+    std::string huge_map = "%9223372036854775807\r\n";
+    auto parsed_result = r::Protocol::parse(huge_map.cbegin(), huge_map.cend());
+    auto *error = boost::get<r::protocol_error_t>(&parsed_result);
+    REQUIRE(error);
+    REQUIRE(error->code == count_range);
+
+    std::string huge_attribute = "|300000000\r\n";
+    parsed_result =
+        r::Protocol::parse(huge_attribute.cbegin(), huge_attribute.cend());
+    error = boost::get<r::protocol_error_t>(&parsed_result);
+    REQUIRE(error);
+    REQUIRE(error->code == count_range);
+
+    r::details::incremental_parser_t parser;
+    auto result = parser.feed(huge_map.cbegin(), huge_map.cend());
+    REQUIRE(result.error == count_range);
+
+    // the acceptable count does not allocate the absent elements
+    std::string big_array = "*400000000\r\n:1\r\n";
+    parsed_result = r::Protocol::parse(big_array.cbegin(), big_array.cend());
+    REQUIRE(boost::get<r::not_enough_data_t>(&parsed_result));
+}
@@ -0,0 +1,117 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <string>
+#include <vector>
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Protocol.hpp"
+
+#include "catch.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+
+using Buffer = std::vector<asio::const_buffers_1>;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+using Policy = r::parsing_policy::keep_tape;
+using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+
+// the same as marker_helpers::stringizer, but walks the tape
+template <typename Iterator>
+struct tape_stringizer : public boost::static_visitor<std::string> {
+    r::marker_helpers::stringizer<Iterator> leaf;
+
+    template <typename T> std::string operator()(const T &value) const {
+        return leaf(value);
+    }
+
+    std::string operator()(const r::tape_array_t<Iterator> &value) const {
+        std::string r = "[array] {";
+        for (const auto &v : value) {
+            r += v.visit(*this) + ", ";
+        }
+        r += "}";
+        return r;
+    }
+};
+
+TEST_CASE("tape navigation", "[tape]") {
+    std::string data =
+        "*3\r\n$5\r\nfield\r\n*2\r\n:-15\r\n$-1\r\n-ERR oops\r\n+tail\r\n";
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.push_back(asio::const_buffers_1(data.c_str() + i, 1));
+    }
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    auto parsed_result = r::Protocol::parse<Iterator, Policy>(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    REQUIRE(parsed.consumed == data.size() - 7);
+    REQUIRE(parsed.result.tape.nodes.size() == 6);
+
+    auto root = parsed.result.root();
+    REQUIRE(root.kind() == r::tape_kind_t::array);
+    REQUIRE(root.size() == 3);
+
+    auto field = root.child();
+    REQUIRE(field.kind() == r::tape_kind_t::string);
+    auto field_str = field.string();
+    REQUIRE(std::string(field_str.from, field_str.to) == "field");
+
+    auto nested = field.next();
+    REQUIRE(nested.kind() == r::tape_kind_t::array);
+    auto nested_array = nested.array();
+    REQUIRE(nested_array.size() == 2);
+    REQUIRE(std::distance(nested_array.begin(), nested_array.end()) == 2);
+    REQUIRE(nested_array.begin()->kind() == r::tape_kind_t::int_);
+
+    auto error = nested.next();
+    REQUIRE(error.kind() == r::tape_kind_t::error);
+    REQUIRE(error.next() == root.next());
+
+    auto markers_result = r::Protocol::parse(from, to);
+    auto &markers = boost::get<r::parse_result_mapper_t<
+        Iterator, r::parsing_policy::keep_result>>(markers_result);
+    REQUIRE(root.visit(tape_stringizer<Iterator>()) ==
+            boost::apply_visitor(r::marker_helpers::stringizer<Iterator>(),
+                                 markers.result));
+    REQUIRE(error.visit(r::marker_helpers::equality<Iterator>("ERR oops")));
+}
+
+TEST_CASE("tape parsing errors", "[tape]") {
+    std::string data = "*2\r\n:1\r\n";
+    Buffer buff{asio::const_buffers_1(data.c_str(), data.size())};
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+    auto parsed_result = r::Protocol::parse<Iterator, Policy>(from, to);
+    REQUIRE(boost::get<r::not_enough_data_t>(&parsed_result));
+
+    std::string wrong = "*2\r\n@1\r\n";
+    Buffer wrong_buff{asio::const_buffers_1(wrong.c_str(), wrong.size())};
+    from = Iterator::begin(wrong_buff), to = Iterator::end(wrong_buff);
+    parsed_result = r::Protocol::parse<Iterator, Policy>(from, to);
+    auto *error = boost::get<r::protocol_error_t>(&parsed_result);
+    REQUIRE(error);
+    REQUIRE(error->code.message() == "Wrong introduction");
+}
+
+TEST_CASE("multiple replies are read into single tape", "[tape]") {
+    using StreamIterator = r::to_iterator<asio::streambuf>::iterator_t;
+
+    asio::streambuf rx_buff;
+    std::ostream os(&rx_buff);
+    os << "+OK\r\n*2\r\n$1\r\na\r\n$1\r\nb\r\n:7\r\n";
+
+    r::async_read_op_impl<asio::streambuf, Policy> read_op(3);
+    REQUIRE(read_op.feed(rx_buff));
+    REQUIRE(!read_op.error());
+    auto rx_data = rx_buff.data();
+    auto result = read_op.result(rx_data);
+    REQUIRE(result.consumed == rx_buff.size());
+
+    auto root = result.result.root();
+    REQUIRE(root.kind() == r::tape_kind_t::array);
+    REQUIRE(root.size() == 3);
+    REQUIRE(root.visit(tape_stringizer<StreamIterator>()) ==
+            "[array] {[str] OK, [array] {[str] a, [str] b, }, [int] 7, }");
+}
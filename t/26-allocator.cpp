@@ -0,0 +1,129 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Protocol.hpp"
+
+#include "catch.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+
+using Buffer = asio::const_buffers_1;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+using Policy = r::parsing_policy::keep_result;
+using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+using array_t = r::markers::array_holder_t<Iterator>;
+
+struct counting_resource_t : public r::memory_resource_t {
+    r::monotonic_arena_t arena{256};
+    size_t allocations = 0;
+    size_t deallocations = 0;
+
+    void *allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocations;
+        return arena.allocate(bytes, alignment);
+    }
+
+    void deallocate(void *p, std::size_t bytes,
+                    std::size_t alignment) override {
+        ++deallocations;
+        arena.deallocate(p, bytes, alignment);
+    }
+};
+
+// checks that all the arrays of the reply are drawn from the resource
+struct resource_checker : public boost::static_visitor<bool> {
+    r::memory_resource_t *resource;
+
+    resource_checker(r::memory_resource_t *resource_) : resource{resource_} {}
+
+    template <typename T> bool operator()(const T & /*value*/) const {
+        return true;
+    }
+
+    bool operator()(const array_t &value) const {
+        if (value.elements.get_allocator().resource() != resource) {
+            return false;
+        }
+        for (const auto &v : value.elements) {
+            if (!boost::apply_visitor(*this, v)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+TEST_CASE("markers are allocated from the resource", "[allocator]") {
+    using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+    std::string data = "*3\r\n*2\r\n:1\r\n:2\r\n*0\r\n*1\r\n*1\r\n+OK\r\n";
+    Buffer buff(data.c_str(), data.size());
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    auto expected_result = r::Protocol::parse(from, to);
+    auto &expected = boost::get<positive_result_t>(expected_result);
+
+    counting_resource_t resource;
+    {
+        auto parsed_result = r::Protocol::parse(from, to, &resource);
+        auto &parsed = boost::get<positive_result_t>(parsed_result);
+        REQUIRE(parsed.consumed == data.size());
+        REQUIRE(boost::apply_visitor(resource_checker{&resource},
+                                     parsed.result));
+        REQUIRE(boost::apply_visitor(stringizer_t(), parsed.result) ==
+                boost::apply_visitor(stringizer_t(), expected.result));
+        REQUIRE(resource.allocations > 0);
+    }
+    REQUIRE(resource.deallocations == resource.allocations);
+    REQUIRE(boost::apply_visitor(resource_checker{nullptr}, expected.result));
+
+    std::string partial = "*2\r\n:1\r\n";
+    Buffer partial_buff(partial.c_str(), partial.size());
+    auto partial_result =
+        r::Protocol::parse(Iterator::begin(partial_buff),
+                           Iterator::end(partial_buff), &resource);
+    REQUIRE(boost::get<r::not_enough_data_t>(&partial_result));
+}
+
+TEST_CASE("read markers are allocated from the resource", "[allocator]") {
+    using StreamIterator = r::to_iterator<asio::streambuf>::iterator_t;
+    using stream_array_t = r::markers::array_holder_t<StreamIterator>;
+
+    asio::streambuf rx_buff;
+    std::ostream os(&rx_buff);
+    os << "*2\r\n$1\r\na\r\n$1\r\nb\r\n:7\r\n";
+
+    counting_resource_t resource;
+    r::async_read_op_impl<asio::streambuf, Policy> read_op(2, &resource);
+    REQUIRE(read_op.feed(rx_buff));
+    auto rx_data = rx_buff.data();
+    auto result = read_op.result(rx_data);
+    REQUIRE(result.consumed == rx_buff.size());
+
+    auto &replies = boost::get<stream_array_t>(result.result);
+    REQUIRE(replies.elements.get_allocator().resource() == &resource);
+    auto &first = boost::get<stream_array_t>(replies.elements[0]);
+    REQUIRE(first.elements.get_allocator().resource() == &resource);
+    REQUIRE(first.elements.size() == 2);
+}
+
+TEST_CASE("monotonic arena", "[allocator]") {
+    r::monotonic_arena_t arena{64};
+    auto p1 = arena.allocate(10, 1);
+    auto p2 = arena.allocate(8, 8);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(p2) % 8 == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(p2) >=
+            reinterpret_cast<std::uintptr_t>(p1) + 10);
+
+    // does not fit into the block
+    auto p3 = arena.allocate(100, 8);
+    REQUIRE(p3);
+
+    arena.release();
+    REQUIRE(arena.allocate(10, 1) == p1);
+}
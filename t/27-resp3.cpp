@@ -0,0 +1,212 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/Extract.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = std::vector<asio::const_buffers_1>;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+using Policy = r::parsing_policy::keep_result;
+using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+static Buffer fragmented(const std::string &data) {
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.push_back(asio::const_buffers_1(data.c_str() + i, 1));
+    }
+    return buff;
+}
+
+static const std::string resp3_reply =
+    "*9\r\n"
+    ",3.14\r\n"
+    "#t\r\n"
+    "(3492890328409238509324850943850943825024385\r\n"
+    "_\r\n"
+    "!9\r\nSYNTAX oh\r\n"
+    "=15\r\ntxt:Some string\r\n"
+    "%2\r\n+key\r\n:1\r\n$3\r\nkey\r\n~2\r\n:2\r\n:3\r\n"
+    ">2\r\n+invalidate\r\n*1\r\n+x\r\n"
+    "|1\r\n+ttl\r\n:3600\r\n+value\r\n";
+
+static const std::string resp3_stringized =
+    "[array] {[double] 3.14, [bool] t, "
+    "[bignum] 3492890328409238509324850943850943825024385, [nil] , "
+    "[err] SYNTAX oh, [verbatim] txt:Some string, "
+    "[map] {[str] key, [int] 1, [str] key, [set] {[int] 2, [int] 3, }, }, "
+    "[push] {[str] invalidate, [array] {[str] x, }, }, "
+    "[attribute] {[str] ttl, [int] 3600, [str] value, }, }";
+
+TEST_CASE("resp3 types", "[protocol]") {
+    auto buff = fragmented(resp3_reply);
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    auto parsed_result = r::Protocol::parse(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    REQUIRE(parsed.consumed == resp3_reply.size());
+    REQUIRE(boost::apply_visitor(stringizer_t(), parsed.result) ==
+            resp3_stringized);
+
+    using drop_policy = r::parsing_policy::drop_result;
+    auto dropped_result = r::Protocol::parse<Iterator, drop_policy>(from, to);
+    auto &dropped =
+        boost::get<r::parse_result_mapper_t<Iterator, drop_policy>>(
+            dropped_result);
+    REQUIRE(dropped.consumed == resp3_reply.size());
+
+    // the same via the incremental parser and tape
+    r::monotonic_arena_t arena;
+    auto tape_result = r::Protocol::parse(from, to, &arena);
+    auto &tape_parsed = boost::get<positive_result_t>(tape_result);
+    REQUIRE(tape_parsed.consumed == resp3_reply.size());
+    REQUIRE(boost::apply_visitor(stringizer_t(), tape_parsed.result) ==
+            resp3_stringized);
+
+    for (size_t i = 0; i < resp3_reply.size(); ++i) {
+        auto data = resp3_reply.substr(0, i);
+        auto partial = fragmented(data);
+        auto partial_result = r::Protocol::parse(Iterator::begin(partial),
+                                                 Iterator::end(partial));
+        REQUIRE(boost::get<r::not_enough_data_t>(&partial_result));
+    }
+}
+
+TEST_CASE("resp3 malformed types", "[protocol]") {
+    for (std::string bad : {"#x\r\n", "#tt\r\n", "=3\r\ntxt\r\n",
+                            "=5\r\ntxt!a\r\n"}) {
+        auto buff = fragmented(bad);
+        auto from = Iterator::begin(buff), to = Iterator::end(buff);
+        auto parsed_result = r::Protocol::parse(from, to);
+        auto *error = boost::get<r::protocol_error_t>(&parsed_result);
+        REQUIRE(error);
+        REQUIRE(error->code.message() == "Parser error");
+
+        r::details::incremental_parser_t parser;
+        auto result = parser.feed(from, to);
+        REQUIRE(result.error.message() == "Parser error");
+    }
+}
+
+TEST_CASE("resp3 extraction", "[protocol]") {
+    auto buff = fragmented(resp3_reply);
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+    auto parsed_result = r::Protocol::parse(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+
+    auto extracted = boost::apply_visitor(r::extractor<Iterator>(),
+                                          parsed.result);
+    auto &items = boost::get<r::extracts::array_holder_t>(extracted).elements;
+    REQUIRE(items.size() == 9);
+    REQUIRE(boost::get<r::extracts::double_t>(items[0]) == Approx(3.14));
+    REQUIRE(boost::get<r::extracts::bool_t>(items[1]));
+    REQUIRE(boost::get<r::extracts::big_number_t>(items[2]).str ==
+            "3492890328409238509324850943850943825024385");
+    REQUIRE(boost::get<r::extracts::nil_t>(&items[3]));
+    REQUIRE(boost::get<r::extracts::error_t>(items[4]).str == "SYNTAX oh");
+    auto &verbatim = boost::get<r::extracts::verbatim_t>(items[5]);
+    REQUIRE(verbatim.format == "txt");
+    REQUIRE(verbatim.str == "Some string");
+
+    auto &map = boost::get<r::extracts::map_holder_t>(items[6]).elements;
+    REQUIRE(map.size() == 2);
+    REQUIRE(boost::get<r::extracts::string_t>(map[0].first).str == "key");
+    REQUIRE(boost::get<r::extracts::int_t>(map[0].second) == 1);
+    auto &set = boost::get<r::extracts::set_holder_t>(map[1].second);
+    REQUIRE(set.elements.size() == 2);
+
+    auto &push = boost::get<r::extracts::push_holder_t>(items[7]);
+    REQUIRE(push.elements.size() == 2);
+
+    // attributes are skipped
+    REQUIRE(boost::get<r::extracts::string_t>(items[8]).str == "value");
+}
+
+TEST_CASE("resp3 doubles extraction", "[protocol]") {
+    auto extract = [](const std::string &source) {
+        asio::const_buffers_1 buff{source.c_str(), source.size()};
+        using BufferIterator = asio::buffers_iterator<asio::const_buffers_1>;
+        r::markers::double_t<BufferIterator> marker{
+            r::markers::string_t<BufferIterator>{BufferIterator::begin(buff),
+                                                 BufferIterator::end(buff)}};
+        r::markers::redis_result_t<BufferIterator> erased_marker{marker};
+        auto r = boost::apply_visitor(r::extractor<BufferIterator>(),
+                                      erased_marker);
+        return boost::get<r::extracts::double_t>(r);
+    };
+
+    REQUIRE(extract("10") == 10.0);
+    REQUIRE(extract("-1.5e3") == -1500.0);
+    REQUIRE(std::isinf(extract("inf")));
+    REQUIRE(extract("-inf") < 0);
+    REQUIRE(std::isnan(extract("nan")));
+    REQUIRE_THROWS(extract("1.5x"));
+    REQUIRE_THROWS(extract(""));
+
+    try {
+        extract("1.5x");
+    } catch (const boost::system::system_error &e) {
+        REQUIRE(e.code() ==
+                r::Error::make_error_code(r::bredis_errors::parser_error));
+    }
+}
+
+TEST_CASE("protocol version of hello reply", "[protocol]") {
+    using version_t = r::marker_helpers::protocol_version<Iterator>;
+    auto version = [](const std::string &reply) {
+        auto buff = fragmented(reply);
+        auto parsed_result =
+            r::Protocol::parse(Iterator::begin(buff), Iterator::end(buff));
+        auto &parsed = boost::get<positive_result_t>(parsed_result);
+        return boost::apply_visitor(version_t(), parsed.result);
+    };
+
+    REQUIRE(version("%2\r\n$6\r\nserver\r\n$5\r\nredis\r\n"
+                    "$5\r\nproto\r\n:3\r\n") == 3);
+    REQUIRE(version("*2\r\n$5\r\nproto\r\n:2\r\n") == 2);
+    REQUIRE(version("-ERR unknown command 'HELLO'\r\n") == 0);
+}
+
+TEST_CASE("hello 3 negotiation", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+    using StreamBuffer = boost::asio::streambuf;
+    using StreamIterator = typename r::to_iterator<StreamBuffer>::iterator_t;
+    using version_t = r::marker_helpers::protocol_version<StreamIterator>;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    StreamBuffer rx_buff;
+    c.write(r::single_command_t("HELLO", "3"));
+    auto parse_result = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(version_t(), parse_result.result) == 3);
+    rx_buff.consume(parse_result.consumed);
+
+    c.write(r::single_command_t("PING"));
+    parse_result = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(
+        r::marker_helpers::equality<StreamIterator>("PONG"),
+        parse_result.result));
+}
@@ -0,0 +1,192 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = asio::streambuf;
+
+struct chunks_sink_t {
+    std::vector<std::string> &chunks;
+
+    void operator()(const char *data, std::size_t size, sys::error_code &) {
+        chunks.emplace_back(data, size);
+    }
+};
+
+TEST_CASE("bulk string is passed to sink by chunks", "[stream]") {
+    std::string data = "$10\r\n0123456789\r\n+OK\r\n";
+    std::vector<std::string> chunks;
+    r::stream_read_op_impl<Buffer, chunks_sink_t> read_op(
+        chunks_sink_t{chunks}, 3);
+
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    os << data.substr(0, 2);
+    REQUIRE(!read_op.feed(rx_buff));
+    REQUIRE(rx_buff.size() == 2);
+    os << data.substr(2, 5);
+    REQUIRE(!read_op.feed(rx_buff));
+    REQUIRE(rx_buff.size() == 0);
+    REQUIRE(read_op.read_size(rx_buff) == 3);
+    os << data.substr(7, 8);
+    REQUIRE(!read_op.feed(rx_buff));
+    REQUIRE(rx_buff.size() == 0);
+    os << data.substr(15);
+    REQUIRE(read_op.feed(rx_buff));
+    REQUIRE(!read_op.error());
+
+    REQUIRE(read_op.result().streamed);
+    REQUIRE(read_op.result().size == 10);
+    std::vector<std::string> expected{"01", "234", "567", "89"};
+    REQUIRE(chunks == expected);
+    std::string tail{asio::buffers_begin(rx_buff.data()),
+                     asio::buffers_end(rx_buff.data())};
+    REQUIRE(tail == "+OK\r\n");
+}
+
+TEST_CASE("empty bulk string", "[stream]") {
+    std::vector<std::string> chunks;
+    r::stream_read_op_impl<Buffer, chunks_sink_t> read_op(
+        chunks_sink_t{chunks}, 3);
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    os << "$0\r\n\r\n";
+    REQUIRE(read_op.feed(rx_buff));
+    REQUIRE(!read_op.error());
+    REQUIRE(read_op.result().streamed);
+    REQUIRE(read_op.result().size == 0);
+    REQUIRE(chunks.empty());
+    REQUIRE(rx_buff.size() == 0);
+}
+
+TEST_CASE("other replies are left in buffer", "[stream]") {
+    for (std::string data : {"$-1\r\n", "-ERR oops\r\n", "*1\r\n:1\r\n"}) {
+        std::vector<std::string> chunks;
+        r::stream_read_op_impl<Buffer, chunks_sink_t> read_op(
+            chunks_sink_t{chunks}, 3);
+        Buffer rx_buff;
+        std::ostream os(&rx_buff);
+        os << data;
+        REQUIRE(read_op.feed(rx_buff));
+        REQUIRE(!read_op.error());
+        REQUIRE(!read_op.result().streamed);
+        REQUIRE(rx_buff.size() == data.size());
+        REQUIRE(chunks.empty());
+    }
+}
+
+TEST_CASE("stream errors", "[stream]") {
+    std::vector<std::string> chunks;
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+
+    r::stream_read_op_impl<Buffer, chunks_sink_t> wrong_count(
+        chunks_sink_t{chunks}, 3);
+    os << "$1x\r\n";
+    REQUIRE(wrong_count.feed(rx_buff));
+    REQUIRE(wrong_count.error().message() == "Cannot convert count to number");
+    rx_buff.consume(rx_buff.size());
+
+    r::stream_read_op_impl<Buffer, chunks_sink_t> wrong_terminator(
+        chunks_sink_t{chunks}, 3);
+    os << "$1\r\nab\r\n";
+    REQUIRE(wrong_terminator.feed(rx_buff));
+    REQUIRE(wrong_terminator.error().message() ==
+            "Terminator for bulk string not found");
+    rx_buff.consume(rx_buff.size());
+
+    auto failing_sink = [](const char *, std::size_t, sys::error_code &ec) {
+        ec = asio::error::broken_pipe;
+    };
+    r::stream_read_op_impl<Buffer, decltype(failing_sink)> failing(
+        failing_sink, 3);
+    os << "$1\r\na\r\n";
+    REQUIRE(failing.feed(rx_buff));
+    REQUIRE(failing.error() == asio::error::broken_pipe);
+}
+
+TEST_CASE("stream big value", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    std::string value;
+    for (size_t i = 0; value.size() < 1024 * 1024; ++i) {
+        value += boost::lexical_cast<std::string>(i);
+    }
+    c.write(r::single_command_t{"SET", "big-key", value});
+    auto set_result = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<
+                                     r::to_iterator<Buffer>::iterator_t>("OK"),
+                                 set_result.result));
+    rx_buff.consume(set_result.consumed);
+
+    const std::size_t chunk_size = 4096;
+    std::size_t max_chunk = 0;
+    std::size_t max_buffered = 0;
+    std::string received;
+    auto sink = [&](const char *data, std::size_t size, sys::error_code &) {
+        max_chunk = std::max(max_chunk, size);
+        max_buffered = std::max(max_buffered, rx_buff.size());
+        received.append(data, size);
+    };
+
+    c.write(r::single_command_t{"GET", "big-key"});
+    bool completion_invoked = false;
+    c.async_read_stream(rx_buff, sink,
+                        [&](const sys::error_code &ec, r::stream_result_t r) {
+                            REQUIRE(!ec);
+                            REQUIRE(r.streamed);
+                            REQUIRE(r.size == value.size());
+                            completion_invoked = true;
+                        },
+                        chunk_size);
+    io_service.run();
+    REQUIRE(completion_invoked);
+    REQUIRE(received == value);
+    REQUIRE(max_chunk <= chunk_size);
+    REQUIRE(max_buffered <= 2 * chunk_size);
+    REQUIRE(rx_buff.size() == 0);
+
+    // synchronous interface, ostream sink
+    std::ostringstream out;
+    c.write(r::single_command_t{"GET", "big-key"});
+    auto sync_result = c.read_stream(rx_buff, r::ostream_sink_t{out});
+    REQUIRE(sync_result.streamed);
+    REQUIRE(out.str() == value);
+
+    // nil reply is left for the regular read
+    c.write(r::single_command_t{"GET", "no-such-key"});
+    auto nil_result = c.read_stream(rx_buff, r::ostream_sink_t{out});
+    REQUIRE(!nil_result.streamed);
+    auto parse_result = c.read(rx_buff);
+    REQUIRE(boost::get<r::markers::nil_t<r::to_iterator<Buffer>::iterator_t>>(
+        &parse_result.result));
+    rx_buff.consume(parse_result.consumed);
+}
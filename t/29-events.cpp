@@ -0,0 +1,174 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <string>
+#include <vector>
+
+#include "bredis/Events.hpp"
+
+#include "catch.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+
+using Buffer = std::vector<asio::const_buffers_1>;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+
+// records all events as strings
+template <typename Iterator>
+struct log_handler_t : public r::events_handler_t<Iterator> {
+    using string_t = r::markers::string_t<Iterator>;
+
+    std::vector<std::string> log;
+
+    static std::string str(const string_t &value) {
+        return std::string(value.from, value.to);
+    }
+
+    void on_array_begin(std::size_t count) {
+        log.push_back("array " + std::to_string(count));
+    }
+    void on_array_end() { log.push_back("end"); }
+    void on_string(const string_t &value) { log.push_back(str(value)); }
+    void on_error(const string_t &value) { log.push_back("-" + str(value)); }
+    void on_int(std::int64_t value) { log.push_back(std::to_string(value)); }
+    void on_nil() { log.push_back("nil"); }
+    void on_double(double value) { log.push_back(std::to_string(value)); }
+    void on_bool(bool value) { log.push_back(value ? "true" : "false"); }
+    void on_big_number(const string_t &value) {
+        log.push_back("(" + str(value));
+    }
+    void on_verbatim(const r::markers::verbatim_t<Iterator> &value) {
+        log.push_back(str(value.format) + ":" + str(value.string));
+    }
+    void on_aggregate_begin(r::tape_kind_t, std::size_t count) {
+        log.push_back("aggregate " + std::to_string(count));
+    }
+    void on_aggregate_end() { log.push_back("aggregate end"); }
+};
+
+TEST_CASE("events order", "[events]") {
+    std::string data = "*4\r\n:-15\r\n$-1\r\n*2\r\n+a\r\n-ERR b\r\n*0\r\n"
+                       "%1\r\n,1.5\r\n#f\r\n"
+                       "~2\r\n(12345678901234567890\r\n=7\r\ntxt:abc\r\n";
+    Buffer buff{asio::const_buffers_1(data.c_str(), data.size())};
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    r::event_parser_t parser;
+    log_handler_t<Iterator> handler;
+    auto result = parser.feed(from, to, handler);
+    REQUIRE(!result.error);
+    REQUIRE(result.replies == 3);
+    REQUIRE(result.consumed == data.size());
+
+    std::vector<std::string> expected{"array 4",
+                                      "-15",
+                                      "nil",
+                                      "array 2",
+                                      "a",
+                                      "-ERR b",
+                                      "end",
+                                      "array 0",
+                                      "end",
+                                      "end",
+                                      "aggregate 2",
+                                      "1.500000",
+                                      "false",
+                                      "aggregate end",
+                                      "aggregate 2",
+                                      "(12345678901234567890",
+                                      "txt:abc",
+                                      "aggregate end"};
+    REQUIRE(handler.log == expected);
+}
+
+// decodes XREADGROUP-like reply straight into the structs
+struct entry_t {
+    std::string id;
+    std::vector<std::string> fields;
+};
+
+template <typename Iterator>
+struct entries_handler_t : public r::events_handler_t<Iterator> {
+    std::vector<entry_t> entries;
+    std::size_t depth = 0;
+
+    void on_array_begin(std::size_t /*count*/) {
+        if (++depth == 4) {
+            entries.emplace_back();
+        }
+    }
+    void on_array_end() { --depth; }
+    void on_string(const r::markers::string_t<Iterator> &value) {
+        std::string str(value.from, value.to);
+        if (depth == 4) {
+            entries.back().id = std::move(str);
+        } else if (depth == 5) {
+            entries.back().fields.push_back(std::move(str));
+        }
+    }
+};
+
+TEST_CASE("fragmented feeding", "[events]") {
+    using StreamIterator = r::to_iterator<asio::streambuf>::iterator_t;
+
+    std::string data = "*1\r\n*2\r\n$2\r\nst\r\n*2\r\n"
+                       "*2\r\n$3\r\n1-0\r\n*2\r\n$1\r\na\r\n$1\r\n1\r\n"
+                       "*2\r\n$3\r\n2-0\r\n*4\r\n$1\r\nb\r\n$1\r\n2\r\n"
+                       "$1\r\nc\r\n$10\r\n0123456789\r\n"
+                       "+OK\r\n";
+
+    asio::streambuf rx_buff;
+    std::ostream os(&rx_buff);
+    r::event_parser_t parser;
+    entries_handler_t<StreamIterator> handler;
+    std::size_t replies = 0;
+    for (auto c : data) {
+        os << c;
+        auto const_buff = rx_buff.data();
+        auto result = parser.feed(StreamIterator::begin(const_buff),
+                                  StreamIterator::end(const_buff), handler);
+        REQUIRE(!result.error);
+        replies += result.replies;
+        rx_buff.consume(result.consumed);
+    }
+    REQUIRE(replies == 2);
+    REQUIRE(rx_buff.size() == 0);
+
+    REQUIRE(handler.entries.size() == 2);
+    REQUIRE(handler.entries[0].id == "1-0");
+    std::vector<std::string> fields{"a", "1"};
+    REQUIRE(handler.entries[0].fields == fields);
+    REQUIRE(handler.entries[1].id == "2-0");
+    REQUIRE(handler.entries[1].fields.size() == 4);
+    REQUIRE(handler.entries[1].fields[3] == "0123456789");
+}
+
+TEST_CASE("events decoding errors", "[events]") {
+    for (std::string data : {"*2\r\n:1x\r\n:1\r\n", "*1\r\n,abc\r\n"}) {
+        Buffer buff{asio::const_buffers_1(data.c_str(), data.size())};
+        auto from = Iterator::begin(buff), to = Iterator::end(buff);
+        r::event_parser_t parser;
+        log_handler_t<Iterator> handler;
+        auto result = parser.feed(from, to, handler);
+        REQUIRE(result.error);
+        REQUIRE(result.replies == 0);
+        REQUIRE(handler.log.size() == 1);
+
+        parser.reset();
+        std::string ok = ":5\r\n";
+        Buffer ok_buff{asio::const_buffers_1(ok.c_str(), ok.size())};
+        result = parser.feed(Iterator::begin(ok_buff), Iterator::end(ok_buff),
+                             handler);
+        REQUIRE(!result.error);
+        REQUIRE(result.replies == 1);
+        REQUIRE(handler.log.back() == "5");
+    }
+
+    std::string wrong = "*1\r\n@\r\n";
+    Buffer buff{asio::const_buffers_1(wrong.c_str(), wrong.size())};
+    r::event_parser_t parser;
+    log_handler_t<Iterator> handler;
+    auto result =
+        parser.feed(Iterator::begin(buff), Iterator::end(buff), handler);
+    REQUIRE(result.error.message() == "Wrong introduction");
+}
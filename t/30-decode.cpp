@@ -0,0 +1,264 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/Decode.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = std::vector<asio::const_buffers_1>;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+
+static Buffer fragmented(const std::string &data) {
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.push_back(asio::const_buffers_1(data.c_str() + i, 1));
+    }
+    return buff;
+}
+
+TEST_CASE("decode tuple", "[decode]") {
+    using value_t = std::tuple<std::int64_t, std::string,
+                               std::vector<std::string>, boost::optional<int>>;
+    using Policy = r::parsing_policy::decode_to<value_t>;
+    using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+
+    std::string data = "*4\r\n:-15\r\n$3\r\nabc\r\n*2\r\n+a\r\n$1\r\nb\r\n"
+                       "$-1\r\n";
+    auto buff = fragmented(data);
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    auto parsed_result = r::Protocol::parse<Iterator, Policy>(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    REQUIRE(parsed.consumed == data.size());
+    REQUIRE(std::get<0>(parsed.result) == -15);
+    REQUIRE(std::get<1>(parsed.result) == "abc");
+    std::vector<std::string> strings{"a", "b"};
+    REQUIRE(std::get<2>(parsed.result) == strings);
+    REQUIRE(!std::get<3>(parsed.result));
+
+    // the same from markers
+    auto markers_result = r::Protocol::parse(from, to);
+    auto &markers = boost::get<
+        r::parse_result_mapper_t<Iterator, r::parsing_policy::keep_result>>(
+        markers_result);
+    auto value = r::decode<value_t>(markers.result);
+    REQUIRE((value == parsed.result));
+
+    // mismatches
+    using wrong_t = std::tuple<std::int64_t, std::int64_t,
+                               std::vector<std::string>, boost::optional<int>>;
+    REQUIRE_THROWS(r::decode<wrong_t>(markers.result));
+    std::tuple<std::int64_t, std::string> short_value;
+    REQUIRE(!r::decode(markers.result, short_value));
+
+    using wrong_policy = r::parsing_policy::decode_to<wrong_t>;
+    auto wrong_result = r::Protocol::parse<Iterator, wrong_policy>(from, to);
+    auto *error = boost::get<r::protocol_error_t>(&wrong_result);
+    REQUIRE(error);
+    REQUIRE(error->code.message() == "Reply does not match the decoded type");
+    REQUIRE(error->consumed == data.size());
+
+    // the error reply is distinguished, and it can be skipped
+    std::string error_data = "-WRONGTYPE Operation against a key\r\n";
+    auto error_buff = fragmented(error_data);
+    auto error_result = r::Protocol::parse<Iterator, Policy>(
+        Iterator::begin(error_buff), Iterator::end(error_buff));
+    error = boost::get<r::protocol_error_t>(&error_result);
+    REQUIRE(error);
+    REQUIRE(error->code ==
+            r::Error::make_error_code(r::bredis_errors::server_error));
+    REQUIRE(error->consumed == error_data.size());
+
+    auto error_markers = r::Protocol::parse(Iterator::begin(error_buff),
+                                            Iterator::end(error_buff));
+    auto &error_marker = boost::get<
+        r::parse_result_mapper_t<Iterator, r::parsing_policy::keep_result>>(
+        error_markers);
+    try {
+        r::decode<value_t>(error_marker.result);
+        REQUIRE(false);
+    } catch (const boost::system::system_error &e) {
+        REQUIRE(e.code() ==
+                r::Error::make_error_code(r::bredis_errors::server_error));
+        REQUIRE(std::string(e.what()).find("WRONGTYPE") != std::string::npos);
+    }
+}
+
+TEST_CASE("decode scalars", "[decode]") {
+    auto decode_as = [](const std::string &data, auto &value) {
+        auto buff = fragmented(data);
+        auto parsed_result =
+            r::Protocol::parse<Iterator, r::parsing_policy::keep_tape>(
+                Iterator::begin(buff), Iterator::end(buff));
+        auto &parsed = boost::get<
+            r::parse_result_mapper_t<Iterator, r::parsing_policy::keep_tape>>(
+            parsed_result);
+        return r::decode(parsed.result.root(), value);
+    };
+
+    std::int64_t i64 = 0;
+    REQUIRE(decode_as(":42\r\n", i64));
+    REQUIRE(i64 == 42);
+    REQUIRE(decode_as("$2\r\n17\r\n", i64));
+    REQUIRE(i64 == 17);
+    REQUIRE(!decode_as("$2\r\nab\r\n", i64));
+    REQUIRE(!decode_as("-ERR\r\n", i64));
+
+    std::uint8_t u8 = 0;
+    REQUIRE(decode_as(":255\r\n", u8));
+    REQUIRE(u8 == 255);
+    REQUIRE(!decode_as(":256\r\n", u8));
+    REQUIRE(!decode_as(":-1\r\n", u8));
+
+    double d = 0;
+    REQUIRE(decode_as(",1.5\r\n", d));
+    REQUIRE(d == 1.5);
+    REQUIRE(decode_as(":3\r\n", d));
+    REQUIRE(d == 3.0);
+
+    bool b = false;
+    REQUIRE(decode_as("#t\r\n", b));
+    REQUIRE(b);
+    REQUIRE(decode_as(":0\r\n", b));
+    REQUIRE(!b);
+    REQUIRE(!decode_as(":2\r\n", b));
+
+    std::string str;
+    REQUIRE(decode_as("=7\r\ntxt:abc\r\n", str));
+    REQUIRE(str == "abc");
+    REQUIRE(decode_as("|1\r\n+ttl\r\n:1\r\n+value\r\n", str));
+    REQUIRE(str == "value");
+    REQUIRE(!decode_as("_\r\n", str));
+
+    boost::optional<std::string> opt;
+    REQUIRE(decode_as("_\r\n", opt));
+    REQUIRE(!opt);
+    REQUIRE(decode_as("+x\r\n", opt));
+    REQUIRE(*opt == "x");
+}
+
+TEST_CASE("decode string_ref of non-contiguous buffers", "[decode]") {
+    using Policy = r::parsing_policy::keep_tape;
+    using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+
+    // the value spans two separate buffers
+    std::string head = "+ab";
+    std::string tail = "c\r\n";
+    Buffer buff{asio::const_buffers_1(head.data(), head.size()),
+                asio::const_buffers_1(tail.data(), tail.size())};
+    auto parsed_result = r::Protocol::parse<Iterator, Policy>(
+        Iterator::begin(buff), Iterator::end(buff));
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    auto root = parsed.result.root();
+
+    boost::string_ref ref;
+    REQUIRE(!r::decode(root, ref));
+    std::string str;
+    REQUIRE(r::decode(root, str));
+    REQUIRE(str == "abc");
+    try {
+        r::decode<boost::string_ref>(root);
+        REQUIRE(false);
+    } catch (const boost::system::system_error &e) {
+        REQUIRE(e.code() ==
+                r::Error::make_error_code(r::bredis_errors::type_mismatch));
+    }
+
+    // the contiguous value is referred in place
+    std::string contiguous = "+abc\r\n";
+    auto pointer_result = r::Protocol::parse<const char *, Policy>(
+        contiguous.data(), contiguous.data() + contiguous.size());
+    auto &pointer_parsed = boost::get<
+        r::parse_result_mapper_t<const char *, Policy>>(pointer_result);
+    REQUIRE(r::decode(pointer_parsed.result.root(), ref));
+    REQUIRE(ref.data() == contiguous.data() + 1);
+    REQUIRE(ref == "abc");
+}
+
+TEST_CASE("decode maps", "[decode]") {
+    using map_t = std::map<std::string, std::int64_t>;
+    using Policy = r::parsing_policy::decode_to<map_t>;
+    using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+    for (std::string data :
+         {"%2\r\n+a\r\n:1\r\n+b\r\n:2\r\n",
+          "*4\r\n$1\r\na\r\n$1\r\n1\r\n$1\r\nb\r\n$1\r\n2\r\n"}) {
+        auto buff = fragmented(data);
+        auto parsed_result = r::Protocol::parse<Iterator, Policy>(
+            Iterator::begin(buff), Iterator::end(buff));
+        auto &parsed = boost::get<positive_result_t>(parsed_result);
+        map_t expected{{"a", 1}, {"b", 2}};
+        REQUIRE(parsed.result == expected);
+    }
+}
+
+TEST_CASE("typed read policy", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+    using StreamBuffer = boost::asio::streambuf;
+    using pair_t = std::pair<boost::string_ref, std::int64_t>;
+    using Policy = r::parsing_policy::decode_to<pair_t>;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    StreamBuffer rx_buff;
+    c.write(r::single_command_t{"SET", "counter", "5"});
+    rx_buff.consume(c.read(rx_buff).consumed);
+
+    r::command_container_t cmds{r::single_command_t{"PING"},
+                                r::single_command_t{"INCR", "counter"}};
+    c.write(r::command_wrapper_t{cmds});
+
+    bool completion_invoked = false;
+    c.async_read(rx_buff,
+                 [&](const sys::error_code &ec, auto &&result) {
+                     REQUIRE(!ec);
+                     REQUIRE(result.result.first == "PONG");
+                     REQUIRE(result.result.second == 6);
+                     rx_buff.consume(result.consumed);
+                     completion_invoked = true;
+                 },
+                 2, Policy{});
+    io_service.run();
+    REQUIRE(completion_invoked);
+
+    // the mismatched reply is still consumed
+    c.write(r::single_command_t{"PING"});
+    io_service.restart();
+    completion_invoked = false;
+    c.async_read(rx_buff,
+                 [&](const sys::error_code &ec, auto &&result) {
+                     REQUIRE(ec.message() ==
+                             "Reply does not match the decoded type");
+                     REQUIRE(result.consumed == 7);
+                     rx_buff.consume(result.consumed);
+                     completion_invoked = true;
+                 },
+                 1, r::parsing_policy::decode_to<std::int64_t>{});
+    io_service.run();
+    REQUIRE(completion_invoked);
+    REQUIRE(rx_buff.size() == 0);
+}
@@ -0,0 +1,150 @@
+#include <boost/asio/buffer.hpp>
+#include <string>
+#include <vector>
+
+#include "bredis/Events.hpp"
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Protocol.hpp"
+
+#include "catch.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+
+using Buffer = std::vector<asio::const_buffers_1>;
+using Iterator = boost::asio::buffers_iterator<Buffer, char>;
+using Policy = r::parsing_policy::keep_result;
+using positive_result_t = r::parse_result_mapper_t<Iterator, Policy>;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+static Buffer fragmented(const std::string &data) {
+    Buffer buff;
+    for (size_t i = 0; i < data.size(); i++) {
+        buff.push_back(asio::const_buffers_1(data.c_str() + i, 1));
+    }
+    return buff;
+}
+
+static std::string nested(size_t depth, const std::string &leaf = ":1\r\n") {
+    std::string data;
+    for (size_t i = 0; i < depth; ++i) {
+        data += "*1\r\n";
+    }
+    return data + leaf;
+}
+
+TEST_CASE("nested reply markers", "[protocol]") {
+    // XINFO STREAM FULL-like reply
+    std::string data = "*4\r\n$6\r\nlength\r\n:2\r\n$7\r\nentries\r\n"
+                       "*2\r\n*2\r\n$3\r\n1-0\r\n*2\r\n$1\r\na\r\n$1\r\n1\r\n"
+                       "*2\r\n$3\r\n2-0\r\n*0\r\n"
+                       "%2\r\n+groups\r\n~1\r\n*-1\r\n+pel\r\n%0\r\n"
+                       "|1\r\n+ttl\r\n:3\r\n>1\r\n*1\r\n*1\r\n_\r\n";
+    std::string expected =
+        "[array] {[str] length, [int] 2, [str] entries, [array] {[array] "
+        "{[str] 1-0, [array] {[str] a, [str] 1, }, }, [array] {[str] 2-0, "
+        "[array] {}, }, }, }";
+    auto buff = fragmented(data);
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+
+    auto parsed_result = r::Protocol::parse(from, to);
+    auto &parsed = boost::get<positive_result_t>(parsed_result);
+    auto first_size = parsed.consumed;
+    REQUIRE(boost::apply_visitor(stringizer_t(), parsed.result) == expected);
+
+    // the same markers are materialized from the tape
+    r::monotonic_arena_t arena;
+    auto taped_result = r::Protocol::parse(from, to, &arena);
+    auto &taped = boost::get<positive_result_t>(taped_result);
+    REQUIRE(taped.consumed == first_size);
+    REQUIRE(boost::apply_visitor(stringizer_t(), taped.result) == expected);
+
+    // the rest of the replies
+    size_t consumed = first_size;
+    std::vector<size_t> sizes;
+    while (consumed < data.size()) {
+        auto tail_from = from + consumed;
+        auto raw = r::Protocol::parse(tail_from, to);
+        auto tape = r::Protocol::parse(tail_from, to, &arena);
+        auto &raw_parsed = boost::get<positive_result_t>(raw);
+        auto &tape_parsed = boost::get<positive_result_t>(tape);
+        REQUIRE(raw_parsed.consumed == tape_parsed.consumed);
+        REQUIRE(boost::apply_visitor(stringizer_t(), raw_parsed.result) ==
+                boost::apply_visitor(stringizer_t(), tape_parsed.result));
+
+        using drop_policy = r::parsing_policy::drop_result;
+        auto dropped = r::Protocol::parse<Iterator, drop_policy>(tail_from, to);
+        using drop_result_t = r::parse_result_mapper_t<Iterator, drop_policy>;
+        REQUIRE(boost::get<drop_result_t>(dropped).consumed ==
+                raw_parsed.consumed);
+        consumed += raw_parsed.consumed;
+        sizes.push_back(raw_parsed.consumed);
+    }
+    REQUIRE(consumed == data.size());
+    REQUIRE(sizes.size() == 2);
+
+    for (size_t i = 0; i < first_size; ++i) {
+        auto partial_data = data.substr(0, i);
+        auto partial = fragmented(partial_data);
+        auto partial_result = r::Protocol::parse(Iterator::begin(partial),
+                                                 Iterator::end(partial));
+        REQUIRE(boost::get<r::not_enough_data_t>(&partial_result));
+    }
+}
+
+TEST_CASE("maximum depth", "[protocol]") {
+    std::string allowed = nested(BREDIS_MAX_DEPTH);
+    Buffer allowed_buff{asio::const_buffers_1(allowed.c_str(), allowed.size())};
+    auto allowed_result = r::Protocol::parse(Iterator::begin(allowed_buff),
+                                             Iterator::end(allowed_buff));
+    auto &parsed = boost::get<positive_result_t>(allowed_result);
+    REQUIRE(parsed.consumed == allowed.size());
+
+    std::string empty_leaf = nested(BREDIS_MAX_DEPTH, "*0\r\n");
+    std::string nil_leaf = nested(BREDIS_MAX_DEPTH, "*-1\r\n");
+    Buffer nil_buff{asio::const_buffers_1(nil_leaf.c_str(), nil_leaf.size())};
+    auto nil_result = r::Protocol::parse(Iterator::begin(nil_buff),
+                                         Iterator::end(nil_buff));
+    REQUIRE(boost::get<positive_result_t>(&nil_result));
+
+    // deep enough to overflow the stack of the recursive parser
+    std::string hostile = nested(100000);
+    for (auto &data : {nested(BREDIS_MAX_DEPTH + 1), empty_leaf, hostile}) {
+        Buffer buff{asio::const_buffers_1(data.c_str(), data.size())};
+        auto from = Iterator::begin(buff), to = Iterator::end(buff);
+        std::string message = "Maximum nesting depth exceeded";
+
+        auto kept = r::Protocol::parse(from, to);
+        REQUIRE(boost::get<r::protocol_error_t>(kept).code.message() ==
+                message);
+
+        auto dropped =
+            r::Protocol::parse<Iterator, r::parsing_policy::drop_result>(from,
+                                                                        to);
+        REQUIRE(boost::get<r::protocol_error_t>(dropped).code.message() ==
+                message);
+
+        auto taped =
+            r::Protocol::parse<Iterator, r::parsing_policy::keep_tape>(from,
+                                                                      to);
+        REQUIRE(boost::get<r::protocol_error_t>(taped).code.message() ==
+                message);
+
+        r::event_parser_t parser;
+        r::events_handler_t<Iterator> handler;
+        auto events = parser.feed(from, to, handler);
+        REQUIRE(events.error.message() == message);
+    }
+
+    // the limit is configurable for the resumable parsers
+    std::string shallow = nested(3);
+    Buffer buff{asio::const_buffers_1(shallow.c_str(), shallow.size())};
+    auto from = Iterator::begin(buff), to = Iterator::end(buff);
+    r::details::incremental_parser_t parser(2);
+    REQUIRE(parser.feed(from, to).error);
+    r::event_parser_t events_parser(3);
+    r::events_handler_t<Iterator> handler;
+    auto events = events_parser.feed(from, to, handler);
+    REQUIRE(!events.error);
+    REQUIRE(events.replies == 1);
+}
@@ -0,0 +1,186 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = boost::asio::streambuf;
+using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+using array_t = r::markers::array_holder_t<Iterator>;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+// records the stringized batches
+struct batches_t {
+    std::vector<std::vector<std::string>> &batches;
+
+    void operator()(const array_t &batch, sys::error_code &) {
+        std::vector<std::string> strings;
+        for (const auto &element : batch.elements) {
+            strings.push_back(boost::apply_visitor(stringizer_t(), element));
+        }
+        batches.push_back(strings);
+    }
+};
+
+TEST_CASE("elements are delivered by batches", "[elements]") {
+    std::string reply = "*5\r\n$1\r\na\r\n*2\r\n:1\r\n:2\r\n$-1\r\n+d\r\n"
+                        "-ERR e\r\n";
+    std::string next = "+next\r\n";
+    std::string data = reply + next;
+
+    std::vector<std::vector<std::string>> batches;
+    r::elements_read_op_impl<Buffer, batches_t> read_op(batches_t{batches},
+                                                        2);
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    size_t max_buffered = 0;
+    for (auto c : data) {
+        os << c;
+        max_buffered = std::max(max_buffered, rx_buff.size());
+        if (read_op.feed(rx_buff)) {
+            break;
+        }
+    }
+    REQUIRE(!read_op.error());
+    REQUIRE(read_op.result().delivered);
+    REQUIRE(read_op.result().count == 5);
+    // the delivered elements are consumed
+    REQUIRE(max_buffered < reply.size() / 2);
+    REQUIRE(rx_buff.size() == 0);
+
+    std::vector<std::vector<std::string>> expected{
+        {"[str] a", "[array] {[int] 1, [int] 2, }"},
+        {"[nil] ", "[str] d"},
+        {"[err] ERR e"}};
+    REQUIRE(batches == expected);
+}
+
+TEST_CASE("other replies are not consumed", "[elements]") {
+    for (std::string data :
+         {"+OK\r\n", "*-1\r\n", "|1\r\n+ttl\r\n:1\r\n*0\r\n"}) {
+        std::vector<std::vector<std::string>> batches;
+        r::elements_read_op_impl<Buffer, batches_t> read_op(
+            batches_t{batches}, 1);
+        Buffer rx_buff;
+        std::ostream os(&rx_buff);
+        os << data;
+        REQUIRE(read_op.feed(rx_buff));
+        REQUIRE(!read_op.error());
+        REQUIRE(!read_op.result().delivered);
+        REQUIRE(rx_buff.size() == data.size());
+        REQUIRE(batches.empty());
+    }
+
+    std::vector<std::vector<std::string>> batches;
+    r::elements_read_op_impl<Buffer, batches_t> read_op(batches_t{batches},
+                                                        1);
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    os << "%1\r\n+key\r\n:1\r\n*0\r\n";
+    REQUIRE(read_op.feed(rx_buff));
+    REQUIRE(read_op.result().delivered);
+    REQUIRE(read_op.result().count == 2);
+    REQUIRE(batches.size() == 2);
+    REQUIRE(rx_buff.size() == 4);
+}
+
+TEST_CASE("elements read errors", "[elements]") {
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    std::vector<std::vector<std::string>> batches;
+    r::elements_read_op_impl<Buffer, batches_t> broken(batches_t{batches}, 1);
+    os << "*2\r\n:1\r\n@\r\n";
+    REQUIRE(broken.feed(rx_buff));
+    REQUIRE(broken.error().message() == "Wrong introduction");
+    REQUIRE(batches.size() == 1);
+
+    rx_buff.consume(rx_buff.size());
+    size_t calls = 0;
+    auto aborting = [&](const array_t &, sys::error_code &ec) {
+        ++calls;
+        ec = asio::error::operation_aborted;
+    };
+    r::elements_read_op_impl<Buffer, decltype(aborting)> aborted(aborting, 1);
+    os << "*2\r\n:1\r\n:2\r\n";
+    REQUIRE(aborted.feed(rx_buff));
+    REQUIRE(aborted.error() == asio::error::operation_aborted);
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE("lrange by elements", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    const size_t count = 10000;
+    std::vector<std::string> args{"RPUSH", "list"};
+    for (size_t i = 0; i < count; ++i) {
+        args.emplace_back(boost::lexical_cast<std::string>(i));
+    }
+    c.write(r::single_command_t{args.begin(), args.end()});
+    rx_buff.consume(c.read(rx_buff).consumed);
+
+    size_t received = 0;
+    size_t max_batch = 0;
+    auto handler = [&](const array_t &batch, sys::error_code &) {
+        for (const auto &element : batch.elements) {
+            auto expected = boost::lexical_cast<std::string>(received++);
+            REQUIRE(boost::apply_visitor(
+                r::marker_helpers::equality<Iterator>(expected), element));
+        }
+        max_batch = std::max(max_batch, batch.elements.size());
+    };
+
+    c.write(r::single_command_t{"LRANGE", "list", "0", "-1"});
+    c.write(r::single_command_t{"PING"});
+    bool completion_invoked = false;
+    c.async_read_elements(rx_buff, handler,
+                          [&](const sys::error_code &ec,
+                              r::elements_result_t result) {
+                              REQUIRE(!ec);
+                              REQUIRE(result.delivered);
+                              REQUIRE(result.count == count);
+                              completion_invoked = true;
+                          },
+                          100);
+    io_service.run();
+    REQUIRE(completion_invoked);
+    REQUIRE(received == count);
+    REQUIRE(max_batch <= 100);
+
+    auto ping = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("PONG"),
+                                 ping.result));
+    rx_buff.consume(ping.consumed);
+
+    c.write(r::single_command_t{"LRANGE", "list", "0", "9"});
+    received = 0;
+    auto result = c.read_elements(rx_buff, handler);
+    REQUIRE(result.delivered);
+    REQUIRE(received == 10);
+    REQUIRE(rx_buff.size() == 0);
+}
@@ -0,0 +1,155 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = boost::asio::streambuf;
+using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+TEST_CASE("buffered replies are read at once", "[available]") {
+    using Policy = r::parsing_policy::keep_result;
+    std::string complete = "+a\r\n:1\r\n*2\r\n$1\r\nx\r\n$-1\r\n";
+    std::string partial = "*1\r\n$3\r\nab";
+
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    os << "+a";
+    r::async_read_op_impl<Buffer, Policy> read_op(0, nullptr, true);
+    REQUIRE(!read_op.feed(rx_buff));
+
+    os << complete.substr(2) << partial;
+    REQUIRE(read_op.feed(rx_buff));
+    REQUIRE(!read_op.error());
+    REQUIRE(read_op.replies() == 3);
+    auto rx_data = rx_buff.data();
+    auto result = read_op.result(rx_data);
+    REQUIRE(result.consumed == complete.size());
+    REQUIRE(boost::apply_visitor(stringizer_t(), result.result) ==
+            "[array] {[str] a, [int] 1, [array] {[str] x, [nil] , }, }");
+
+    // the incomplete reply is read later
+    rx_buff.consume(result.consumed);
+    os << "c\r\n:2\r\n";
+    r::async_read_op_impl<Buffer, Policy> next_op(0, nullptr, true);
+    REQUIRE(next_op.feed(rx_buff));
+    REQUIRE(next_op.replies() == 2);
+    rx_data = rx_buff.data();
+    REQUIRE(boost::apply_visitor(stringizer_t(),
+                                 next_op.result(rx_data).result) ==
+            "[array] {[array] {[str] abc, }, [int] 2, }");
+}
+
+TEST_CASE("buffered replies limit and policies", "[available]") {
+    std::string data = "+a\r\n+b\r\n+c\r\n:1";
+    Buffer rx_buff;
+    std::ostream os(&rx_buff);
+    os << data;
+
+    using Policy = r::parsing_policy::keep_result;
+    r::async_read_op_impl<Buffer, Policy> limited(2, nullptr, true);
+    REQUIRE(limited.feed(rx_buff));
+    REQUIRE(limited.replies() == 2);
+    auto rx_data = rx_buff.data();
+    auto result = limited.result(rx_data);
+    REQUIRE(result.consumed == 8);
+    REQUIRE(boost::apply_visitor(stringizer_t(), result.result) ==
+            "[array] {[str] a, [str] b, }");
+
+    // a single reply is wrapped too
+    r::async_read_op_impl<Buffer, Policy> single(1, nullptr, true);
+    REQUIRE(single.feed(rx_buff));
+    REQUIRE(boost::apply_visitor(stringizer_t(),
+                                 single.result(rx_data).result) ==
+            "[array] {[str] a, }");
+
+    using drop_policy = r::parsing_policy::drop_result;
+    r::async_read_op_impl<Buffer, drop_policy> dropped(0, nullptr, true);
+    REQUIRE(dropped.feed(rx_buff));
+    REQUIRE(dropped.replies() == 3);
+    REQUIRE(dropped.result(rx_data).consumed == 12);
+
+    using tape_policy = r::parsing_policy::keep_tape;
+    r::async_read_op_impl<Buffer, tape_policy> taped(0, nullptr, true);
+    REQUIRE(taped.feed(rx_buff));
+    auto tape_result = taped.result(rx_data);
+    REQUIRE(tape_result.consumed == 12);
+    auto root = tape_result.result.root();
+    REQUIRE(root.kind() == r::tape_kind_t::array);
+    REQUIRE(root.size() == 3);
+    std::string strings;
+    for (auto &element : root.array()) {
+        auto str = element.string();
+        strings.append(str.from, str.to);
+    }
+    REQUIRE(strings == "abc");
+}
+
+TEST_CASE("pipelined pings are read as available", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    const size_t count = 1000;
+    r::command_container_t cmds;
+    for (size_t i = 0; i < count; ++i) {
+        cmds.emplace_back(r::single_command_t{"PING"});
+    }
+    c.write(r::command_wrapper_t{cmds});
+
+    size_t received = 0;
+    size_t reads = 0;
+    using Policy = r::parsing_policy::keep_result;
+    using result_t = r::positive_parse_result_t<Iterator, Policy>;
+    std::function<void(const sys::error_code &, result_t &&, size_t)>
+        read_callback = [&](const sys::error_code &ec, result_t &&result,
+                            size_t replies) {
+            REQUIRE(!ec);
+            REQUIRE(replies > 0);
+            auto &array =
+                boost::get<r::markers::array_holder_t<Iterator>>(
+                    result.result);
+            REQUIRE(array.elements.size() == replies);
+            for (auto &element : array.elements) {
+                REQUIRE(boost::apply_visitor(
+                    r::marker_helpers::equality<Iterator>("PONG"), element));
+            }
+            rx_buff.consume(result.consumed);
+            received += replies;
+            ++reads;
+            if (received < count) {
+                c.async_read_available(rx_buff, read_callback);
+            }
+        };
+    c.async_read_available(rx_buff, read_callback);
+    io_service.run();
+    REQUIRE(received == count);
+    REQUIRE(reads < count);
+    REQUIRE(rx_buff.size() == 0);
+}
@@ -0,0 +1,102 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = boost::asio::streambuf;
+using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+
+TEST_CASE("command buffers", "[gather]") {
+    std::string big(10000, 'b');
+    std::string other(5000, 'o');
+    r::command_container_t cmds{r::single_command_t{"SET", "key", big},
+                                r::single_command_t{"PING"},
+                                r::single_command_t{"SET", other, "small"}};
+    r::command_wrapper_t command{cmds};
+
+    std::stringstream expected;
+    for (const auto &cmd : cmds) {
+        r::Protocol::serialize(expected, cmd);
+    }
+
+    r::command_buffers_t buffers(command);
+    REQUIRE(buffers.size() == expected.str().size());
+    std::string joined;
+    std::vector<const char *> in_place;
+    for (const auto &buffer : buffers) {
+        auto data = static_cast<const char *>(buffer.data());
+        joined.append(data, buffer.size());
+        if (buffer.size() >= 4096) {
+            in_place.push_back(data);
+        }
+    }
+    REQUIRE(joined == expected.str());
+    // the long arguments are not copied
+    std::vector<const char *> originals{big.data(), other.data()};
+    REQUIRE(in_place == originals);
+    REQUIRE(std::distance(buffers.begin(), buffers.end()) == 5);
+
+    // everything is copied for the big enough threshold
+    r::command_buffers_t copied(command, big.size() + 1);
+    REQUIRE(std::distance(copied.begin(), copied.end()) == 1);
+    REQUIRE(asio::buffer_size(copied.sequence()) == expected.str().size());
+}
+
+TEST_CASE("gather write of big value", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    std::string value(1024 * 1024, 'x');
+    for (size_t i = 0; i < value.size(); i += 7) {
+        value[i] = static_cast<char>('a' + i % 26);
+    }
+    r::single_command_t set{"SET", "big", value};
+    bool write_completed = false;
+    c.async_write_gather(set, [&](const sys::error_code &ec,
+                                  std::size_t bytes_transferred) {
+        REQUIRE(!ec);
+        REQUIRE(bytes_transferred == r::Protocol::serialized_size(set));
+        write_completed = true;
+    });
+    io_service.run();
+    REQUIRE(write_completed);
+
+    auto set_reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("OK"),
+                                 set_reply.result));
+    rx_buff.consume(set_reply.consumed);
+
+    c.write_gather(r::single_command_t{"GET", "big"});
+    auto get_reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>(value),
+                                 get_reply.result));
+    rx_buff.consume(get_reply.consumed);
+    REQUIRE(rx_buff.size() == 0);
+}
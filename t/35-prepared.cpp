@@ -0,0 +1,101 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = boost::asio::streambuf;
+using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+
+static std::string serialized(const r::command_wrapper_t &command) {
+    Buffer tx_buff;
+    r::serialize_command(tx_buff, command);
+    return std::string(asio::buffers_begin(tx_buff.data()),
+                       asio::buffers_end(tx_buff.data()));
+}
+
+TEST_CASE("prepared command serialization", "[prepared]") {
+    r::prepared_command_t hget{"HGET", r::placeholder, "name"};
+    REQUIRE(hget.variables() == 1);
+    REQUIRE(serialized(hget("user:42")) ==
+            serialized(r::single_command_t{"HGET", "user:42", "name"}));
+
+    std::string value(1000, 'v');
+    r::prepared_command_t hset{"HSET", r::placeholder, "field",
+                               r::placeholder};
+    // the bound arguments refer to the strings, which outlive them
+    std::string key("key");
+    auto bound = hset(key, value);
+    std::vector<boost::string_ref> arguments;
+    for (const auto &arg : bound) {
+        arguments.push_back(arg.string());
+    }
+    std::vector<boost::string_ref> expected{"HSET", "key", "field", value};
+    REQUIRE(arguments == expected);
+    REQUIRE(serialized(bound) ==
+            serialized(r::single_command_t{"HSET", "key", "field", value}));
+
+    // the variable arguments only, and no variable arguments at all
+    r::prepared_command_t get{r::placeholder, r::placeholder};
+    REQUIRE(serialized(get("GET", "k")) ==
+            serialized(r::single_command_t{"GET", "k"}));
+    r::prepared_command_t ping{"PING"};
+    REQUIRE(serialized(ping()) == "*1\r\n$4\r\nPING\r\n");
+
+    std::vector<std::string> args{"k", "v"};
+    r::prepared_command_t set{"SET", r::placeholder, r::placeholder};
+    REQUIRE(serialized(set.bind(args.begin(), args.end())) ==
+            serialized(r::single_command_t{"SET", "k", "v"}));
+
+    REQUIRE_THROWS_AS(hget(), std::invalid_argument &);
+    REQUIRE_THROWS_AS(hget("a", "b"), std::invalid_argument &);
+}
+
+TEST_CASE("prepared commands", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    r::prepared_command_t set{"SET", r::placeholder, r::placeholder};
+    r::prepared_command_t get{"GET", r::placeholder};
+    c.write(set("counter", "41"));
+    rx_buff.consume(c.read(rx_buff).consumed);
+
+    c.write(get("counter"));
+    auto reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("41"),
+                                 reply.result));
+    rx_buff.consume(reply.consumed);
+
+    c.write_gather(get("counter"));
+    reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("41"),
+                                 reply.result));
+    rx_buff.consume(reply.consumed);
+}
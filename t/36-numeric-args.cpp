@@ -0,0 +1,147 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/Connection.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using Buffer = boost::asio::streambuf;
+using Iterator = typename r::to_iterator<Buffer>::iterator_t;
+
+static std::string serialized(const r::command_wrapper_t &command) {
+    Buffer tx_buff;
+    r::serialize_command(tx_buff, command);
+    return std::string(asio::buffers_begin(tx_buff.data()),
+                       asio::buffers_end(tx_buff.data()));
+}
+
+static std::string bulk(const std::string &value) {
+    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+TEST_CASE("numeric arguments formatting", "[command]") {
+    auto formatted = [](const r::command_arg_t &arg) {
+        auto data = serialized(r::single_command_t{arg});
+        auto payload = data.substr(data.find("\r\n", 4) + 2);
+        return payload.substr(0, payload.size() - 2);
+    };
+    REQUIRE(formatted(0) == "0");
+    REQUIRE(formatted(-1) == "-1");
+    REQUIRE(formatted(std::numeric_limits<std::int64_t>::min()) ==
+            "-9223372036854775808");
+    REQUIRE(formatted(std::numeric_limits<std::uint64_t>::max()) ==
+            "18446744073709551615");
+    REQUIRE(formatted(static_cast<short>(-300)) == "-300");
+    REQUIRE(formatted(1234567u) == "1234567");
+
+    REQUIRE(formatted(0.1) == "0.1");
+    REQUIRE(formatted(1.5f) == "1.5");
+    REQUIRE(formatted(-2.0) == "-2");
+    REQUIRE(formatted(1e300) == "1e+300");
+    REQUIRE(formatted(1e-5) == "1e-05");
+    REQUIRE(formatted(0.0001) == "0.0001");
+    REQUIRE(formatted(1e16) == "10000000000000000");
+    REQUIRE(formatted(-0.0) == "-0");
+    REQUIRE(formatted(-2.2250738585072014e-308) ==
+            "-2.2250738585072014e-308");
+    REQUIRE(formatted(std::numeric_limits<double>::infinity()) == "inf");
+    REQUIRE(formatted(-std::numeric_limits<double>::infinity()) == "-inf");
+    for (double value : {0.1 + 0.2, 1.0 / 3, 123456.789e-20, 5e-324}) {
+        REQUIRE(std::strtod(formatted(value).c_str(), nullptr) == value);
+    }
+
+    // the characters are strings, not numbers
+    static_assert(!std::is_constructible<r::command_arg_t, char>::value, "");
+    static_assert(!std::is_constructible<r::command_arg_t, bool>::value, "");
+}
+
+TEST_CASE("numeric arguments in commands", "[command]") {
+    std::string expected =
+        "*4\r\n" + bulk("ZADD") + bulk("zset") + bulk("2.5") + bulk("member");
+    REQUIRE(serialized(r::single_command_t{"ZADD", "zset", 2.5, "member"}) ==
+            expected);
+
+    r::prepared_command_t zadd{"ZADD", "zset", r::placeholder, r::placeholder};
+    REQUIRE(serialized(zadd(2.5, "member")) == expected);
+
+    // the numbers among the constant arguments
+    r::prepared_command_t expire{"EXPIRE", r::placeholder, 60};
+    REQUIRE(serialized(expire("counter")) ==
+            "*3\r\n" + bulk("EXPIRE") + bulk("counter") + bulk("60"));
+    r::prepared_command_t scored{"ZADD", "zset", 2.5, r::placeholder};
+    REQUIRE(serialized(scored("member")) == expected);
+
+    // the number is formatted once, and it is kept by the argument
+    r::command_arg_t arg{0.1};
+    REQUIRE(arg.kind() == r::command_arg_t::kind_t::double_);
+    REQUIRE(arg.string() == "0.1");
+    auto copy = arg;
+    REQUIRE(copy.string() == "0.1");
+    REQUIRE(copy.string().data() != arg.string().data());
+
+    r::command_batch_t batch;
+    batch.push("INCRBY", "counter", -5);
+    batch.push("EXPIRE", "counter", 60u);
+    REQUIRE(serialized(batch) ==
+            "*3\r\n" + bulk("INCRBY") + bulk("counter") + bulk("-5") +
+                "*3\r\n" + bulk("EXPIRE") + bulk("counter") + bulk("60"));
+
+    std::vector<r::command_arg_t> args{"SETRANGE", "key", 100, "value"};
+    r::single_command_t setrange(args.begin(), args.end());
+    r::command_buffers_t buffers(setrange, 1);
+    std::string joined;
+    for (const auto &buffer : buffers) {
+        joined.append(static_cast<const char *>(buffer.data()), buffer.size());
+    }
+    REQUIRE(joined == serialized(setrange));
+    REQUIRE(buffers.size() == joined.size());
+}
+
+TEST_CASE("numeric arguments", "[connection]") {
+    using socket_t = asio::ip::tcp::socket;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_service io_service;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io_service, end_point.protocol());
+    socket.connect(end_point);
+
+    r::Connection<socket_t> c(std::move(socket));
+    Buffer rx_buff;
+
+    c.write(r::single_command_t{"SET", "counter", 40});
+    rx_buff.consume(c.read(rx_buff).consumed);
+    c.write(r::single_command_t{"INCRBY", "counter", 2});
+    auto reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("42"),
+                                 reply.result));
+    rx_buff.consume(reply.consumed);
+
+    c.write(r::single_command_t{"SET", "score", 0.25});
+    rx_buff.consume(c.read(rx_buff).consumed);
+    c.write(r::single_command_t{"GET", "score"});
+    reply = c.read(rx_buff);
+    REQUIRE(boost::apply_visitor(r::marker_helpers::equality<Iterator>("0.25"),
+                                 reply.result));
+    rx_buff.consume(reply.consumed);
+}
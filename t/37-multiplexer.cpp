@@ -0,0 +1,319 @@
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EmptyPort.hpp"
+#include "TestServer.hpp"
+#include "catch.hpp"
+
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Multiplexer.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+namespace ep = empty_port;
+namespace ts = test_server;
+
+using local_socket_t = asio::local::stream_protocol::socket;
+using multiplexer_t = r::Multiplexer<local_socket_t>;
+using Iterator = multiplexer_t::Iterator;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+template <typename Predicate>
+static void run_until(asio::io_context &io, Predicate predicate) {
+    while (!predicate()) {
+        io.run_one();
+    }
+}
+
+struct replies_t {
+    std::vector<std::string> values;
+
+    auto handler() {
+        return [this](const sys::error_code &ec,
+                      const multiplexer_t::result_t &reply) {
+            values.emplace_back(ec ? "error"
+                                   : boost::apply_visitor(stringizer_t(),
+                                                          reply.result));
+        };
+    }
+};
+
+TEST_CASE("commands of one tick are written at once", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    replies_t replies;
+    for (int i = 0; i < 3; ++i) {
+        mux.async_execute(r::single_command_t{"INCR", "x"}, replies.handler());
+    }
+    REQUIRE(mux.pending() == 3);
+    REQUIRE(peer.available() == 0);
+
+    io.poll();
+    std::string command = "*2\r\n$4\r\nINCR\r\n$1\r\nx\r\n";
+    std::string received(peer.available(), '\0');
+    REQUIRE(received.size() == command.size() * 3);
+    asio::read(peer, asio::buffer(&received[0], received.size()));
+    REQUIRE(received == command + command + command);
+
+    asio::write(peer, asio::buffer(std::string(":1\r\n:2\r\n:3\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 3; });
+    std::vector<std::string> expected{"[int] 1", "[int] 2", "[int] 3"};
+    REQUIRE(replies.values == expected);
+    REQUIRE(mux.pending() == 0);
+}
+
+TEST_CASE("replies of multiple commands are matched", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    replies_t replies;
+    r::command_container_t pair{r::single_command_t{"INCR", "x"},
+                                r::single_command_t{"INCR", "y"}};
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    mux.async_execute(pair, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    io.poll();
+
+    // the pair is split between the reads
+    asio::write(peer, asio::buffer(std::string("+a\r\n:1\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 1; });
+    REQUIRE(replies.values[0] == "[str] a");
+    io.poll();
+    REQUIRE(replies.values.size() == 1);
+
+    asio::write(peer, asio::buffer(std::string(":2\r\n+b\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 3; });
+    REQUIRE(replies.values[1] == "[array] {[int] 1, [int] 2, }");
+    REQUIRE(replies.values[2] == "[str] b");
+
+    // the front command is not covered by the available replies
+    r::command_batch_t batch;
+    for (int i = 0; i < 3; ++i) {
+        batch.push("INCR", "z");
+    }
+    mux.async_execute(batch, replies.handler());
+    io.poll();
+    asio::write(peer, asio::buffer(std::string(":1\r\n")));
+    io.poll();
+    REQUIRE(replies.values.size() == 3);
+    asio::write(peer, asio::buffer(std::string(":2\r\n:3\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 4; });
+    REQUIRE(replies.values[3] == "[array] {[int] 1, [int] 2, [int] 3, }");
+
+    REQUIRE_THROWS_AS(
+        mux.async_execute(r::command_container_t{}, replies.handler()),
+        std::invalid_argument &);
+}
+
+TEST_CASE("pending commands fail on I/O error", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    replies_t replies;
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    io.poll();
+    asio::write(peer, asio::buffer(std::string("+a\r\n")));
+    peer.close();
+    run_until(io, [&]() { return replies.values.size() == 2; });
+    std::vector<std::string> expected{"[str] a", "error"};
+    REQUIRE(replies.values == expected);
+    REQUIRE(mux.pending() == 0);
+
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    run_until(io, [&]() { return replies.values.size() == 3; });
+    REQUIRE(replies.values[2] == "error");
+}
+
+TEST_CASE("failed multiplexer becomes idle", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    // the reply is awaited, while the write fails (the peer is half-open)
+    replies_t replies;
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    io.poll();
+    REQUIRE(!mux.idle());
+    mux.next_layer().shutdown(asio::socket_base::shutdown_send);
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    run_until(io, [&]() { return replies.values.size() == 2; });
+    REQUIRE(mux.error());
+    io.poll();
+    REQUIRE(mux.idle());
+    std::vector<std::string> expected{"error", "error"};
+    REQUIRE(replies.values == expected);
+}
+
+TEST_CASE("replies are passed by the command type", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    // the container of one command gets array of one reply
+    replies_t replies;
+    mux.async_execute(r::command_container_t{r::single_command_t{"PING"}},
+                      replies.handler());
+    r::command_batch_t batch;
+    batch.push("PING");
+    mux.async_execute(batch, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    io.poll();
+    asio::write(peer, asio::buffer(std::string("+a\r\n+b\r\n+c\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 3; });
+    std::vector<std::string> expected{"[array] {[str] a, }",
+                                      "[array] {[str] b, }", "[str] c"};
+    REQUIRE(replies.values == expected);
+
+    REQUIRE_THROWS_AS(mux.async_send("*1\r\n$4\r\nPING\r\n"
+                                     "*1\r\n$4\r\nPING\r\n",
+                                     2, false, replies.handler()),
+                      std::invalid_argument &);
+}
+
+TEST_CASE("receive buffers kept by results are reused", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    std::vector<multiplexer_t::result_t> kept;
+    auto ping = [&]() {
+        mux.async_execute(r::single_command_t{"PING"},
+                          [&](const sys::error_code &ec,
+                              multiplexer_t::result_t &&result) {
+                              REQUIRE(!ec);
+                              kept.emplace_back(std::move(result));
+                          });
+        io.poll();
+        asio::write(peer, asio::buffer(std::string("+PONG\r\n")));
+        run_until(io, [&]() { return kept.size() == 1; });
+        auto result = std::move(kept.front());
+        kept.clear();
+        return result;
+    };
+
+    // the first buffer is kept, so the next read goes into the new one
+    auto first = ping();
+    auto first_buffer = first.buffer.get();
+    auto second = ping();
+    REQUIRE(second.buffer.get() != first_buffer);
+
+    // the released buffer is taken for the next read
+    first = multiplexer_t::result_t{};
+    auto third = ping();
+    REQUIRE(third.buffer.get() != second.buffer.get());
+    auto fourth = ping();
+    REQUIRE(fourth.buffer.get() == first_buffer);
+    REQUIRE(boost::apply_visitor(stringizer_t(), fourth.result) ==
+            "[str] PONG");
+}
+
+TEST_CASE("completion tokens and handler executors", "[multiplexer]") {
+    asio::io_context io;
+    local_socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+
+    // the reply is kept alive by the result, while the receive buffer is
+    // reused by the further replies
+    auto future = mux.async_execute(r::single_command_t{"GET", "a"},
+                                    asio::use_future);
+    io.poll();
+    asio::write(peer, asio::buffer(std::string("$5\r\nfirst\r\n")));
+    run_until(io, [&]() {
+        return future.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+    });
+
+    // the move-only handler is invoked via its strand
+    auto strand = asio::make_strand(io);
+    auto value = std::make_unique<std::string>();
+    bool in_strand = false;
+    mux.async_execute(
+        r::single_command_t{"GET", "b"},
+        asio::bind_executor(
+            strand, [&, value = std::move(value)](
+                        const sys::error_code &ec,
+                        const multiplexer_t::result_t &reply) mutable {
+                REQUIRE(!ec);
+                in_strand = strand.running_in_this_thread();
+                *value = boost::apply_visitor(stringizer_t(), reply.result);
+                REQUIRE(*value == "[str] second");
+            }));
+    io.poll();
+    asio::write(peer, asio::buffer(std::string("$6\r\nsecond\r\n")));
+    run_until(io, [&]() { return in_strand; });
+
+    auto result = future.get();
+    REQUIRE(boost::apply_visitor(stringizer_t(), result.result) ==
+            "[str] first");
+}
+
+TEST_CASE("concurrent callers get own replies", "[multiplexer]") {
+    using socket_t = asio::ip::tcp::socket;
+    using tcp_multiplexer_t = r::Multiplexer<socket_t>;
+
+    uint16_t port = ep::get_random<ep::Kind::TCP>();
+    auto port_str = boost::lexical_cast<std::string>(port);
+    auto server = ts::make_server({"redis-server", "--port", port_str});
+    ep::wait_port<ep::Kind::TCP>(port);
+    asio::io_context io;
+
+    asio::ip::tcp::endpoint end_point(
+        asio::ip::address::from_string("127.0.0.1"), port);
+    socket_t socket(io, end_point.protocol());
+    socket.connect(end_point);
+    tcp_multiplexer_t mux(std::move(socket));
+
+    // each caller increments own counter a few times, issuing the next
+    // command from the handler of the previous one
+    const int callers = 100;
+    const int rounds = 10;
+    int completed = 0;
+    std::function<void(int, int)> call = [&](int caller, int round) {
+        auto key = "mux-counter-" + std::to_string(caller);
+        mux.async_execute(
+            r::single_command_t{"INCR", key},
+            [&, caller, round](const sys::error_code &ec,
+                               const tcp_multiplexer_t::result_t &reply) {
+                REQUIRE(!ec);
+                auto expected = std::to_string(round + 1);
+                REQUIRE(boost::apply_visitor(
+                    r::marker_helpers::equality<Iterator>(expected),
+                    reply.result));
+                ++completed;
+                if (round + 1 < rounds) {
+                    call(caller, round + 1);
+                }
+            });
+    };
+    for (int caller = 0; caller < callers; ++caller) {
+        call(caller, 0);
+    }
+    io.run();
+    REQUIRE(completed == callers * rounds);
+    REQUIRE(mux.pending() == 0);
+}
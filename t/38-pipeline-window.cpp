@@ -0,0 +1,156 @@
+#include <boost/asio.hpp>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "bredis/MarkerHelpers.hpp"
+#include "bredis/Multiplexer.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using socket_t = asio::local::stream_protocol::socket;
+using multiplexer_t = r::Multiplexer<socket_t>;
+using Iterator = multiplexer_t::Iterator;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+static const std::string ping = "*1\r\n$4\r\nPING\r\n";
+
+template <typename Predicate>
+static void run_until(asio::io_context &io, Predicate predicate) {
+    while (!predicate()) {
+        io.run_one();
+    }
+}
+
+struct replies_t {
+    std::vector<std::string> values;
+
+    auto handler() {
+        return [this](const sys::error_code &ec,
+                      const multiplexer_t::result_t &reply) {
+            values.emplace_back(ec ? ec.message()
+                                   : boost::apply_visitor(stringizer_t(),
+                                                          reply.result));
+        };
+    }
+};
+
+static std::string receive(socket_t &peer) {
+    std::string received(peer.available(), '\0');
+    asio::read(peer, asio::buffer(&received[0], received.size()));
+    return received;
+}
+
+TEST_CASE("in-flight commands are limited", "[window]") {
+    asio::io_context io;
+    socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+    r::pipeline_window_t window;
+    window.max_in_flight = 2;
+    mux.set_window(window);
+
+    replies_t replies;
+    for (int i = 0; i < 5; ++i) {
+        mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    }
+    REQUIRE(mux.pending() == 2);
+    REQUIRE(mux.waiting() == 3);
+    io.poll();
+    REQUIRE(receive(peer) == ping + ping);
+
+    // the window resumes as the replies are dispatched
+    asio::write(peer, asio::buffer(std::string("+a\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 1; });
+    io.poll();
+    REQUIRE(mux.pending() == 2);
+    REQUIRE(mux.waiting() == 2);
+    REQUIRE(receive(peer) == ping);
+
+    asio::write(peer, asio::buffer(std::string("+b\r\n+c\r\n+d\r\n+e\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 5; });
+    std::vector<std::string> expected{"[str] a", "[str] b", "[str] c",
+                                      "[str] d", "[str] e"};
+    REQUIRE(replies.values == expected);
+    REQUIRE(mux.waiting() == 0);
+
+    // the command, which exceeds the limit on its own, is admitted into
+    // the empty window
+    r::command_batch_t batch;
+    for (int i = 0; i < 3; ++i) {
+        batch.push("PING");
+    }
+    mux.async_execute(batch, replies.handler());
+    REQUIRE(mux.pending() == 1);
+    REQUIRE(mux.waiting() == 0);
+}
+
+TEST_CASE("unwritten bytes are limited", "[window]") {
+    asio::io_context io;
+    socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+    r::pipeline_window_t window;
+    window.max_tx_bytes = ping.size() + 1;
+    mux.set_window(window);
+
+    replies_t replies;
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    REQUIRE(mux.waiting() == 1);
+
+    // the window resumes as the queued commands are written, i.e. without
+    // waiting for the replies
+    run_until(io, [&]() { return peer.available() == ping.size() * 2; });
+    REQUIRE(mux.waiting() == 0);
+    REQUIRE(mux.pending() == 2);
+}
+
+TEST_CASE("full window fails fast", "[window]") {
+    asio::io_context io;
+    socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+    r::pipeline_window_t window;
+    window.max_in_flight = 1;
+    window.fail_fast = true;
+    mux.set_window(window);
+
+    replies_t replies;
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    REQUIRE(mux.waiting() == 0);
+    run_until(io, [&]() { return replies.values.size() == 1; });
+    auto full = r::Error::make_error_code(r::bredis_errors::window_full);
+    REQUIRE(replies.values[0] == full.message());
+
+    asio::write(peer, asio::buffer(std::string("+a\r\n")));
+    run_until(io, [&]() { return replies.values.size() == 2; });
+    REQUIRE(replies.values[1] == "[str] a");
+}
+
+TEST_CASE("waiting commands fail on I/O error", "[window]") {
+    asio::io_context io;
+    socket_t socket(io), peer(io);
+    asio::local::connect_pair(socket, peer);
+    auto work = asio::make_work_guard(io);
+    multiplexer_t mux(std::move(socket));
+    r::pipeline_window_t window;
+    window.max_in_flight = 1;
+    mux.set_window(window);
+
+    replies_t replies;
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    mux.async_execute(r::single_command_t{"PING"}, replies.handler());
+    io.poll();
+    peer.close();
+    run_until(io, [&]() { return replies.values.size() == 2; });
+    REQUIRE(mux.pending() == 0);
+    REQUIRE(mux.waiting() == 0);
+}
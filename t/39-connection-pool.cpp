@@ -0,0 +1,378 @@
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "bredis/ConnectionPool.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using socket_t = asio::local::stream_protocol::socket;
+using pool_t = r::ConnectionPool<socket_t>;
+using multiplexer_t = pool_t::multiplexer_t;
+
+template <typename Predicate>
+static void run_until(asio::io_context &io, Predicate predicate) {
+    while (!predicate()) {
+        io.run_one();
+    }
+}
+
+// the connections are socket pairs, the server side is kept by the test
+struct peers_t {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<socket_t>> sockets;
+    // the io_context of the connection
+    std::vector<asio::io_context *> contexts;
+    // the connections are completed by the test, if they are deferred
+    bool deferred = false;
+    std::vector<pool_t::connect_handler_t> connecting;
+
+    pool_t::factory_t factory() {
+        return [this](const pool_t::strand_t &strand,
+                      pool_t::connect_handler_t handler) {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (deferred) {
+                connecting.push_back(std::move(handler));
+                return;
+            }
+            auto &io = strand.get_inner_executor().context();
+            socket_t socket(strand);
+            sockets.emplace_back(new socket_t(io));
+            asio::local::connect_pair(socket, *sockets.back());
+            contexts.push_back(&io);
+            handler(sys::error_code{}, std::move(socket));
+        };
+    }
+
+    std::vector<std::size_t> received() {
+        std::lock_guard<std::mutex> guard(mutex);
+        std::vector<std::size_t> sizes;
+        for (auto &socket : sockets) {
+            sizes.push_back(socket->available());
+        }
+        return sizes;
+    }
+};
+
+static const std::string ping = "*1\r\n$4\r\nPING\r\n";
+
+TEST_CASE("commands are routed to the least loaded connection", "[pool]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    peers_t peers;
+    r::pool_options_t options;
+    options.min_connections = 2;
+    options.max_connections = 2;
+    pool_t pool(io, peers.factory(), options);
+    io.poll();
+    REQUIRE(pool.size() == 2);
+
+    int replies = 0;
+    auto handler = [&](const sys::error_code &ec,
+                       const multiplexer_t::result_t &) {
+        REQUIRE(!ec);
+        ++replies;
+    };
+    for (int i = 0; i < 3; ++i) {
+        pool.async_execute(r::single_command_t{"PING"}, handler);
+    }
+    r::command_batch_t batch;
+    batch.push("PING");
+    batch.push("PING");
+    pool.async_execute(batch, handler);
+    io.poll();
+    std::vector<std::size_t> expected{ping.size() * 2, ping.size() * 3};
+    REQUIRE(peers.received() == expected);
+
+    asio::write(*peers.sockets[0], asio::buffer(std::string("+a\r\n+b\r\n")));
+    run_until(io, [&]() { return replies == 2; });
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    expected = {ping.size() * 3, ping.size() * 3};
+    REQUIRE(peers.received() == expected);
+
+    REQUIRE_THROWS_AS(pool.async_execute(r::command_container_t{}, handler),
+                      std::invalid_argument &);
+}
+
+TEST_CASE("pool grows and shrinks within bounds", "[pool]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    peers_t peers;
+    r::pool_options_t options;
+    options.min_connections = 1;
+    options.max_connections = 3;
+    options.grow_threshold = 2;
+    options.idle_timeout = std::chrono::milliseconds(50);
+    pool_t pool(io, peers.factory(), options);
+
+    int replies = 0;
+    auto handler = [&](const sys::error_code &ec,
+                       const multiplexer_t::result_t &) {
+        REQUIRE(!ec);
+        ++replies;
+    };
+    for (int i = 0; i < 8; ++i) {
+        pool.async_execute(r::single_command_t{"PING"}, handler);
+    }
+    io.poll();
+    REQUIRE(pool.size() == 3);
+    std::vector<std::size_t> expected{ping.size() * 3, ping.size() * 3,
+                                      ping.size() * 2};
+    REQUIRE(peers.received() == expected);
+
+    std::string three = ":1\r\n:2\r\n:3\r\n";
+    std::string two = ":1\r\n:2\r\n";
+    asio::write(*peers.sockets[0], asio::buffer(three));
+    asio::write(*peers.sockets[1], asio::buffer(three));
+    asio::write(*peers.sockets[2], asio::buffer(two));
+    run_until(io, [&]() { return replies == 8; });
+    io.poll();
+
+    // the idle connections are kept for a while, then they are closed
+    // down to the minimum
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(pool.size() == 3);
+    asio::write(*peers.sockets[0], asio::buffer(std::string("+a\r\n")));
+    run_until(io, [&]() { return replies == 9; });
+    io.poll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(pool.size() == 1);
+}
+
+TEST_CASE("idle connections are closed without further commands",
+          "[pool]") {
+    asio::io_context io;
+    peers_t peers;
+    r::pool_options_t options;
+    options.min_connections = 1;
+    options.max_connections = 2;
+    options.grow_threshold = 1;
+    options.idle_timeout = std::chrono::milliseconds(50);
+    pool_t pool(io, peers.factory(), options);
+
+    int replies = 0;
+    auto handler = [&](const sys::error_code &ec,
+                       const multiplexer_t::result_t &) {
+        REQUIRE(!ec);
+        ++replies;
+    };
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(pool.size() == 2);
+    for (auto &socket : peers.sockets) {
+        asio::write(*socket, asio::buffer(std::string("+PONG\r\n")));
+    }
+    run_until(io, [&]() { return replies == 2; });
+
+    // the surplus connection is closed by the timer, then the io_context
+    // runs out of work
+    auto started = std::chrono::steady_clock::now();
+    io.run();
+    REQUIRE(std::chrono::steady_clock::now() - started <
+            std::chrono::seconds(1));
+    REQUIRE(pool.size() == 1);
+    auto closed = [](socket_t &socket) {
+        // the sent command is read first
+        std::vector<char> data(ping.size() * 2);
+        sys::error_code ec;
+        socket.non_blocking(true);
+        while (!ec) {
+            socket.read_some(asio::buffer(data), ec);
+        }
+        return ec == asio::error::eof;
+    };
+    REQUIRE(closed(*peers.sockets[0]) != closed(*peers.sockets[1]));
+}
+
+TEST_CASE("failed connection is replaced", "[pool]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    peers_t peers;
+    pool_t pool(io, peers.factory());
+
+    std::vector<sys::error_code> errors;
+    auto handler = [&](const sys::error_code &ec,
+                       const multiplexer_t::result_t &) {
+        errors.push_back(ec);
+    };
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    peers.sockets[0]->close();
+    run_until(io, [&]() { return errors.size() == 1; });
+    REQUIRE(errors[0]);
+    io.poll();
+
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(pool.size() == 1);
+    REQUIRE(peers.sockets.size() == 2);
+    REQUIRE(peers.sockets[1]->available() == ping.size());
+}
+
+TEST_CASE("commands wait for the connection", "[pool]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    peers_t peers;
+    peers.deferred = true;
+    pool_t pool(io, peers.factory());
+
+    std::vector<sys::error_code> errors;
+    auto handler = [&](const sys::error_code &ec,
+                       const multiplexer_t::result_t &) {
+        errors.push_back(ec);
+    };
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(peers.connecting.size() == 1);
+    REQUIRE(pool.size() == 1);
+
+    // the queued commands are written once the connection is up
+    auto strand = asio::make_strand(io);
+    socket_t socket(strand), peer(io);
+    asio::local::connect_pair(socket, peer);
+    peers.connecting[0](sys::error_code{}, std::move(socket));
+    io.poll();
+    REQUIRE(peer.available() == ping.size() * 2);
+
+    // the queued commands fail, if the connection fails
+    peer.close();
+    run_until(io, [&]() { return errors.size() == 2; });
+    pool.async_execute(r::single_command_t{"PING"}, handler);
+    io.poll();
+    REQUIRE(peers.connecting.size() == 2);
+    peers.connecting[1](asio::error::connection_refused, socket_t(io));
+    run_until(io, [&]() { return errors.size() == 3; });
+    REQUIRE(errors[2] == asio::error::connection_refused);
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("connections are bound to the thread io_context", "[pool]") {
+    asio::io_context io_1, io_2;
+    auto work_1 = asio::make_work_guard(io_1);
+    auto work_2 = asio::make_work_guard(io_2);
+    peers_t peers;
+    r::pool_options_t options;
+    options.min_connections = 2;
+    options.max_connections = 2;
+    pool_t pool({&io_1, &io_2}, peers.factory(), options);
+    REQUIRE_THROWS_AS(pool.size(), std::logic_error &);
+
+    // one command from the thread of io_1, two from the thread of io_2
+    auto handler = [](const sys::error_code &,
+                      const multiplexer_t::result_t &) {};
+    asio::post(io_1, [&]() {
+        pool.async_execute(r::single_command_t{"PING"}, handler);
+    });
+    asio::post(io_2, [&]() {
+        pool.async_execute(r::single_command_t{"PING"}, handler);
+        pool.async_execute(r::single_command_t{"PING"}, handler);
+    });
+    std::thread thread_1([&]() { io_1.run(); });
+    std::thread thread_2([&]() { io_2.run(); });
+
+    auto received = [&](asio::io_context &io) {
+        std::lock_guard<std::mutex> guard(peers.mutex);
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < peers.sockets.size(); ++i) {
+            if (peers.contexts[i] == &io) {
+                size += peers.sockets[i]->available();
+            }
+        }
+        return size;
+    };
+    while (received(io_1) < ping.size() || received(io_2) < ping.size() * 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    io_1.stop();
+    io_2.stop();
+    thread_1.join();
+    thread_2.join();
+    REQUIRE(received(io_1) == ping.size());
+    REQUIRE(received(io_2) == ping.size() * 2);
+}
+
+TEST_CASE("io_context is run by many threads", "[pool]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    peers_t peers;
+    r::pool_options_t options;
+    options.max_connections = 4;
+    options.grow_threshold = 8;
+    pool_t pool(io, peers.factory(), options);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() { io.run(); });
+    }
+
+    // the commands are issued from the foreign thread and from the
+    // handlers, i.e. from the threads of io_context
+    const int commands = 200;
+    std::atomic<int> replies{0};
+    std::function<void(int)> call = [&](int left) {
+        pool.async_execute(r::single_command_t{"PING"},
+                           [&, left](const sys::error_code &ec,
+                                     const multiplexer_t::result_t &) {
+                               REQUIRE(!ec);
+                               ++replies;
+                               if (left) {
+                                   call(left - 1);
+                               }
+                           });
+    };
+    for (int i = 0; i < commands / 10; ++i) {
+        call(9);
+    }
+
+    // the server side replies to all the received commands
+    std::size_t answered = 0;
+    while (answered < commands) {
+        std::vector<std::pair<socket_t *, std::size_t>> pings;
+        {
+            std::lock_guard<std::mutex> guard(peers.mutex);
+            for (auto &socket : peers.sockets) {
+                pings.emplace_back(socket.get(),
+                                   socket->available() / ping.size());
+            }
+        }
+        for (auto &peer : pings) {
+            if (!peer.second) {
+                continue;
+            }
+            std::string received(peer.second * ping.size(), '\0');
+            asio::read(*peer.first,
+                       asio::buffer(&received[0], received.size()));
+            std::string replied;
+            for (std::size_t i = 0; i < peer.second; ++i) {
+                replied += "+PONG\r\n";
+            }
+            asio::write(*peer.first, asio::buffer(replied));
+            answered += peer.second;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (replies < commands) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    io.stop();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    REQUIRE(replies == commands);
+}
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "bredis/Cluster.hpp"
+#include "bredis/MarkerHelpers.hpp"
+
+namespace r = bredis;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using socket_t = asio::local::stream_protocol::socket;
+using cluster_t = r::Cluster<socket_t>;
+using Iterator = cluster_t::Iterator;
+using stringizer_t = r::marker_helpers::stringizer<Iterator>;
+
+template <typename Predicate>
+static void run_until(asio::io_context &io, Predicate predicate) {
+    while (!predicate()) {
+        io.run_one();
+    }
+}
+
+// the nodes are socket pairs, the server side is kept by the test
+struct nodes_t {
+    asio::io_context &io;
+    std::map<std::string, std::unique_ptr<socket_t>> peers;
+    // the nodes, which refuse the connection
+    std::vector<std::string> down;
+
+    cluster_t::factory_t factory() {
+        return [this](const std::string &host, std::uint16_t port,
+                      cluster_t::connect_handler_t handler) {
+            auto node = host + ":" + std::to_string(port);
+            socket_t socket(io);
+            if (std::find(down.begin(), down.end(), node) != down.end()) {
+                handler(asio::error::connection_refused, std::move(socket));
+                return;
+            }
+            auto &peer = peers[node];
+            peer.reset(new socket_t(io));
+            asio::local::connect_pair(socket, *peer);
+            handler(sys::error_code{}, std::move(socket));
+        };
+    }
+
+    std::string receive(const std::string &node, std::size_t size) {
+        run_until(io, [&]() {
+            return peers.count(node) && peers[node]->available() >= size;
+        });
+        std::string received(size, '\0');
+        asio::read(*peers[node], asio::buffer(&received[0], size));
+        return received;
+    }
+
+    void reply(const std::string &node, const std::string &data) {
+        asio::write(*peers[node], asio::buffer(data));
+    }
+};
+
+static const std::string cluster_slots =
+    "*2\r\n$7\r\nCLUSTER\r\n$5\r\nSLOTS\r\n";
+
+static std::string get(const std::string &key) {
+    return "*2\r\n$3\r\nGET\r\n$" + std::to_string(key.size()) + "\r\n" +
+           key + "\r\n";
+}
+
+// node-a:7000 serves the first half of the slots
+static std::string slots_reply(const std::string &host,
+                               const std::string &port) {
+    return "*2\r\n"
+           "*3\r\n:0\r\n:8191\r\n*3\r\n$6\r\nnode-a\r\n:7000\r\n$2\r\nid\r\n"
+           "*3\r\n:8192\r\n:16383\r\n*2\r\n$6\r\n" +
+           host + "\r\n:" + port + "\r\n";
+}
+
+TEST_CASE("key slots", "[cluster]") {
+    REQUIRE(r::details::crc16("123456789", 9) == 0x31C3);
+    REQUIRE(r::key_slot("123456789") == 12739);
+    REQUIRE(r::key_slot("foo") == 12182);
+    REQUIRE(r::key_slot("bar") == 5061);
+    REQUIRE(r::key_slot("{user1000}.following") == r::key_slot("user1000"));
+    REQUIRE(r::key_slot("foo{}{bar}") ==
+            (r::details::crc16("foo{}{bar}", 10) & 16383));
+    REQUIRE(r::key_slot("foo{{bar}}zap") == r::key_slot("{bar"));
+    REQUIRE(r::key_slot("foo{bar}{zap}") == r::key_slot("bar"));
+
+    auto command = get("foo");
+    auto key = r::details::command_key(command);
+    REQUIRE(key);
+    REQUIRE(*key == "foo");
+    REQUIRE(!r::details::command_key("*1\r\n$4\r\nPING\r\n"));
+}
+
+TEST_CASE("command keys", "[cluster]") {
+    auto key = [](std::vector<boost::string_ref> arguments) {
+        auto found = r::details::command_key(arguments);
+        return found ? found->to_string() : std::string("none");
+    };
+    REQUIRE(key({"GET", "foo"}) == "foo");
+    REQUIRE(key({"PING"}) == "none");
+    REQUIRE(key({"EVAL", "return 1", "2", "k1", "k2", "a"}) == "k1");
+    REQUIRE(key({"evalsha", "sha", "1", "k1"}) == "k1");
+    REQUIRE(key({"EVAL", "return 1", "0", "a"}) == "none");
+    REQUIRE(key({"EVAL", "return 1", "x", "a"}) == "none");
+    REQUIRE(key({"FCALL", "f", "1", "k1"}) == "k1");
+    REQUIRE(key({"XREAD", "COUNT", "2", "STREAMS", "s1", "s2", "0", "0"}) ==
+            "s1");
+    REQUIRE(key({"XREADGROUP", "GROUP", "g", "c", "streams", "s1", ">"}) ==
+            "s1");
+    REQUIRE(key({"XREAD", "COUNT", "2"}) == "none");
+    REQUIRE(key({"OBJECT", "ENCODING", "foo"}) == "foo");
+    REQUIRE(key({"MEMORY", "USAGE", "foo", "SAMPLES", "5"}) == "foo");
+    REQUIRE(key({"MEMORY", "STATS"}) == "none");
+    REQUIRE(key({"BITOP", "AND", "dest", "a", "b"}) == "dest");
+    REQUIRE(key({"XINFO", "STREAM", "s1"}) == "s1");
+    REQUIRE(key({"XGROUP", "CREATE", "s1", "g", "$"}) == "s1");
+    REQUIRE(key({"ZUNION", "2", "z1", "z2"}) == "z1");
+    REQUIRE(key({"BLMPOP", "0", "2", "l1", "l2", "LEFT"}) == "l1");
+}
+
+TEST_CASE("redirections", "[cluster]") {
+    auto moved = r::parse_redirection("MOVED 3999 127.0.0.1:6381");
+    REQUIRE(moved);
+    REQUIRE(moved->moved);
+    REQUIRE(moved->slot == 3999);
+    REQUIRE(moved->host == "127.0.0.1");
+    REQUIRE(moved->port == 6381);
+
+    auto ask = r::parse_redirection("ASK 1 ::1:6380");
+    REQUIRE(ask);
+    REQUIRE(!ask->moved);
+    REQUIRE(ask->host == "::1");
+
+    auto same_host = r::parse_redirection("MOVED 2 :6380");
+    REQUIRE(same_host);
+    REQUIRE(same_host->host.empty());
+    REQUIRE(same_host->port == 6380);
+
+    REQUIRE(!r::parse_redirection("ERR unknown command"));
+    REQUIRE(!r::parse_redirection("MOVED 16384 host:1"));
+    REQUIRE(!r::parse_redirection("MOVED 1 host"));
+}
+
+TEST_CASE("commands follow redirections", "[cluster]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    nodes_t nodes{io, {}, {}};
+    cluster_t cluster(io.get_executor(), "node-a", 7000, nodes.factory());
+
+    bool connected = false;
+    cluster.async_connect([&](const sys::error_code &ec) {
+        REQUIRE(!ec);
+        connected = true;
+    });
+    REQUIRE(nodes.receive("node-a:7000", cluster_slots.size()) ==
+            cluster_slots);
+    nodes.reply("node-a:7000", slots_reply("node-b", "7001"));
+    run_until(io, [&]() { return connected; });
+    REQUIRE(cluster.nodes() == 2);
+
+    std::vector<std::string> replies;
+    auto handler = [&](const sys::error_code &ec,
+                       const cluster_t::result_t &reply) {
+        REQUIRE(!ec);
+        replies.push_back(boost::apply_visitor(stringizer_t(), reply.result));
+    };
+
+    // the slot has moved: the command is resent, the slots are refreshed
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    REQUIRE(nodes.receive("node-b:7001", get("foo").size()) == get("foo"));
+    nodes.reply("node-b:7001", "-MOVED 12182 node-c:7002\r\n");
+    auto expected = cluster_slots + get("foo");
+    REQUIRE(nodes.receive("node-c:7002", expected.size()) == expected);
+    nodes.reply("node-c:7002", slots_reply("node-c", "7002") + "$3\r\nbaz\r\n");
+    run_until(io, [&]() { return replies.size() == 1; });
+    REQUIRE(replies[0] == "[str] baz");
+    REQUIRE(cluster.nodes() == 3);
+
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    REQUIRE(nodes.receive("node-c:7002", get("foo").size()) == get("foo"));
+    nodes.reply("node-c:7002", "$3\r\nqux\r\n");
+    run_until(io, [&]() { return replies.size() == 2; });
+    REQUIRE(replies[1] == "[str] qux");
+
+    // the slot map already agrees with -MOVED, so it is not reloaded
+    cluster.async_execute(r::single_command_t{"GET", "{foo}x"}, handler);
+    REQUIRE(nodes.receive("node-c:7002", get("{foo}x").size()) ==
+            get("{foo}x"));
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    REQUIRE(nodes.receive("node-c:7002", get("foo").size()) == get("foo"));
+    nodes.reply("node-c:7002", "-MOVED 12182 node-c:7002\r\n$1\r\ny\r\n");
+    REQUIRE(nodes.receive("node-c:7002", get("{foo}x").size()) ==
+            get("{foo}x"));
+    nodes.reply("node-c:7002", "$1\r\nz\r\n");
+    run_until(io, [&]() { return replies.size() == 4; });
+    REQUIRE(replies[2] == "[str] y");
+    REQUIRE(replies[3] == "[str] z");
+    io.poll();
+    REQUIRE(nodes.peers["node-c:7002"]->available() == 0);
+    replies.resize(2);
+
+    // the slot is migrating: the command is asked once
+    cluster.async_execute(r::single_command_t{"GET", "bar"}, handler);
+    REQUIRE(nodes.receive("node-a:7000", get("bar").size()) == get("bar"));
+    nodes.reply("node-a:7000", "-ASK 5061 node-b:7001\r\n");
+    expected = "*1\r\n$6\r\nASKING\r\n" + get("bar");
+    REQUIRE(nodes.receive("node-b:7001", expected.size()) == expected);
+    nodes.reply("node-b:7001", "+OK\r\n$1\r\nx\r\n");
+    run_until(io, [&]() { return replies.size() == 3; });
+    REQUIRE(replies[2] == "[str] x");
+
+    cluster.async_execute(r::single_command_t{"GET", "bar"}, handler);
+    REQUIRE(nodes.receive("node-a:7000", get("bar").size()) == get("bar"));
+    nodes.reply("node-a:7000", "-ERR other\r\n");
+    run_until(io, [&]() { return replies.size() == 4; });
+    REQUIRE(replies[3] == "[err] ERR other");
+
+    r::command_container_t pair{r::single_command_t{"GET", "foo"},
+                                r::single_command_t{"GET", "bar"}};
+    REQUIRE_THROWS_AS(cluster.async_execute(pair, handler),
+                      std::invalid_argument &);
+}
+
+TEST_CASE("commands wait for the node connection", "[cluster]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    nodes_t nodes{io, {}, {"node-b:7001"}};
+    cluster_t cluster(io.get_executor(), "node-a", 7000, nodes.factory());
+
+    bool connected = false;
+    cluster.async_connect([&](const sys::error_code &) { connected = true; });
+    REQUIRE(!cluster.node(0));
+    nodes.receive("node-a:7000", cluster_slots.size());
+    REQUIRE(cluster.node(0));
+    nodes.reply("node-a:7000", slots_reply("node-b", "7001"));
+    run_until(io, [&]() { return connected; });
+
+    // the node is not reachable, the command fails with the connection
+    std::vector<sys::error_code> errors;
+    auto handler = [&](const sys::error_code &ec, const cluster_t::result_t &) {
+        errors.push_back(ec);
+    };
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    run_until(io, [&]() { return errors.size() == 1; });
+    REQUIRE(errors[0] == asio::error::connection_refused);
+    REQUIRE(!cluster.node(r::key_slot("foo")));
+
+    // the next command tries to connect again
+    nodes.down.clear();
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    REQUIRE(nodes.receive("node-b:7001", get("foo").size()) == get("foo"));
+    nodes.reply("node-b:7001", "$1\r\nx\r\n");
+    run_until(io, [&]() { return errors.size() == 2; });
+    REQUIRE(!errors[1]);
+}
+
+TEST_CASE("slot map requests do not overlap", "[cluster]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    nodes_t nodes{io, {}, {}};
+    cluster_t cluster(io.get_executor(), "node-a", 7000, nodes.factory());
+
+    // the second request waits for the first one
+    std::vector<sys::error_code> loaded;
+    auto on_slots = [&](const sys::error_code &ec) { loaded.push_back(ec); };
+    cluster.async_connect(on_slots);
+    cluster.async_connect(on_slots);
+    REQUIRE(nodes.receive("node-a:7000", cluster_slots.size()) ==
+            cluster_slots);
+    io.poll();
+    REQUIRE(nodes.peers["node-a:7000"]->available() == 0);
+    nodes.reply("node-a:7000", slots_reply("node-b", "7001"));
+    run_until(io, [&]() { return loaded.size() == 2; });
+    REQUIRE((!loaded[0] && !loaded[1]));
+
+    std::vector<std::string> replies;
+    auto handler = [&](const sys::error_code &ec,
+                       const cluster_t::result_t &reply) {
+        REQUIRE(!ec);
+        replies.push_back(boost::apply_visitor(stringizer_t(), reply.result));
+    };
+
+    // the slot has moved while the map is loaded, so the loaded map may
+    // be stale: it is dropped and requested again
+    cluster.async_connect(on_slots);
+    REQUIRE(nodes.receive("node-a:7000", cluster_slots.size()) ==
+            cluster_slots);
+    cluster.async_execute(r::single_command_t{"GET", "foo"}, handler);
+    REQUIRE(nodes.receive("node-b:7001", get("foo").size()) == get("foo"));
+    nodes.reply("node-b:7001", "-MOVED 12182 node-c:7002\r\n");
+    REQUIRE(nodes.receive("node-c:7002", get("foo").size()) == get("foo"));
+    nodes.reply("node-c:7002", "$3\r\nbaz\r\n");
+    run_until(io, [&]() { return replies.size() == 1; });
+    auto moved_node = cluster.node(12182);
+    REQUIRE(moved_node);
+    REQUIRE(moved_node != cluster.node(8192));
+
+    nodes.reply("node-a:7000", slots_reply("node-b", "7001"));
+    REQUIRE(nodes.receive("node-c:7002", cluster_slots.size()) ==
+            cluster_slots);
+    REQUIRE(loaded.size() == 2);
+    REQUIRE(cluster.node(12182) == moved_node);
+    nodes.reply("node-c:7002", slots_reply("node-c", "7002"));
+    run_until(io, [&]() { return loaded.size() == 3; });
+    REQUIRE(!loaded[2]);
+    REQUIRE(cluster.node(8192) == moved_node);
+}
+
+TEST_CASE("invalid cluster slots reply", "[cluster]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    nodes_t nodes{io, {}, {}};
+    cluster_t cluster(io.get_executor(), "node-a", 7000, nodes.factory());
+
+    sys::error_code result;
+    bool done = false;
+    cluster.async_connect([&](const sys::error_code &ec) {
+        result = ec;
+        done = true;
+    });
+    nodes.receive("node-a:7000", cluster_slots.size());
+    nodes.reply("node-a:7000", "-ERR cluster support disabled\r\n");
+    run_until(io, [&]() { return done; });
+    REQUIRE(result ==
+            r::Error::make_error_code(r::bredis_errors::cluster_slots));
+}
+
+TEST_CASE("multi-key commands are split by slots", "[cluster]") {
+    asio::io_context io;
+    auto work = asio::make_work_guard(io);
+    nodes_t nodes{io, {}, {}};
+    cluster_t cluster(io.get_executor(), "node-a", 7000, nodes.factory());
+    bool connected = false;
+    cluster.async_connect([&](const sys::error_code &) { connected = true; });
+    nodes.receive("node-a:7000", cluster_slots.size());
+    nodes.reply("node-a:7000", slots_reply("node-b", "7001"));
+    run_until(io, [&]() { return connected; });
+
+    std::vector<std::string> replies;
+    std::vector<std::pair<std::size_t, std::size_t>> parts;
+    auto handler = [&](const sys::error_code &ec,
+                       const cluster_t::result_t &reply) {
+        REQUIRE(!ec);
+        replies.push_back(boost::apply_visitor(stringizer_t(), reply.result));
+        parts.emplace_back(reply.succeeded, reply.parts);
+    };
+    using parts_t = std::pair<std::size_t, std::size_t>;
+    auto expect = [&](const std::string &node, const std::string &command) {
+        REQUIRE(nodes.receive(node, command.size()) == command);
+    };
+    std::string mget_foo = "*2\r\n$4\r\nmget\r\n$3\r\nfoo\r\n";
+    std::string mget_bar = "*3\r\n$4\r\nmget\r\n$3\r\nbar\r\n$6\r\n{bar}x\r\n";
+
+    // foo is served by node-b, bar and {bar}x by node-a
+    cluster.async_execute(r::single_command_t{"mget", "foo", "bar", "{bar}x"},
+                          handler);
+    expect("node-b:7001", mget_foo);
+    expect("node-a:7000", mget_bar);
+    nodes.reply("node-a:7000", "*2\r\n$-1\r\n$1\r\n3\r\n");
+    io.poll();
+    REQUIRE(replies.empty());
+    nodes.reply("node-b:7001", "*1\r\n$1\r\n1\r\n");
+    run_until(io, [&]() { return replies.size() == 1; });
+    REQUIRE(replies[0] == "[array] {[str] 1, [nil] , [str] 3, }");
+    REQUIRE(parts[0] == parts_t(2, 2));
+
+    // the keys of the same slot are not split
+    cluster.async_execute(r::single_command_t{"mget", "bar", "{bar}x"},
+                          handler);
+    expect("node-a:7000", mget_bar);
+    nodes.reply("node-a:7000", "*2\r\n$1\r\n2\r\n$1\r\n3\r\n");
+    run_until(io, [&]() { return replies.size() == 2; });
+    REQUIRE(replies[1] == "[array] {[str] 2, [str] 3, }");
+    REQUIRE(parts[1] == parts_t(1, 1));
+
+    cluster.async_execute(r::single_command_t{"DEL", "foo", "bar", "{bar}x"},
+                          handler);
+    expect("node-b:7001", "*2\r\n$3\r\nDEL\r\n$3\r\nfoo\r\n");
+    expect("node-a:7000", "*3\r\n$3\r\nDEL\r\n$3\r\nbar\r\n$6\r\n{bar}x\r\n");
+    nodes.reply("node-a:7000", ":2\r\n");
+    nodes.reply("node-b:7001", ":1\r\n");
+    run_until(io, [&]() { return replies.size() == 3; });
+    REQUIRE(replies[2] == "[int] 3");
+
+    cluster.async_execute(r::single_command_t{"MSET", "foo", 1, "bar", 2},
+                          handler);
+    expect("node-b:7001", "*3\r\n$4\r\nMSET\r\n$3\r\nfoo\r\n$1\r\n1\r\n");
+    expect("node-a:7000", "*3\r\n$4\r\nMSET\r\n$3\r\nbar\r\n$1\r\n2\r\n");
+    nodes.reply("node-a:7000", "+OK\r\n");
+    nodes.reply("node-b:7001", "+OK\r\n");
+    run_until(io, [&]() { return replies.size() == 4; });
+    REQUIRE(replies[3] == "[str] OK");
+
+    // the error reply of any part is the reply as is, the partial failure
+    // is told apart by the amount of the succeeded parts
+    cluster.async_execute(r::single_command_t{"EXISTS", "foo", "bar"},
+                          handler);
+    expect("node-b:7001", "*2\r\n$6\r\nEXISTS\r\n$3\r\nfoo\r\n");
+    expect("node-a:7000", "*2\r\n$6\r\nEXISTS\r\n$3\r\nbar\r\n");
+    nodes.reply("node-a:7000", "-ERR x\r\n");
+    nodes.reply("node-b:7001", ":1\r\n");
+    run_until(io, [&]() { return replies.size() == 5; });
+    REQUIRE(replies[4] == "[err] ERR x");
+    REQUIRE(parts[4] == parts_t(1, 2));
+
+    cluster.async_execute(r::single_command_t{"MSET", "foo", 1, "bar", 2},
+                          handler);
+    expect("node-b:7001", "*3\r\n$4\r\nMSET\r\n$3\r\nfoo\r\n$1\r\n1\r\n");
+    expect("node-a:7000", "*3\r\n$4\r\nMSET\r\n$3\r\nbar\r\n$1\r\n2\r\n");
+    nodes.reply("node-a:7000", "-OOM y\r\n");
+    nodes.reply("node-b:7001", "-ERR z\r\n");
+    run_until(io, [&]() { return replies.size() == 6; });
+    REQUIRE((replies[5] == "[err] OOM y" || replies[5] == "[err] ERR z"));
+    REQUIRE(parts[5] == parts_t(0, 2));
+    replies.pop_back();
+    parts.pop_back();
+
+    // the parts follow redirections too
+    cluster.async_execute(r::single_command_t{"MGET", "foo", "bar"}, handler);
+    expect("node-b:7001", "*2\r\n$4\r\nMGET\r\n$3\r\nfoo\r\n");
+    expect("node-a:7000", "*2\r\n$4\r\nMGET\r\n$3\r\nbar\r\n");
+    nodes.reply("node-a:7000", "*1\r\n$1\r\n2\r\n");
+    nodes.reply("node-b:7001", "-ASK 12182 node-c:7002\r\n");
+    expect("node-c:7002",
+           "*1\r\n$6\r\nASKING\r\n*2\r\n$4\r\nMGET\r\n$3\r\nfoo\r\n");
+    nodes.reply("node-c:7002", "+OK\r\n*1\r\n$1\r\n1\r\n");
+    run_until(io, [&]() { return replies.size() == 6; });
+    REQUIRE(replies[5] == "[array] {[str] 1, [str] 2, }");
+
+    // the parts of the slots of the same node (bar and b) are sent by one
+    // batch, the redirected part is resent on its own
+    cluster.async_execute(r::single_command_t{"MGET", "foo", "bar", "b"},
+                          handler);
+    expect("node-b:7001", "*2\r\n$4\r\nMGET\r\n$3\r\nfoo\r\n");
+    expect("node-a:7000", "*2\r\n$4\r\nMGET\r\n$3\r\nbar\r\n"
+                          "*2\r\n$4\r\nMGET\r\n$1\r\nb\r\n");
+    nodes.reply("node-b:7001", "*1\r\n$1\r\n1\r\n");
+    nodes.reply("node-a:7000", "*1\r\n$1\r\n2\r\n-MOVED 3300 node-c:7002\r\n");
+    expect("node-c:7002",
+           cluster_slots + "*2\r\n$4\r\nMGET\r\n$1\r\nb\r\n");
+    nodes.reply("node-c:7002",
+                slots_reply("node-b", "7001") + "*1\r\n$1\r\n3\r\n");
+    run_until(io, [&]() { return replies.size() == 7; });
+    REQUIRE(replies[6] == "[array] {[str] 1, [str] 2, [str] 3, }");
+    REQUIRE(parts[6] == parts_t(3, 3));
+}